@@ -0,0 +1,156 @@
+/**
+ * @file control_bench.c
+ * @brief Load generator: requests per second through the control socket.
+ *
+ * Forks a number of clients, each of which connects to CONTROL_SOCKET_PATH of
+ * a spooler started with PRESI_CONTROL set, and keeps a window of pipelined
+ * CONTROL_QUERY requests in flight until it has had all its responses. The
+ * first request of every client is a CONTROL_SUBMIT of the given file (if
+ * any), whose job the following queries then ask about.
+ *
+ * Usage: bin/control_bench [clients] [requests per client] [window] [file]
+ *        (defaults: 8, 100000, 64, no submission)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "control_socket.h"
+
+/**
+ * @brief Returns CLOCK_MONOTONIC in seconds.
+ */
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Writes all of buffer, or fails.
+ */
+static int write_all(int fd, const void *buffer, size_t length) {
+    const char *p = buffer;
+    while (length > 0) {
+        ssize_t n = write(fd, p, length);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads exactly length bytes, or fails.
+ */
+static int read_all(int fd, void *buffer, size_t length) {
+    char *p = buffer;
+    while (length > 0) {
+        ssize_t n = read(fd, p, length);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Sends one request.
+ */
+static int send_request(int fd, uint16_t opcode, uint32_t tag, const void *payload, uint32_t length) {
+    char frame[sizeof(CONTROL_HEADER) + CONTROL_MAX_PAYLOAD];
+    CONTROL_HEADER header = { .length = length, .tag = tag, .opcode = opcode, .status = 0 };
+    memcpy(frame, &header, sizeof(header));
+    memcpy(frame + sizeof(header), payload, length);
+    return write_all(fd, frame, sizeof(header) + length);
+}
+
+/**
+ * @brief Receives one response, keeping at most CONTROL_MAX_PAYLOAD bytes of its payload.
+ */
+static int receive_response(int fd, CONTROL_HEADER *header, char *payload) {
+    if (read_all(fd, header, sizeof(*header)) < 0 || header->length > CONTROL_MAX_PAYLOAD) {
+        return -1;
+    }
+    return read_all(fd, payload, header->length);
+}
+
+/**
+ * @brief One client: connects, runs its requests, and exits with 0 on success.
+ */
+static int run_client(int requests, int window, const char *file) {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    strncpy(address.sun_path, CONTROL_SOCKET_PATH, sizeof(address.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        perror("connect");
+        return 1;
+    }
+
+    CONTROL_HEADER header;
+    char payload[CONTROL_MAX_PAYLOAD];
+    int32_t job_id = 0;
+    if (file) {
+        if (send_request(fd, CONTROL_SUBMIT, 0, file, (uint32_t)strlen(file)) < 0 ||
+            receive_response(fd, &header, payload) < 0 || header.status != CONTROL_OK) {
+            fprintf(stderr, "submit failed\n");
+            return 1;
+        }
+        memcpy(&job_id, payload, sizeof(job_id));
+    }
+
+    int sent = 0, received = 0;
+    while (received < requests) {
+        while (sent < requests && sent - received < window) {
+            if (send_request(fd, CONTROL_QUERY, (uint32_t)sent, &job_id, sizeof(job_id)) < 0) {
+                return 1;
+            }
+            sent++;
+        }
+        if (receive_response(fd, &header, payload) < 0 || header.tag != (uint32_t)received) {
+            fprintf(stderr, "bad response %d\n", received);
+            return 1;
+        }
+        received++;
+    }
+    close(fd);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int clients = (argc > 1) ? atoi(argv[1]) : 8;
+    int requests = (argc > 2) ? atoi(argv[2]) : 100000;
+    int window = (argc > 3) ? atoi(argv[3]) : 64;
+    const char *file = (argc > 4) ? argv[4] : NULL;
+    if (clients < 1 || requests < 1 || window < 1) {
+        fprintf(stderr, "usage: %s [clients] [requests] [window] [file]\n", argv[0]);
+        return 1;
+    }
+
+    double start = now_seconds();
+    for (int i = 0; i < clients; i++) {
+        if (fork() == 0) {
+            _exit(run_client(requests, window, file));
+        }
+    }
+    int failures = 0, status;
+    while (wait(&status) > 0) {
+        failures += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    }
+    double elapsed = now_seconds() - start;
+
+    double total = (double)clients * requests;
+    printf("%d clients x %d requests, window %d: %.0f requests/s (%.3f s)%s\n", clients, requests, window,
+           total / elapsed, elapsed, failures ? "  [some clients failed]" : "");
+    return failures != 0;
+}
@@ -0,0 +1,180 @@
+/**
+ * @file launch_bench.c
+ * @brief Microbenchmark: pipeline launches per second, fork() versus posix_spawn().
+ *
+ * Compares the launcher the spooler used to have (fork a pipeline master, which
+ * forks and execs every stage and waits for them) with launch_pipeline(), which
+ * spawns the stages directly. Each "job" is a pipeline of /bin/true stages
+ * reading /dev/null and writing /dev/null, launched and waited for one at a time.
+ *
+ * fork() has to copy the caller's page tables, so the benchmark first touches a
+ * ballast buffer to give the process the footprint of a long-running spooler.
+ *
+ * Usage: bin/launch_bench [jobs] [stages] [ballast MiB]   (defaults: 500 3 256)
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "pipeline_launcher.h"
+
+/** @brief Upper bound on stages accepted on the command line. */
+#define MAX_BENCH_STAGES 16
+
+/** @brief Program run by every stage. */
+static char *true_argv[] = { "/bin/true", NULL };
+
+/**
+ * @brief Returns CLOCK_MONOTONIC in seconds.
+ */
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+/**
+ * @brief The former launcher: a forked master forks one child per stage.
+ *
+ * Mirrors the structure of the old start_conversion_pipeline(): new process
+ * group, a pipe between consecutive stages, and a master that exits with 1 if
+ * any stage failed.
+ */
+static pid_t fork_pipeline(int stages, int output_fd) {
+    pid_t master = fork();
+    if (master != 0) {
+        return master;
+    }
+
+    setpgid(0, 0);
+    int prev_fd = -1;
+    for (int i = 0; i < stages; i++) {
+        int pipefd[2];
+        int is_last = (i == stages - 1);
+        if (!is_last && pipe(pipefd) < 0) {
+            _exit(1);
+        }
+
+        pid_t stage = fork();
+        if (stage < 0) {
+            _exit(1);
+        }
+        if (stage == 0) {
+            int in = (i == 0) ? open("/dev/null", O_RDONLY) : prev_fd;
+            dup2(in, STDIN_FILENO);
+            close(in);
+            if (!is_last) {
+                close(pipefd[0]);
+                dup2(pipefd[1], STDOUT_FILENO);
+                close(pipefd[1]);
+            } else {
+                dup2(output_fd, STDOUT_FILENO);
+            }
+            execvp(true_argv[0], true_argv);
+            _exit(1);
+        }
+
+        if (prev_fd != -1) {
+            close(prev_fd);
+        }
+        if (!is_last) {
+            prev_fd = pipefd[0];
+            close(pipefd[1]);
+        }
+    }
+
+    int status, failed = 0;
+    while (wait(&status) > 0) {
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failed = 1;
+        }
+    }
+    _exit(failed);
+}
+
+/**
+ * @brief Runs `jobs` pipelines with the fork() launcher.
+ *
+ * @return Jobs per second.
+ */
+static double bench_fork(int jobs, int stages, int output_fd) {
+    double start = now_seconds();
+    for (int j = 0; j < jobs; j++) {
+        pid_t master = fork_pipeline(stages, output_fd);
+        if (master < 0 || waitpid(master, NULL, 0) < 0) {
+            perror("fork_pipeline");
+            exit(1);
+        }
+    }
+    return jobs / (now_seconds() - start);
+}
+
+/**
+ * @brief Runs `jobs` pipelines with launch_pipeline().
+ *
+ * @return Jobs per second.
+ */
+static double bench_spawn(int jobs, int stages, int output_fd) {
+    char **stage_argv[MAX_BENCH_STAGES];
+    pid_t pids[MAX_BENCH_STAGES];
+    for (int i = 0; i < stages; i++) {
+        stage_argv[i] = true_argv;
+    }
+
+    double start = now_seconds();
+    for (int j = 0; j < jobs; j++) {
+        if (launch_pipeline(stage_argv, stages, "/dev/null", output_fd, pids) < 0) {
+            perror("launch_pipeline");
+            exit(1);
+        }
+        for (int i = 0; i < stages; i++) {
+            if (pids[i] > 0) {
+                waitpid(pids[i], NULL, 0);
+            }
+        }
+    }
+    return jobs / (now_seconds() - start);
+}
+
+int main(int argc, char *argv[]) {
+    int jobs = (argc > 1) ? atoi(argv[1]) : 500;
+    int stages = (argc > 2) ? atoi(argv[2]) : 3;
+    size_t ballast_mib = (argc > 3) ? (size_t)atoi(argv[3]) : 256;
+
+    if (jobs <= 0 || stages <= 0 || stages > MAX_BENCH_STAGES) {
+        fprintf(stderr, "usage: %s [jobs] [stages (1-%d)] [ballast MiB]\n", argv[0], MAX_BENCH_STAGES);
+        return 1;
+    }
+
+    // Give the process a resident footprint comparable to a busy spooler
+    char *ballast = NULL;
+    if (ballast_mib > 0) {
+        ballast = malloc(ballast_mib << 20);
+        if (!ballast) {
+            perror("malloc");
+            return 1;
+        }
+        memset(ballast, 1, ballast_mib << 20);
+    }
+
+    int output_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (output_fd < 0) {
+        perror("/dev/null");
+        return 1;
+    }
+
+    printf("%d jobs of %d stage(s), %zu MiB resident\n", jobs, stages, ballast_mib);
+    double forked = bench_fork(jobs, stages, output_fd);
+    printf("  fork (master + stages): %10.1f jobs/s\n", forked);
+    double spawned = bench_spawn(jobs, stages, output_fd);
+    printf("  posix_spawn:            %10.1f jobs/s  (%.2fx)\n", spawned, spawned / forked);
+
+    close(output_fd);
+    free(ballast);
+    return 0;
+}
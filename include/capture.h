@@ -0,0 +1,69 @@
+/**
+ * @file capture.h
+ * @brief Declares the capture, which saves a producer's output into a file without copying it.
+ *
+ * A capture creates a pipe, hands its write end to the producer (typically the
+ * last stage of a conversion pipeline) and, from the event loop, moves whatever
+ * arrives in the pipe into a file with splice(), so the data never passes
+ * through user space. After every transfer the owner is told how long the file
+ * has grown, which lets it stream the file onward while it is still being
+ * written (see relay_start_growing()).
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <sys/types.h>
+
+/**
+ * @brief Callback invoked whenever the captured file has grown, and once when the capture ends.
+ *
+ * @param context The pointer supplied to capture_start().
+ * @param length  Number of bytes written to the file so far.
+ * @param done    Nonzero if the capture has ended (the producer closed the pipe, or an error occurred).
+ * @param error   0, or the errno that ended the capture early.
+ */
+typedef void capture_progress_func_t(void *context, off_t length, int done, int error);
+
+/**
+ * @struct capture
+ * @brief State of one pipe-to-file capture. Treat the fields as private.
+ */
+struct capture {
+    int pipe_fd;                        ///< Read end of the pipe, or -1 when the capture is not active.
+    int file_fd;                        ///< File being written, or -1.
+    off_t length;                       ///< Number of bytes written to the file.
+    capture_progress_func_t *progress;  ///< Progress callback.
+    void *context;                      ///< Opaque pointer passed to the callback.
+};
+
+typedef struct capture CAPTURE;
+
+/**
+ * @brief Initializes a capture as inactive. Must be called before any other function here.
+ */
+void capture_init(CAPTURE *capture);
+
+/**
+ * @brief Starts capturing into file_fd, from offset 0. The capture takes ownership of file_fd.
+ *
+ * @param capture  The capture to start; must not be active.
+ * @param file_fd  A regular file open for writing; it is closed when the capture ends.
+ * @param progress Callback run as the file grows and when the capture ends.
+ * @param context  Opaque pointer passed to the callback.
+ * @return The close-on-exec write end of the pipe, which the caller passes to the
+ *         producer and then closes; or -1 on failure (file_fd is closed).
+ */
+int capture_start(CAPTURE *capture, int file_fd, capture_progress_func_t *progress, void *context);
+
+/**
+ * @brief Abandons a capture and closes its descriptors. The callback is not run.
+ */
+void capture_cancel(CAPTURE *capture);
+
+/**
+ * @brief Reports whether a capture is currently active (started and not yet ended).
+ */
+int capture_is_active(const CAPTURE *capture);
+
+#endif // CAPTURE_H
@@ -26,6 +26,58 @@
 
 #include <stdio.h>  ///< For FILE*
 
+/** @brief Length of the longest command name ("conversion"). */
+#define MAX_COMMAND_NAME 10
+
+/** @brief Indices of the commands in the command table, in the order 'help' lists them. */
+enum command_index {
+    COMMAND_HELP,
+    COMMAND_QUIT,
+    COMMAND_TYPE,
+    COMMAND_PRINTER,
+    COMMAND_CONVERSION,
+    COMMAND_PRINTERS,
+    COMMAND_JOBS,
+    COMMAND_PRINT,
+    COMMAND_CANCEL,
+    COMMAND_DISABLE,
+    COMMAND_ENABLE,
+    COMMAND_PAUSE,
+    COMMAND_RESUME,
+    COMMAND_STATS,
+    COMMAND_COUNT
+};
+
+/**
+ * @brief Runs one command whose argument count has already been checked.
+ *
+ * @param argv The command's tokens; argv[0] is the command name.
+ * @param argc Number of tokens.
+ * @param out  Output stream for user-facing messages.
+ */
+typedef void command_handler_func_t(char **argv, int argc, FILE *out);
+
+/**
+ * @struct command_descriptor
+ * @brief Everything the spooler knows about one command.
+ */
+typedef struct command_descriptor {
+    const char *name;                 ///< The command keyword.
+    command_handler_func_t *handler;  ///< Runs the command.
+    int min_args;                     ///< Fewest arguments accepted (not counting the name).
+    int max_args;                     ///< Most arguments accepted, or -1 for no limit.
+    const char *usage;                ///< The arguments, as shown by the full help text.
+    const char *help;                 ///< One-line description.
+} COMMAND_DESCRIPTOR;
+
+/**
+ * @brief Finds the descriptor of a command by name, in constant time.
+ *
+ * @param name A command keyword.
+ * @return The descriptor, or NULL if no command has that name.
+ */
+const COMMAND_DESCRIPTOR *find_command(const char *name);
+
 /**
  * @brief Dispatches a tokenized user command to the appropriate handler in the presi spooler.
  *
@@ -0,0 +1,96 @@
+/**
+ * @file control_socket.h
+ * @brief Declares the control socket, through which programs submit and manage jobs.
+ *
+ * The spooler listens on the Unix-domain stream socket CONTROL_SOCKET_PATH
+ * and serves any number of clients (up to MAX_CONTROL_CLIENTS at once) from
+ * the event loop, alongside the CLI. The protocol is binary and length
+ * prefixed; every integer is in host byte order, since both ends are on the
+ * same machine.
+ *
+ * Each request and each response is a CONTROL_HEADER followed by length bytes
+ * of payload. A client may send any number of requests without waiting for
+ * the responses (pipelining); they are carried out in order, and each response
+ * repeats the opcode and the tag of its request.
+ *
+ * | Opcode          | Request payload    | Response payload on CONTROL_OK                   |
+ * |-----------------|--------------------|--------------------------------------------------|
+ * | CONTROL_SUBMIT  | file path (no NUL) | int32_t job ID                                   |
+ * | CONTROL_CANCEL  | int32_t job ID     | none                                             |
+ * | CONTROL_PAUSE   | int32_t job ID     | none                                             |
+ * | CONTROL_RESUME  | int32_t job ID     | none                                             |
+ * | CONTROL_QUERY   | int32_t job ID     | CONTROL_JOB_INFO, then the job's file path       |
+ *
+ * A request that cannot be carried out is answered with CONTROL_FAILED and no
+ * payload. A malformed request (unknown opcode, wrong payload size) is answered
+ * with CONTROL_BAD_REQUEST; if its length exceeds CONTROL_MAX_PAYLOAD, the
+ * connection is closed after that response, since the stream cannot be resynchronized.
+ *
+ * The socket is only opened if the CONTROL_ENV environment variable is set.
+ */
+
+#ifndef CONTROL_SOCKET_H
+#define CONTROL_SOCKET_H
+
+#include <stdint.h>
+
+/** @brief Environment variable that turns the control socket on when set. */
+#define CONTROL_ENV "PRESI_CONTROL"
+
+/** @brief Path of the control socket. */
+#define CONTROL_SOCKET_PATH "spool/presi.ctl"
+
+/** @brief Maximum number of clients connected at once; further connections are closed. */
+#define MAX_CONTROL_CLIENTS 64
+
+/** @brief Largest payload accepted in a request. */
+#define CONTROL_MAX_PAYLOAD 4096
+
+/** @brief Request types. */
+enum control_opcode {
+    CONTROL_SUBMIT = 1,  ///< Submit a file for printing on any eligible printer.
+    CONTROL_CANCEL,      ///< Cancel a job.
+    CONTROL_PAUSE,       ///< Pause a running job.
+    CONTROL_RESUME,      ///< Resume a paused job.
+    CONTROL_QUERY        ///< Report a job's status.
+};
+
+/** @brief Response statuses. */
+enum control_status {
+    CONTROL_OK = 0,          ///< The request was carried out.
+    CONTROL_FAILED = 1,      ///< The request was well formed but could not be carried out.
+    CONTROL_BAD_REQUEST = 2  ///< The request was malformed.
+};
+
+/**
+ * @struct control_header
+ * @brief The header of every request and response.
+ */
+typedef struct control_header {
+    uint32_t length;  ///< Number of payload bytes that follow.
+    uint32_t tag;     ///< Chosen by the client; copied into the response.
+    uint16_t opcode;  ///< A control_opcode.
+    uint16_t status;  ///< 0 in requests; a control_status in responses.
+} CONTROL_HEADER;
+
+/**
+ * @struct control_job_info
+ * @brief The fixed part of a CONTROL_QUERY response.
+ */
+typedef struct control_job_info {
+    int32_t job_id;      ///< The job's ID.
+    int32_t status;      ///< Its JOB_STATUS.
+    int32_t printer_id;  ///< The printer it runs on, or -1.
+} CONTROL_JOB_INFO;
+
+/**
+ * @brief Opens the control socket if CONTROL_ENV is set and registers it with the event loop.
+ *
+ * A socket file left by an earlier run is replaced. Must be called after the
+ * event loop has been initialized.
+ *
+ * @return 0 on success (or if the control socket is off), -1 on failure.
+ */
+int control_socket_open(void);
+
+#endif // CONTROL_SOCKET_H
@@ -0,0 +1,48 @@
+/**
+ * @file conversion_cache.h
+ * @brief Declares a memoizing front end to find_conversion_path() for the presi spooler.
+ *
+ * The conversions module performs a fresh graph search, and allocates a new
+ * result array, every time a conversion path is requested. The scheduler asks
+ * for the same (from, to) pairs over and over, so this module keeps an N×N table
+ * of results indexed by FILE_TYPE.index. Cached paths are shared: callers must
+ * neither modify nor free them. The table is emptied whenever a conversion is
+ * (re)defined, since that can change any path.
+ */
+
+#ifndef CONVERSION_CACHE_H
+#define CONVERSION_CACHE_H
+
+#include "printer_manager.h"  ///< Provides MAX_FILE_TYPES and FILE_TYPE
+
+/* Forward declaration of CONVERSION; conversions.h has no include guard, so it is left to the .c files. */
+struct conversion;
+typedef struct conversion CONVERSION;
+
+/**
+ * @brief Prepares an empty path cache. Must be called once before any lookup.
+ */
+void conversion_cache_initialize(void);
+
+/**
+ * @brief Releases every cached path.
+ */
+void conversion_cache_cleanup(void);
+
+/**
+ * @brief Discards all cached paths; call after any conversion has been defined.
+ */
+void invalidate_conversion_paths(void);
+
+/**
+ * @brief Returns the conversion path between two file types, computing it only on a miss.
+ *
+ * @param from The type of the input data.
+ * @param to   The type that has to be produced.
+ * @return A NULL-terminated, shared array of conversions (empty when from and to are
+ *         the same type), or NULL if no path exists. The array stays valid until the
+ *         cache is next invalidated and must not be freed by the caller.
+ */
+CONVERSION *const *lookup_conversion_path(FILE_TYPE *from, FILE_TYPE *to);
+
+#endif // CONVERSION_CACHE_H
@@ -0,0 +1,87 @@
+/**
+ * @file event_loop.h
+ * @brief Declares the epoll-based event loop that drives the presi spooler.
+ *
+ * Every source of work the spooler reacts to — command input, child process
+ * state changes (through a signalfd), timers — is a file descriptor registered
+ * here together with a callback. The CLI blocks in event_loop_run_once() and the
+ * loop invokes the callbacks of whichever descriptors became ready, so job
+ * completions are handled as soon as they happen rather than only between
+ * commands.
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdint.h>
+
+/**
+ * @brief Callback invoked when a registered descriptor becomes ready.
+ *
+ * @param fd      The descriptor that became ready.
+ * @param events  The epoll event bits that were reported (EPOLLIN, EPOLLOUT, EPOLLHUP, ...).
+ * @param context The pointer supplied when the descriptor was registered.
+ */
+typedef void event_handler_func_t(int fd, uint32_t events, void *context);
+
+/**
+ * @brief Creates the epoll instance. Must be called once before any other function here.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int event_loop_initialize(void);
+
+/**
+ * @brief Closes the epoll instance and forgets every registration.
+ */
+void event_loop_cleanup(void);
+
+/**
+ * @brief Registers a descriptor with the loop.
+ *
+ * @param fd      The descriptor to watch (must not be a regular file).
+ * @param events  The epoll events of interest, e.g. EPOLLIN.
+ * @param handler Callback to run when the descriptor is ready.
+ * @param context Opaque pointer passed back to the handler.
+ * @return 0 on success, -1 on failure.
+ */
+int event_loop_add(int fd, uint32_t events, event_handler_func_t *handler, void *context);
+
+/**
+ * @brief Changes the set of events watched for a registered descriptor.
+ *
+ * @param fd     A descriptor previously passed to event_loop_add().
+ * @param events The new set of epoll events.
+ * @return 0 on success, -1 on failure.
+ */
+int event_loop_modify(int fd, uint32_t events);
+
+/**
+ * @brief Stops watching a descriptor. It is safe to call this from inside a handler,
+ * including for a descriptor whose event is still pending in the current batch.
+ *
+ * @param fd The descriptor to remove. The caller remains responsible for closing it.
+ * @return 0 on success, -1 if the descriptor was not registered.
+ */
+int event_loop_remove(int fd);
+
+/**
+ * @brief Waits for ready descriptors and runs their handlers once.
+ *
+ * @param timeout_ms Maximum time to block in milliseconds; 0 polls, -1 blocks indefinitely.
+ * @return The number of events handled, or -1 on error. Interruption by a signal counts as 0 events.
+ */
+int event_loop_run_once(int timeout_ms);
+
+/**
+ * @brief Returns when the batch of events being handled was received.
+ *
+ * Handlers use it to measure how long an event waited behind the others of
+ * its batch, such as the delay between a pipeline stage's exit being reported
+ * and the stage being reaped.
+ *
+ * @return The CLOCK_MONOTONIC time in nanoseconds at which the last epoll_wait() returned.
+ */
+uint64_t event_loop_wake_time_ns(void);
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,50 @@
+/**
+ * @file event_ring.h
+ * @brief Declares the ring buffer through which spooler events reach the sf_* event functions.
+ *
+ * Each sf_* call may be a write to the event tracker's socket. Rather than
+ * make those calls in the middle of dispatching or reaping jobs, the job and
+ * printer managers (and the command handler, whose sf_cmd_ok() and
+ * sf_cmd_error() must stay in order with them) call the emit_* functions
+ * below, which append a compact record to a single-producer, single-consumer
+ * ring and return. event_ring_drain() then makes the sf_* calls for every
+ * pending record, in order, as one batch.
+ *
+ * The CLI drains the ring once per pass of its loop, after the event loop has
+ * run, and before every command, so events from conversions.o (sf_type_defined()
+ * and sf_conversion_defined(), which are called directly) keep their place
+ * in the sequence. A producer that finds the ring full drains it itself.
+ */
+
+#ifndef EVENT_RING_H
+#define EVENT_RING_H
+
+#include <stdio.h>  // presi.h uses FILE
+
+#include "presi.h"
+
+/** @brief Capacity of the ring in bytes; a power of two. */
+#define EVENT_RING_SIZE 65536
+
+/** @brief Largest record kept in the ring; larger events are delivered at once, after draining. */
+#define EVENT_RECORD_MAX 4096
+
+void emit_cmd_ok(void);
+void emit_cmd_error(char *msg);
+
+void emit_printer_defined(char *name, char *type);
+void emit_printer_status(char *name, PRINTER_STATUS status);
+
+void emit_job_created(int id, char *file_name, char *file_type);
+void emit_job_started(int id, char *printer, int pgid, char **path);
+void emit_job_finished(int id, int status);
+void emit_job_aborted(int id, int status);
+void emit_job_deleted(int id);
+void emit_job_status(int id, JOB_STATUS status);
+
+/**
+ * @brief Delivers every pending event to its sf_* function, oldest first.
+ */
+void event_ring_drain(void);
+
+#endif // EVENT_RING_H
@@ -0,0 +1,49 @@
+/**
+ * @file file_splitter.h
+ * @brief Declares the splitter that cuts a print file into chunks at page or record boundaries.
+ *
+ * A large document can be printed faster on several idle printers at once,
+ * one chunk each. Chunks are cut only right after a delimiter, so that every
+ * chunk is a whole number of pages: after a form feed (the page delimiter of
+ * plain text and PCL) if the file contains any, and otherwise after a newline
+ * (one record per line). The cuts are placed as close as possible to equal
+ * shares of the file's size.
+ *
+ * Each chunk is written to its own file under SPLIT_DIR; the data is copied
+ * inside the kernel with copy_file_range() where the filesystem allows it.
+ */
+
+#ifndef FILE_SPLITTER_H
+#define FILE_SPLITTER_H
+
+/** @brief Directory holding the chunk files. */
+#define SPLIT_DIR "spool/split"
+
+/** @brief Delimiter preferred for cuts: the form feed that ends a page. */
+#define PAGE_DELIMITER '\f'
+
+/** @brief Delimiter used for cuts when the file has no pages: the end of a line. */
+#define RECORD_DELIMITER '\n'
+
+/**
+ * @brief Cuts a file into at most max_chunks chunk files.
+ *
+ * @param input_path  The file to split.
+ * @param max_chunks  Maximum number of chunks wanted.
+ * @param tag         Number making the chunk file names unique (for instance a job ID).
+ * @param chunk_paths Receives max_chunks newly allocated paths at most, one per chunk, in file order.
+ * @return The number of chunks written (at least 2), 0 if the file has too few
+ *         delimiters to be split, or -1 on error. No file is left behind unless
+ *         the return value is at least 2.
+ */
+int split_file(const char *input_path, int max_chunks, int tag, char *chunk_paths[]);
+
+/**
+ * @brief Removes chunk files and frees their paths.
+ *
+ * @param chunk_paths Paths returned by split_file().
+ * @param count       Number of paths.
+ */
+void discard_chunk_files(char *chunk_paths[], int count);
+
+#endif // FILE_SPLITTER_H
@@ -6,9 +6,12 @@
  *   - Creation of a job with a specified file path and optional printer
  *   - Determination of compatible printers and invocation of conversion pipelines
  *   - Handling of user commands to pause, resume, or cancel a job
- *   - Automatic removal of jobs that have been finished or aborted for more than 10 seconds
+ *   - Automatic removal of jobs that have been finished or aborted for more than 10 seconds,
+ *     driven by a per-job timer on the timer wheel
  *
- * Internally, a fixed-size array stores active jobs, each associated with a unique ID.
+ * Internally, jobs live in a fixed-size slab of slots. Each job is given a unique,
+ * monotonically increasing ID that is resolved to its slot through a hash, so IDs
+ * stay valid however many other jobs are created or deleted in the meantime.
  * Functions in this module ensure concurrency control, status transitions, and
  * event reporting through sf_event calls. Other components (CLI, printer_manager) rely on
  * this module to handle job-related logic cleanly and consistently.
@@ -17,9 +20,21 @@
 #ifndef JOB_MANAGER_H
 #define JOB_MANAGER_H
 
+#include <signal.h>  // For siginfo_t
+
 #include "printer_struct.h"
 #include "job_struct.h"
 #include "presi.h"  // For MAX_JOBS definition
+#include "printer_manager.h"  // For MAX_FILE_TYPES
+
+/**
+ * @brief Opaque 64-bit reference to a job slot: the slot index in the low half
+ * and the slot's generation in the high half.
+ *
+ * Unlike a raw JOB pointer, a handle detects reuse of the slot: once the job it
+ * was taken from is deleted, get_job_by_handle() returns NULL for it.
+ */
+typedef uint64_t JOB_HANDLE;
 
 /**
  * @brief Initializes the job manager by resetting counters and clearing the job array.
@@ -47,10 +62,37 @@ void job_manager_cleanup(void);
  *
  * @param file_path       The path of the file to be printed (non-null).
  * @param assigned_printer A pointer to a PRINTER to use, or NULL to auto-select.
- * @return 0 on success, -1 if submission failed (e.g., no printers available or invalid file).
+ * @return The new job's ID on success, -1 if submission failed (e.g., no printers available or invalid file).
  */
 int submit_print_job(const char* file_path, PRINTER* assigned_printer);
 
+/**
+ * @brief Submits one copy of a file for each of several printers.
+ *
+ * - Every printer must be idle and of the same type, and the file printable on it
+ * - All copies start immediately; if a conversion is needed, it runs only once
+ *   and its output is sent to every printer as it is produced
+ *
+ * @param file_path The path of the file to be printed (non-null).
+ * @param printers  The printers, each listed at most once.
+ * @param count     Number of printers (at least 1).
+ * @return 0 on success, -1 if submission failed (no job is created in that case).
+ */
+int submit_print_copies(const char* file_path, PRINTER* printers[], int count);
+
+/**
+ * @brief Submits a file to be printed in chunks, in parallel, on the idle printers able to print it.
+ *
+ * - The file is cut after page breaks (form feeds), or after line ends if it has none
+ * - Each chunk is a job of its own; a parent job finishes once every chunk has terminated
+ * - Canceling, pausing or resuming the parent applies to all of its chunks
+ * - A file that cannot be split, or fewer than two idle printers, give an ordinary job
+ *
+ * @param file_path The path of the file to be printed (non-null).
+ * @return 0 on success, -1 if submission failed (e.g., invalid file or full spool).
+ */
+int submit_split_job(const char* file_path);
+
 /**
  * @brief Tries to start any pending jobs that are in JOB_CREATED state.
  *
@@ -58,19 +100,71 @@ int submit_print_job(const char* file_path, PRINTER* assigned_printer);
  * - A new printer becomes idle
  * - A job completes, freeing its printer
  *
- * Scans the array of jobs, and for each JOB_CREATED job, checks if a printer
- * can handle its file type (directly or via conversion). If found, starts the
- * conversion pipeline, marking the job as JOB_RUNNING.
+ * Waiting jobs are kept in one FIFO per file type, so a pass looks only at
+ * the head of each non-empty queue. A head may run on any idle printer among
+ * its eligible printers (directly or via conversion), and the lowest one is
+ * picked from the idle and eligible masks with ffs(). Each round dispatches
+ * the oldest head that has such a printer, marking it JOB_RUNNING, so jobs
+ * start in submission order across types. A queue whose head has no idle
+ * printer is skipped for the rest of the pass.
  */
 void try_scheduling_jobs(void);
 
 /**
- * @brief Retrieves a job by its 0-based index in the internal job array.
+ * @brief Recomputes which printers each waiting job may use, then tries to schedule.
+ *
+ * Must be called after a printer is declared or a conversion is defined.
+ */
+void refresh_job_eligibility(void);
+
+/**
+ * @brief Looks up a live job by the ID reported when it was created.
  *
- * @param index The job index to look up.
- * @return A pointer to the job at the specified index, or NULL if invalid.
+ * @param job_id The job ID (as used by `cancel`, `pause` and `resume`).
+ * @return A pointer to the job, or NULL if no live job has that ID.
  */
-JOB* get_job_by_index(int index);
+JOB* get_job_by_id(int job_id);
+
+/**
+ * @brief Returns a generation-tagged handle for a live job.
+ *
+ * @param job A job obtained from this module.
+ * @return A handle that can later be resolved with get_job_by_handle().
+ */
+JOB_HANDLE get_job_handle(const JOB* job);
+
+/**
+ * @brief Resolves a handle previously returned by get_job_handle().
+ *
+ * @param handle The handle to resolve.
+ * @return The job, or NULL if it has been deleted since the handle was taken.
+ */
+JOB* get_job_by_handle(JOB_HANDLE handle);
+
+/**
+ * @brief Returns the oldest live job, to start an iteration in creation order.
+ *
+ * @return The first job, or NULL if no jobs are tracked.
+ */
+JOB* get_first_job(void);
+
+/**
+ * @brief Returns the job created after the given one.
+ *
+ * @param job A live job.
+ * @return The next job in creation order, or NULL at the end.
+ */
+JOB* get_next_job(const JOB* job);
+
+/**
+ * @brief Finds the job whose conversion pipeline runs in the given process group.
+ *
+ * Constant time: pipelines with unreaped stages are kept in a hash keyed by process group.
+ *
+ * @param pgid The pipeline's process group ID.
+ * @return The job, or NULL if no live job owns that process.
+ */
+JOB* get_job_by_pgid(pid_t pgid);
 
 /**
  * @brief Reports how many jobs are currently tracked (in any state).
@@ -80,12 +174,16 @@ JOB* get_job_by_index(int index);
 int get_job_count(void);
 
 /**
- * @brief Deletes jobs that have stayed in FINISHED or ABORTED state for more than 10 seconds.
+ * @brief Applies a waitid() stop or continue report for a process of a job's pipeline.
  *
- * Called periodically (e.g., after each user command). Ensures the system cleans up jobs
- * that no longer need to be tracked, preventing accumulation of stale data.
+ * Stopped and continued reports move the job between JOB_PAUSED and JOB_RUNNING;
+ * repeated reports from the other stages of the same pipeline are ignored.
+ * Exits are tracked by the job manager itself through each stage's pidfd.
+ *
+ * @param job  The job that owns the reported process.
+ * @param info The report filled in by waitid().
  */
-void delete_expired_jobs_if_needed(void);
+void update_job_from_child_event(JOB* job, const siginfo_t* info);
 
 /**
  * @brief Cancels an active or created job, stopping its pipeline if necessary.
@@ -118,4 +216,33 @@ int pause_job(int job_id);
  */
 int resume_job(int job_id);
 
+/**
+ * @struct job_metrics
+ * @brief A snapshot of the job manager's gauges and counters, for the metrics exporter.
+ */
+typedef struct job_metrics {
+    unsigned long jobs_submitted;              ///< Jobs submitted since startup.
+    unsigned long pipelines_launched;          ///< Conversion pipelines with at least one stage started.
+    unsigned long spawn_failures;              ///< Pipeline stages that could not be started.
+    int jobs_by_status[JOB_DELETED + 1];       ///< Tracked jobs in each JOB_STATUS.
+    int queue_depth[MAX_FILE_TYPES];           ///< Jobs waiting for a printer, by FILE_TYPE.index.
+    const char *type_names[MAX_FILE_TYPES];    ///< Name of each type a job has been submitted for, else NULL.
+    uint64_t reap_count;                       ///< Pipeline stages reaped.
+    uint64_t reap_sum_ns;                      ///< Total of their reap latencies.
+    uint64_t reap_p50_ns;                      ///< Median reap latency.
+    uint64_t reap_p99_ns;                      ///< 99th percentile reap latency.
+    uint64_t reap_max_ns;                      ///< Largest reap latency.
+} JOB_METRICS;
+
+/**
+ * @brief Takes a snapshot of the job manager's metrics.
+ *
+ * The reap latency of a stage is the time between the event loop receiving
+ * the report of its exit and the stage being reaped, i.e. how long the exit
+ * waited behind the other events of the same batch.
+ *
+ * @param metrics Receives the snapshot.
+ */
+void job_manager_get_metrics(JOB_METRICS *metrics);
+
 #endif // JOB_MANAGER_H
@@ -8,6 +8,7 @@
  *   - Current status (CREATED, RUNNING, etc.)
  *   - Process group ID for sending control signals (pause, resume, cancel)
  *   - Timestamps for creation and status changes (used for cleanup timing)
+ *   - Monotonic timestamps of submission, dispatch, first byte and exit (for latency statistics)
  *
  * This structure is used throughout the spooler to track and operate on print jobs,
  * from creation and scheduling to final cleanup.
@@ -16,6 +17,7 @@
 #ifndef JOB_STRUCT_H
 #define JOB_STRUCT_H
 
+#include <stdint.h>     ///< Provides uint32_t for the printer eligibility mask
 #include <sys/types.h>  ///< Defines pid_t for process group tracking
 #include <time.h>       ///< Provides time_t for timestamps
 
@@ -47,6 +49,22 @@ struct job
      */
     char* input_file_path;
 
+    /**
+     * @brief File type inferred from the input file name at submission time.
+     *
+     * Cached so the scheduler never has to infer the type of a queued job again;
+     * its index selects the ready queue the job waits in.
+     */
+    FILE_TYPE* file_type;
+
+    /**
+     * @brief Bitmask of the printers able to print this job (bit i is the printer with ID i).
+     *
+     * Covers printers of the job's own type and printers reachable through a
+     * conversion path; a job submitted for a specific printer has only that bit set.
+     */
+    uint32_t eligible_printers;
+
     /**
      * @brief The printer selected to handle this job, if any.
      *
@@ -71,8 +89,9 @@ struct job
     /**
      * @brief The process group ID of the conversion pipeline handling this job.
      *
-     * All processes in the pipeline share this PGID, allowing group-wide signals
-     * (e.g., SIGSTOP, SIGCONT, SIGTERM) to pause, resume, or cancel the pipeline.
+     * All processes in the pipeline share this PGID, which is the PID of its
+     * first stage. It identifies the job in stop/continue reports; the signals
+     * that pause, resume, or cancel the pipeline are sent to each stage's pidfd.
      */
     pid_t pgid;
 
@@ -90,6 +109,19 @@ struct job
      * how long the job remains in the system before deletion.
      */
     time_t status_changed_at;
+
+    /**
+     * @brief Monotonic timestamps (latency_now_ns()) of the job's life, 0 until reached.
+     *
+     * submitted_ns is taken when the job is created, dispatched_ns when it is
+     * started on a printer, first_byte_ns when its printer receives the first
+     * byte (known only when the spooler relays the output), and exited_ns
+     * when it finishes or is aborted. They feed the histograms of latency_stats.h.
+     */
+    uint64_t submitted_ns;
+    uint64_t dispatched_ns;
+    uint64_t first_byte_ns;
+    uint64_t exited_ns;
 };
 
 #endif // JOB_STRUCT_H
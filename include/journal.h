@@ -0,0 +1,108 @@
+/**
+ * @file journal.h
+ * @brief Declares the write-ahead journal that lets the spooler survive a crash or a restart.
+ *
+ * Every change to the spooler's configuration (file types, conversions,
+ * printers, enabled printers) and every job submission and termination is
+ * appended to a journal file in spool/ as a line of text. The configuration
+ * lines are the CLI commands themselves; jobs are recorded as
+ *
+ *     job <ticket> <file>
+ *     end <ticket>
+ *
+ * where the ticket is a number given by the journal that never repeats.
+ *
+ * Lines are buffered and written by a group commit: one write() and one
+ * fdatasync() every JOURNAL_COMMIT_MS for all the changes made in between, so
+ * a burst of commands costs a single disk flush. At most the last
+ * JOURNAL_COMMIT_MS worth of changes can be lost in a crash.
+ *
+ * The journal is kept short by snapshots. Once JOURNAL_SNAPSHOT_RECORDS lines
+ * have been appended, the current state (configuration plus the jobs that
+ * have not terminated) is written to JOURNAL_SNAPSHOT, and a new, empty
+ * journal file is started. The snapshot names the journal file that follows
+ * it, so replacing it with rename() switches both at once, and recovery reads
+ * one snapshot and one short journal no matter how long the history is.
+ *
+ * On startup, the recovered configuration is applied again through the CLI
+ * commands and every job that had not terminated is submitted again, from the
+ * beginning of its file, as an ordinary queued job.
+ *
+ * The journal is off unless the JOURNAL_ENV environment variable is set.
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+
+/** @brief Environment variable that turns the journal on when set. */
+#define JOURNAL_ENV "PRESI_JOURNAL"
+
+/** @brief The snapshot file. */
+#define JOURNAL_SNAPSHOT "spool/journal.snap"
+
+/** @brief Format of the name of the journal file of a given generation. */
+#define JOURNAL_LOG_FORMAT "spool/journal.%llu.log"
+
+/** @brief Milliseconds during which appended lines are gathered into one commit. */
+#define JOURNAL_COMMIT_MS 10
+
+/** @brief Number of lines appended to the journal file after which a snapshot is taken. */
+#define JOURNAL_SNAPSHOT_RECORDS 4096
+
+/**
+ * @brief Callback that carries out one recovered CLI command.
+ *
+ * @param command The command line, without a newline; it may be modified.
+ * @param context The pointer supplied to journal_open().
+ */
+typedef void journal_apply_func_t(char *command, void *context);
+
+/**
+ * @brief Turns the journal on if JOURNAL_ENV is set, and recovers the state it holds.
+ *
+ * The recovered configuration commands are passed to apply first, and then one
+ * `print <file>` command for each job that had not terminated. The journal
+ * does not record the configuration commands again while they are applied.
+ * A new snapshot of the resulting state is then written. Must be called after
+ * the timer wheel has been initialized.
+ *
+ * @param apply   Callback carrying out each recovered command.
+ * @param context Opaque pointer passed to the callback.
+ * @return 0 on success (or if the journal is off), -1 if the journal could not be opened.
+ */
+int journal_open(journal_apply_func_t *apply, void *context);
+
+/**
+ * @brief Records a configuration command that has just succeeded.
+ *
+ * Only type, conversion, printer, enable and disable commands are meaningful.
+ * Does nothing if the journal is off or while journal_open() replays commands.
+ *
+ * @param argv The command's tokens.
+ * @param argc Number of tokens.
+ */
+void journal_record_command(char **argv, int argc);
+
+/**
+ * @brief Records the submission of a job.
+ *
+ * @param file_path The file the job prints.
+ * @return The job's ticket, to be passed to journal_record_job_end(); 0 if the journal is off.
+ */
+uint64_t journal_record_job(const char *file_path);
+
+/**
+ * @brief Records that a job has terminated (finished or aborted) and need not be recovered.
+ *
+ * @param ticket The job's ticket; 0 is ignored.
+ */
+void journal_record_job_end(uint64_t ticket);
+
+/**
+ * @brief Writes and flushes every buffered line now, without waiting for the group commit.
+ */
+void journal_sync(void);
+
+#endif // JOURNAL_H
@@ -0,0 +1,105 @@
+/**
+ * @file latency_stats.h
+ * @brief Declares the job latency histograms behind the 'stats' command.
+ *
+ * Every job carries CLOCK_MONOTONIC timestamps of its submission, its dispatch
+ * to a printer, the first byte its printer received, and its termination.
+ * From them the job manager records, per job:
+ *
+ *   - queue wait:    dispatch - submission
+ *   - first byte:    first byte - dispatch (when the spooler relays the output)
+ *   - runtime:       termination - dispatch
+ *   - end to end:    termination - submission
+ *
+ * Each metric is kept in one histogram for all jobs, one per printer and one
+ * per file type. The histograms are log-linear, in the manner of HdrHistogram:
+ * values below 2^LATENCY_SUB_BUCKET_BITS nanoseconds have a bucket each, and
+ * every power of two above that is split into 2^(LATENCY_SUB_BUCKET_BITS - 1)
+ * equal buckets, so a percentile is exact to within 1 part in 32 whatever
+ * its magnitude, recording is a few shifts and an increment, and the size is fixed.
+ */
+
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "printer_manager.h"  ///< Provides PRINTER, FILE_TYPE, MAX_PRINTERS and MAX_FILE_TYPES
+
+/** @brief Values below 2^LATENCY_SUB_BUCKET_BITS are exact; above, relative precision is 2^-(bits - 1). */
+#define LATENCY_SUB_BUCKET_BITS 6
+
+/** @brief Largest power of two tracked; longer durations (over 4.8 hours) count as the largest value. */
+#define LATENCY_MAX_MAGNITUDE 44
+
+/** @brief Number of buckets in a histogram. */
+#define LATENCY_BUCKETS \
+    ((LATENCY_MAX_MAGNITUDE - LATENCY_SUB_BUCKET_BITS + 3) << (LATENCY_SUB_BUCKET_BITS - 1))
+
+/** @brief The measured intervals. */
+enum latency_metric {
+    LATENCY_QUEUE_WAIT,   ///< Submission to dispatch.
+    LATENCY_FIRST_BYTE,   ///< Dispatch to the first byte received by the printer.
+    LATENCY_RUNTIME,      ///< Dispatch to termination.
+    LATENCY_END_TO_END,   ///< Submission to termination.
+    LATENCY_METRIC_COUNT
+};
+
+/**
+ * @struct latency_histogram
+ * @brief A histogram of durations in nanoseconds.
+ */
+typedef struct latency_histogram {
+    uint64_t count;                     ///< Number of values recorded.
+    uint64_t sum;                       ///< Sum of the values recorded.
+    uint64_t max;                       ///< Largest value recorded.
+    uint32_t buckets[LATENCY_BUCKETS];  ///< Number of values in each bucket.
+} LATENCY_HISTOGRAM;
+
+/**
+ * @brief Returns the current CLOCK_MONOTONIC time in nanoseconds; never 0.
+ */
+uint64_t latency_now_ns(void);
+
+/**
+ * @brief Records one duration in the overall histogram of a metric and in
+ * those of the printer and the file type, when given.
+ *
+ * @param metric  The metric measured.
+ * @param printer The printer concerned, or NULL.
+ * @param type    The file type of the job, or NULL.
+ * @param ns      The duration in nanoseconds.
+ */
+void latency_record(enum latency_metric metric, const PRINTER *printer, const FILE_TYPE *type, uint64_t ns);
+
+/**
+ * @brief Adds one duration to a histogram.
+ *
+ * For histograms kept outside this module, such as the job manager's reap latency.
+ *
+ * @param histogram The histogram, zero-initialized before first use.
+ * @param ns        The duration in nanoseconds.
+ */
+void latency_histogram_record(LATENCY_HISTOGRAM *histogram, uint64_t ns);
+
+/**
+ * @brief Returns the value below which the fraction quantile of the recorded values lie.
+ *
+ * The result is the largest value of the bucket holding that rank, so it is
+ * never below the true percentile, and never above the largest value recorded.
+ *
+ * @param histogram The histogram.
+ * @param quantile  Between 0 and 1, e.g. 0.99 for p99.
+ * @return The duration in nanoseconds, or 0 if nothing has been recorded.
+ */
+uint64_t latency_percentile(const LATENCY_HISTOGRAM *histogram, double quantile);
+
+/**
+ * @brief Prints count, p50, p99, p999 and the maximum of every non-empty histogram.
+ *
+ * @param out Output stream.
+ */
+void latency_stats_print(FILE *out);
+
+#endif // LATENCY_STATS_H
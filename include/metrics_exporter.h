@@ -0,0 +1,45 @@
+/**
+ * @file metrics_exporter.h
+ * @brief Declares the exporter that serves the spooler's metrics to Prometheus.
+ *
+ * The exporter listens on the Unix-domain stream socket METRICS_SOCKET_PATH
+ * and answers every connection with the current metrics in the Prometheus
+ * text exposition format (version 0.0.4): as an HTTP/1.0 response if the
+ * client sends an HTTP GET request, and as bare text otherwise, so that both
+ * a scraper and `socat - UNIX-CONNECT:spool/presi.metrics` can read it.
+ *
+ * Connections are served by a thread of their own, which never touches the
+ * spooler's data structures. Instead, every METRICS_PUBLISH_MS the main loop
+ * takes snapshots of the job manager's, the printer manager's and the output
+ * cache's counters (see job_manager_get_metrics() and its siblings) and
+ * publishes them with a sequence lock; the thread copies the latest snapshot
+ * and formats it. Scrapes thus cost the main loop nothing, and a slow scraper
+ * cannot delay a job.
+ *
+ * The exporter is only started if the METRICS_ENV environment variable is set.
+ */
+
+#ifndef METRICS_EXPORTER_H
+#define METRICS_EXPORTER_H
+
+/** @brief Environment variable that turns the exporter on when set. */
+#define METRICS_ENV "PRESI_METRICS"
+
+/** @brief Path of the metrics socket. */
+#define METRICS_SOCKET_PATH "spool/presi.metrics"
+
+/** @brief Interval between snapshots, and so the greatest age of the metrics served. */
+#define METRICS_PUBLISH_MS 1000
+
+/**
+ * @brief Starts the exporter if METRICS_ENV is set.
+ *
+ * Opens the socket (replacing one left by an earlier run), publishes a first
+ * snapshot, schedules the next ones on the timer wheel, and starts the
+ * serving thread. Must be called after the timer wheel has been initialized.
+ *
+ * @return 0 on success (or if the exporter is off), -1 on failure.
+ */
+int metrics_exporter_start(void);
+
+#endif // METRICS_EXPORTER_H
@@ -0,0 +1,133 @@
+/**
+ * @file output_cache.h
+ * @brief Declares the content-addressed cache of converted print data.
+ *
+ * Converting a document is usually far more expensive than sending it, and
+ * the same document is often printed more than once. When a conversion
+ * pipeline completes successfully, its final output is kept as a file under
+ * spool/cache/, named after a hash of everything that determined it: the bytes
+ * of the input file and, for every conversion along the path, its source type,
+ * target type and command line. The size of the input is part of the key as
+ * well, so two inputs only share an output if they also have the same length.
+ * A later job with the same key is printed by sending the cached file, without
+ * running any conversion.
+ *
+ * Hashing a large input takes time on the event loop, so the hash of each file
+ * recently printed is remembered along with its device, inode, size and
+ * modification and change times. A file printed again without having changed
+ * is not read a second time. (A file that changed in the last second is always
+ * read: its times might not have moved since.)
+ *
+ * The cache holds at most OUTPUT_CACHE_BUDGET bytes; the least recently used
+ * entries are evicted to make room. Entries left by earlier runs are picked up
+ * at initialization.
+ */
+
+#ifndef OUTPUT_CACHE_H
+#define OUTPUT_CACHE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/* Forward declaration of CONVERSION; conversions.h has no include guard, so it is left to the .c files. */
+struct conversion;
+typedef struct conversion CONVERSION;
+
+/** @brief Directory holding the cached outputs. */
+#define OUTPUT_CACHE_DIR "spool/cache"
+
+/** @brief Total size, in bytes, that the cached outputs may occupy. */
+#define OUTPUT_CACHE_BUDGET ((off_t)64 << 20)
+
+/** @brief Maximum number of cached outputs. */
+#define MAX_OUTPUT_CACHE_ENTRIES 128
+
+/** @brief Maximum number of input files whose hash is remembered. */
+#define MAX_INPUT_DIGESTS 128
+
+/**
+ * @struct output_cache_key
+ * @brief Identifies a converted output.
+ */
+typedef struct output_cache_key {
+    uint64_t hash;      ///< Hash of the input's bytes and of the conversion path.
+    off_t input_size;   ///< Size of the input in bytes.
+} OUTPUT_CACHE_KEY;
+
+/**
+ * @struct output_cache_stats
+ * @brief Counters describing the cache's use since initialization.
+ */
+typedef struct output_cache_stats {
+    unsigned long hits;    ///< Lookups that found a cached output.
+    unsigned long misses;  ///< Lookups that did not.
+    unsigned long inputs_hashed; ///< Input files read to compute a key, rather than known unchanged.
+    int entries;           ///< Outputs currently cached.
+    off_t bytes;           ///< Total size of the cached outputs.
+} OUTPUT_CACHE_STATS;
+
+/**
+ * @brief Creates the cache directory if needed and indexes the outputs already in it.
+ *
+ * Partial outputs left by an interrupted run are removed.
+ */
+void output_cache_initialize(void);
+
+/**
+ * @brief Computes the cache key of converting a file along a conversion path.
+ *
+ * The file is only read if it is not known unchanged since it was last hashed.
+ *
+ * @param input_path The file to be printed.
+ * @param path       A non-empty, NULL-terminated conversion path.
+ * @param key        Receives the key.
+ * @return 0 on success, -1 if the file could not be read.
+ */
+int output_cache_key(const char *input_path, CONVERSION *const *path, OUTPUT_CACHE_KEY *key);
+
+/**
+ * @brief Looks up a key and opens the cached output on a hit.
+ *
+ * Every call counts as either a hit or a miss.
+ *
+ * @return A close-on-exec descriptor open for reading, or -1 on a miss.
+ */
+int output_cache_open(OUTPUT_CACHE_KEY key);
+
+/**
+ * @brief Chooses the file into which a new output for key is to be written.
+ *
+ * The file is not part of the cache until output_cache_commit() is called.
+ *
+ * @param key    The key of the output.
+ * @param job_id The job producing it, so that concurrent producers do not collide.
+ * @return A newly allocated path, or NULL on allocation failure.
+ */
+char *output_cache_begin(OUTPUT_CACHE_KEY key, int job_id);
+
+/**
+ * @brief Adds a completely written output to the cache, evicting older entries as needed.
+ *
+ * An output larger than the whole budget, or one whose key was cached
+ * meanwhile by another job, is discarded instead.
+ *
+ * @param key       The key passed to output_cache_begin().
+ * @param temp_path The path returned by output_cache_begin(); it is freed.
+ */
+void output_cache_commit(OUTPUT_CACHE_KEY key, char *temp_path);
+
+/**
+ * @brief Discards an output that was not completely written.
+ *
+ * @param temp_path The path returned by output_cache_begin(); the file is removed and the path freed.
+ */
+void output_cache_abandon(char *temp_path);
+
+/**
+ * @brief Reports the cache's hit and miss counters and its current contents.
+ *
+ * @param stats Receives the counters.
+ */
+void output_cache_get_stats(OUTPUT_CACHE_STATS *stats);
+
+#endif // OUTPUT_CACHE_H
@@ -0,0 +1,38 @@
+/**
+ * @file pipeline_launcher.h
+ * @brief Declares the launcher that starts the processes of a conversion pipeline.
+ *
+ * The spooler builds the pipe topology itself and starts every stage with
+ * posix_spawnp(), which never duplicates the spooler's address space. All stages
+ * are placed in one process group, led by the first stage that starts, so the
+ * whole pipeline can be addressed as a unit.
+ */
+
+#ifndef PIPELINE_LAUNCHER_H
+#define PIPELINE_LAUNCHER_H
+
+#include <sys/types.h>
+
+/**
+ * @brief Starts a pipeline of stage_count processes.
+ *
+ * Stage i runs stage_argv[i] (looked up in PATH), reads from the previous stage
+ * (the first stage reads input_path) and writes to the next stage (the last
+ * stage writes to output_fd). Each stage starts with an empty signal mask,
+ * default SIGCHLD and SIGPIPE handling, and only descriptors 0-2 open.
+ *
+ * A stage that cannot be started (missing program, unreadable input, no output
+ * descriptor) is reported as -1 in pids; its neighbours see end-of-file or a
+ * broken pipe, just as if the stage had failed right away.
+ *
+ * @param stage_argv  Argument vector of each stage.
+ * @param stage_count Number of stages (at least 1).
+ * @param input_path  File opened as the standard input of the first stage.
+ * @param output_fd   Descriptor used as the standard output of the last stage, or -1 if none.
+ * @param pids        Receives the PID of each stage, or -1 for a stage that was not started.
+ * @return The process group ID of the pipeline, or -1 if no stage could be started.
+ */
+pid_t launch_pipeline(char **stage_argv[], int stage_count, const char *input_path,
+                      int output_fd, pid_t pids[]);
+
+#endif // PIPELINE_LAUNCHER_H
@@ -16,11 +16,21 @@
 #ifndef PRINTER_MANAGER_H
 #define PRINTER_MANAGER_H
 
+#include <stdint.h>
+
 #include "presi.h"          ///< Provides definitions like PRINTER, PRINTER_STATUS
 
 struct file_type;
 typedef struct file_type FILE_TYPE;
 
+/**
+ * @brief Upper bound on FILE_TYPE.index values.
+ *
+ * Matches the capacity of the conversions module's type table, so every
+ * declared type can be used to index per-type arrays directly.
+ */
+#define MAX_FILE_TYPES 64
+
 
 /**
  * @brief Initializes the printer system, clearing any existing records.
@@ -80,6 +90,96 @@ int get_printer_count(void);
  */
 PRINTER* get_printer_by_index(int index);
 
-PRINTER *select_compatible_printer(FILE_TYPE *from_type);
+/**
+ * @brief Returns a printer's ID: its index in the registry and its bit in every printer mask.
+ *
+ * @param printer A registered printer.
+ * @return The zero-based printer ID.
+ */
+int get_printer_id(const PRINTER *printer);
+
+/**
+ * @brief Enables a printer, making it IDLE (or BUSY if a job is still running on it).
+ *
+ * Also starts the printer's daemon in the background if it is not running yet.
+ *
+ * @param printer The printer to enable.
+ */
+void enable_printer(PRINTER *printer);
+
+/**
+ * @brief Disables a printer so that it receives no new jobs.
+ *
+ * A job already running on the printer is allowed to finish.
+ *
+ * @param printer The printer to disable.
+ */
+void disable_printer(PRINTER *printer);
+
+/**
+ * @brief Marks an idle printer BUSY because a job has just been started on it.
+ *
+ * @param printer The printer the job was dispatched to.
+ */
+void mark_printer_busy(PRINTER *printer);
+
+/**
+ * @brief Releases a printer whose job has ended, returning it to IDLE unless it was disabled.
+ *
+ * @param printer The printer the job was running on.
+ */
+void release_printer(PRINTER *printer);
+
+/**
+ * @brief Returns the set of IDLE printers as a bitmask (bit i is the printer with ID i).
+ */
+uint32_t get_idle_printer_mask(void);
+
+/**
+ * @brief Returns the set of printers that can print a file type, directly or via conversion.
+ *
+ * @param from_type The type of the file to be printed.
+ * @return A bitmask over printer IDs, independent of the printers' current status.
+ */
+uint32_t get_eligible_printer_mask(FILE_TYPE *from_type);
+
+/**
+ * @brief Opens a connection to a printer from within the spooler itself.
+ *
+ * Unlike presi_connect_to_printer(), the call never sleeps or blocks, and a
+ * refused connection is reported as an error instead of terminating the calling
+ * process. A printer whose daemon is still starting fails the attempt; callers
+ * retry from the timer wheel. The returned descriptor is close-on-exec.
+ *
+ * @param printer The printer to connect to.
+ * @return A connected socket, or -1 on failure.
+ */
+int connect_to_printer(PRINTER *printer);
+
+/**
+ * @brief Discards the cached eligibility masks. Must be called after any conversion is defined.
+ */
+void invalidate_printer_eligibility(void);
+
+/**
+ * @struct printer_metrics
+ * @brief A snapshot of every printer's status and busy time, for the metrics exporter.
+ */
+typedef struct printer_metrics {
+    int count;                  ///< Number of printers declared.
+    struct {
+        const char *name;       ///< The printer's name; never freed while the spooler runs.
+        PRINTER_STATUS status;  ///< Its displayed status.
+        uint64_t busy_ns;       ///< Time it has spent with a job running, up to the snapshot.
+        uint64_t declared_ns;   ///< Time since it was declared.
+    } printers[MAX_PRINTERS];
+} PRINTER_METRICS;
+
+/**
+ * @brief Takes a snapshot of the printers' metrics.
+ *
+ * @param metrics Receives the snapshot.
+ */
+void printer_manager_get_metrics(PRINTER_METRICS *metrics);
 
 #endif // PRINTER_MANAGER_H
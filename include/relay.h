@@ -0,0 +1,139 @@
+/**
+ * @file relay.h
+ * @brief Declares the in-spooler relay that copies a file to a printer without a helper process.
+ *
+ * A relay owns an input file and a non-blocking output socket. It registers the
+ * socket with the event loop and, whenever the socket can take more data, moves
+ * the next part of the file with sendfile(), so the bytes go from the page cache
+ * to the socket without passing through user space. Jobs whose type already
+ * matches the printer are printed this way instead of through a `cat` process.
+ *
+ * A growing relay sends a file that is still being written: it only sends up to
+ * the limit announced with relay_grow(), and waits there until the producer
+ * announces more data or says that the file is complete.
+ *
+ * A relay keeps a checkpoint of the bytes the printer has actually read. If the
+ * printer drops the connection, the relay is detached instead of ended: it keeps
+ * its file, rewinds to the checkpoint, and can be resumed on a new connection
+ * with relay_reattach(), so nothing is lost and nothing before the checkpoint is
+ * sent again.
+ */
+
+#ifndef RELAY_H
+#define RELAY_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * @brief Callback invoked when a relay ends on its own, or is detached.
+ *
+ * If relay_is_detached() is true when it runs (error is EPIPE or ECONNRESET),
+ * the relay still owns its file, and the owner must call either relay_reattach()
+ * or relay_cancel().
+ *
+ * @param context The pointer supplied to relay_start().
+ * @param error   0 if the whole file was delivered, otherwise the errno that stopped the copy.
+ */
+typedef void relay_done_func_t(void *context, int error);
+
+/**
+ * @struct relay
+ * @brief State of one file-to-socket copy. Treat the fields as private.
+ */
+struct relay {
+    int in_fd;                ///< File being sent, or -1 when the relay is not active.
+    int out_fd;               ///< Destination socket (non-blocking), or -1 when not connected.
+    off_t offset;             ///< Number of bytes of the file already handed to the socket.
+    off_t delivered;          ///< Checkpoint: number of bytes the printer is known to have read.
+    off_t limit;              ///< Number of bytes available to send, or -1 to send until end of file.
+    int growing;              ///< Nonzero while more data may still be announced beyond limit.
+    int paused;               ///< Nonzero between relay_pause() and relay_resume().
+    int stalled;              ///< Nonzero while a growing relay waits for more data.
+    int watching;             ///< Nonzero while the socket is registered with the event loop.
+    uint64_t first_sent_ns;   ///< latency_now_ns() when the first byte was sent, or 0 if none has been.
+    relay_done_func_t *done;  ///< Completion callback.
+    void *context;            ///< Opaque pointer passed to the callback.
+};
+
+typedef struct relay RELAY;
+
+/**
+ * @brief Initializes a relay as inactive. Must be called before any other function here.
+ *
+ * @param relay The relay to initialize.
+ */
+void relay_init(RELAY *relay);
+
+/**
+ * @brief Starts copying in_fd to out_fd. The relay takes ownership of both descriptors.
+ *
+ * @param relay   The relay to start; must not be active.
+ * @param in_fd   A regular file opened for reading.
+ * @param out_fd  A connected stream socket, which is switched to non-blocking mode;
+ *                or -1 to start detached, waiting for relay_reattach().
+ * @param done    Callback run when the copy ends on its own.
+ * @param context Opaque pointer passed to the callback.
+ * @return 0 on success, -1 on failure (both descriptors are closed either way on failure).
+ */
+int relay_start(RELAY *relay, int in_fd, int out_fd, relay_done_func_t *done, void *context);
+
+/**
+ * @brief Starts a growing relay, which sends nothing until relay_grow() announces data.
+ *
+ * The parameters and ownership rules are those of relay_start().
+ */
+int relay_start_growing(RELAY *relay, int in_fd, int out_fd, relay_done_func_t *done, void *context);
+
+/**
+ * @brief Announces that the first limit bytes of a growing relay's file can be sent.
+ *
+ * Does nothing if the relay is not active (for example because it was canceled).
+ *
+ * @param relay A relay started with relay_start_growing().
+ * @param limit Number of bytes of the file that have been written.
+ * @param final Nonzero if the file is complete; the relay ends once it has sent limit bytes.
+ */
+void relay_grow(RELAY *relay, off_t limit, int final);
+
+/**
+ * @brief Continues a detached relay from its checkpoint on a new connection.
+ *
+ * Pausing and growth announced while the relay was detached are honored.
+ *
+ * @param relay  A relay for which relay_is_detached() is true.
+ * @param out_fd A connected stream socket; the relay takes ownership of it.
+ * @return 0 on success, -1 on failure (out_fd is closed, the relay stays detached).
+ */
+int relay_reattach(RELAY *relay, int out_fd);
+
+/**
+ * @brief Stops sending until relay_resume() is called. The printer simply sees no data.
+ *
+ * @return 0 on success, -1 if the relay is not active or already paused.
+ */
+int relay_pause(RELAY *relay);
+
+/**
+ * @brief Continues a paused relay.
+ *
+ * @return 0 on success, -1 if the relay is not active or not paused.
+ */
+int relay_resume(RELAY *relay);
+
+/**
+ * @brief Abandons the copy and closes both descriptors. The completion callback is not run.
+ */
+void relay_cancel(RELAY *relay);
+
+/**
+ * @brief Reports whether a relay is currently active (started and not yet ended), detached or not.
+ */
+int relay_is_active(const RELAY *relay);
+
+/**
+ * @brief Reports whether a relay has lost its connection and waits for relay_reattach().
+ */
+int relay_is_detached(const RELAY *relay);
+
+#endif // RELAY_H
@@ -0,0 +1,72 @@
+/**
+ * @file stage_usage.h
+ * @brief Declares the per-conversion resource accounting shown by the 'stats' command.
+ *
+ * Every pipeline stage is reaped with wait4(), which also returns the
+ * resources that one process used. The job manager hands that rusage to
+ * stage_usage_record() for the conversion the stage ran, and the totals are
+ * kept per conversion command: the runs, the user and system CPU time, the
+ * largest resident set, and the blocks read and written. They show which
+ * converter of the configuration is taking the CPU time.
+ */
+
+#ifndef STAGE_USAGE_H
+#define STAGE_USAGE_H
+
+#include <stdio.h>
+#include <sys/resource.h>
+
+struct conversion;
+typedef struct conversion CONVERSION;
+
+/** @brief Number of distinct conversion commands accounted for; later ones are not recorded. */
+#define MAX_STAGE_USAGE 64
+
+/** @brief Longest command line kept, including the type names; longer ones are truncated. */
+#define STAGE_USAGE_COMMAND_MAX 64
+
+/**
+ * @brief Returns where the resources of a stage running a conversion are accounted.
+ *
+ * Called when the stage starts: a conversion can be redefined or deleted
+ * while its stages run, but the slot, which names its command, stays valid.
+ * The slot of each conversion is remembered until
+ * invalidate_stage_usage_slots() is called, so only the first stage after a
+ * conversion is defined looks its command up.
+ *
+ * @param conversion The conversion the stage runs.
+ * @return The slot, or -1 if MAX_STAGE_USAGE commands are already accounted for.
+ */
+int stage_usage_slot(const CONVERSION *conversion);
+
+/**
+ * @brief Forgets the remembered slots; call after any conversion has been defined.
+ *
+ * A redefined conversion may keep its address but run another command.
+ */
+void invalidate_stage_usage_slots(void);
+
+/**
+ * @brief Adds the resources used by one stage to the totals of its conversion command.
+ *
+ * @param slot   The slot returned by stage_usage_slot(); -1 is ignored.
+ * @param rusage The stage's rusage, as filled in by wait4().
+ */
+void stage_usage_record(int slot, const struct rusage *rusage);
+
+/**
+ * @brief Returns the command accounted in a slot, as "from -> to: command args".
+ *
+ * @param slot The slot returned by stage_usage_slot().
+ * @return The command, or "conversion" for slot -1.
+ */
+const char *stage_usage_command(int slot);
+
+/**
+ * @brief Prints the totals of every conversion command that has run, one line each.
+ *
+ * @param out Output stream.
+ */
+void stage_usage_print(FILE *out);
+
+#endif // STAGE_USAGE_H
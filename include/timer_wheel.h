@@ -0,0 +1,92 @@
+/**
+ * @file timer_wheel.h
+ * @brief Declares the hierarchical timer wheel used for job expiry and other deadlines.
+ *
+ * Timers are embedded in the objects they belong to (for example a job slot)
+ * and are scheduled relative to CLOCK_MONOTONIC. The wheel owns a single
+ * timerfd registered with the event loop, armed for the next tick on which any
+ * timer has to fire or move to a finer level, so an idle spooler sleeps until
+ * exactly that moment and a busy one never scans timers that are not due.
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+/** @brief Resolution of the wheel in milliseconds; timers never fire early, and at most one tick late. */
+#define TIMER_TICK_MS 10
+
+/**
+ * @brief Callback invoked when a timer expires.
+ *
+ * The timer is no longer scheduled when its callback runs, so the callback may
+ * schedule it again or release the object that contains it.
+ *
+ * @param context The pointer supplied to timer_wheel_init_timer().
+ */
+typedef void timer_callback_func_t(void *context);
+
+/**
+ * @struct timer
+ * @brief A timer that can be linked into the wheel. Treat the fields as private.
+ */
+struct timer {
+    uint64_t expires;                ///< Tick on which the timer fires.
+    timer_callback_func_t *callback; ///< Function run on expiry.
+    void *context;                   ///< Opaque pointer passed to the callback.
+    struct timer *next;              ///< Next timer in the same wheel slot.
+    struct timer *prev;              ///< Previous timer in the same wheel slot.
+    int level;                       ///< Wheel level holding the timer, or -1 when not scheduled.
+    int slot;                        ///< Slot within that level.
+};
+
+typedef struct timer TIMER;
+
+/**
+ * @brief Creates the timerfd and registers it with the event loop.
+ *
+ * Must be called once, after event_loop_initialize().
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int timer_wheel_initialize(void);
+
+/**
+ * @brief Unschedules every timer and closes the timerfd.
+ */
+void timer_wheel_cleanup(void);
+
+/**
+ * @brief Prepares a timer for use. The timer starts out unscheduled.
+ *
+ * @param timer    The timer to set up.
+ * @param callback Function to run on expiry.
+ * @param context  Opaque pointer passed to the callback.
+ */
+void timer_wheel_init_timer(TIMER *timer, timer_callback_func_t *callback, void *context);
+
+/**
+ * @brief Schedules a timer to fire after the given delay, replacing any earlier schedule.
+ *
+ * @param timer    A timer prepared with timer_wheel_init_timer().
+ * @param delay_ms Milliseconds from now; rounded up to whole ticks.
+ */
+void timer_wheel_schedule(TIMER *timer, uint64_t delay_ms);
+
+/**
+ * @brief Unschedules a timer. Does nothing if the timer is not scheduled.
+ *
+ * @param timer The timer to cancel.
+ */
+void timer_wheel_cancel(TIMER *timer);
+
+/**
+ * @brief Reports whether a timer is currently scheduled.
+ *
+ * @param timer The timer to check.
+ * @return Nonzero if the timer is waiting to fire, 0 otherwise.
+ */
+int timer_wheel_is_scheduled(const TIMER *timer);
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,36 @@
+/**
+ * @file tokenizer.h
+ * @brief Declares the in-place splitting of a command line into whitespace-separated tokens.
+ *
+ * Every command, whether typed, read from a batch file or replayed from the
+ * journal, goes through tokenize_line(). Where the compiler targets SSE2, the
+ * whitespace boundaries are found 16 bytes at a time; tokenize_line_scalar()
+ * is the byte-at-a-time reference, kept for other targets and for testing.
+ *
+ * Whitespace means what isspace() accepts in the C locale: space, \t, \n,
+ * \v, \f and \r.
+ */
+
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+/**
+ * @brief Splits a line into tokens, in place.
+ *
+ * Leading whitespace is skipped, and the whitespace character that ends each
+ * token is replaced by a NUL. Once max_tokens tokens have been found, the rest
+ * of the line is ignored.
+ *
+ * @param line       A mutable, NUL-terminated string.
+ * @param tokens     Receives pointers into line, one per token.
+ * @param max_tokens Capacity of tokens; at least 1.
+ * @return The number of tokens found.
+ */
+int tokenize_line(char *line, char **tokens, int max_tokens);
+
+/**
+ * @brief Byte-at-a-time version of tokenize_line(), with exactly the same results.
+ */
+int tokenize_line_scalar(char *line, char **tokens, int max_tokens);
+
+#endif // TOKENIZER_H
@@ -0,0 +1,80 @@
+/**
+ * @file tracer.h
+ * @brief Declares the tracer that records job lifecycles in the Chrome trace-event format.
+ *
+ * When the TRACE_ENV environment variable is set, the spooler writes
+ * TRACE_PATH, a JSON array of trace events that chrome://tracing and Perfetto
+ * load directly. Each job is shown as a process of its own, "job <id>: <file>".
+ * Its thread 0 holds the job's own spans: queued, spawn and printing. (Queued
+ * lasts until the dispatch is complete, so it contains the spawn of a pipeline
+ * started by the dispatch.) Its thread i + 1 holds the run of stage i of its
+ * conversion pipeline, named after the conversion. Process
+ * TRACE_SCHEDULER_PROCESS holds one span per try_scheduling_jobs() pass.
+ *
+ * Recording a span only copies a fixed-size record into a ring buffer that
+ * belongs to the calling thread; nothing is formatted or written there. A
+ * writer thread empties every buffer each TRACE_FLUSH_MS, formats the records
+ * and appends them to the file. A thread whose buffer is full drops its
+ * records rather than wait, and the number dropped is reported in the trace,
+ * so tracing can stay on under load. The array is closed when the spooler exits.
+ */
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <stdint.h>
+
+/** @brief Environment variable that turns tracing on when set. */
+#define TRACE_ENV "PRESI_TRACE"
+
+/** @brief Path of the trace file, replaced at each start. */
+#define TRACE_PATH "spool/presi.trace.json"
+
+/** @brief Records in each thread's buffer; a power of two. */
+#define TRACE_BUFFER_RECORDS 4096
+
+/** @brief Number of threads that can record spans; spans from further threads are dropped. */
+#define TRACE_MAX_THREADS 4
+
+/** @brief Longest span or process name kept, including the NUL; longer ones are truncated. */
+#define TRACE_NAME_MAX 48
+
+/** @brief Interval at which the writer thread empties the buffers. */
+#define TRACE_FLUSH_MS 100
+
+/** @brief Trace process of the scheduler's spans. */
+#define TRACE_SCHEDULER_PROCESS 0
+
+/** @brief Trace process of a job's spans. */
+#define TRACE_JOB_PROCESS(job_id) ((job_id) + 1)
+
+/**
+ * @brief Starts tracing if TRACE_ENV is set.
+ *
+ * Creates the trace file and the writer thread, and arranges for the
+ * remaining records to be written and the file closed at exit.
+ *
+ * @return 0 on success (or if tracing is off), -1 on failure.
+ */
+int tracer_start(void);
+
+/**
+ * @brief Records a complete span; does nothing unless tracing.
+ *
+ * @param process  Trace process of the span, e.g. TRACE_JOB_PROCESS(id).
+ * @param thread   Trace thread within that process.
+ * @param name     Name of the span; copied.
+ * @param start_ns Start, as returned by latency_now_ns().
+ * @param end_ns   End, as returned by latency_now_ns().
+ */
+void trace_span(int process, int thread, const char *name, uint64_t start_ns, uint64_t end_ns);
+
+/**
+ * @brief Names a trace process; does nothing unless tracing.
+ *
+ * @param process Trace process to name.
+ * @param name    Its name; copied.
+ */
+void trace_process_name(int process, const char *name);
+
+#endif // TRACER_H
@@ -0,0 +1,121 @@
+/**
+ * @file capture.c
+ * @brief Implements the splice()-based capture of a pipe into a file.
+ *
+ * The read end of the pipe is non-blocking and watched for EPOLLIN. Each
+ * wakeup moves at most CAPTURE_BUDGET bytes from the pipe into the file, then
+ * reports the new length, so that one fast producer cannot starve the rest of
+ * the event loop.
+ */
+
+#define _GNU_SOURCE  // pipe2() and splice()
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "capture.h"
+#include "event_loop.h"
+
+/** @brief Maximum number of bytes moved per wakeup before yielding to the event loop. */
+#define CAPTURE_BUDGET (1 << 20)
+
+/**
+ * @brief Closes the capture's descriptors and marks it inactive.
+ */
+static void close_capture(CAPTURE *capture) {
+    if (capture->pipe_fd >= 0) {
+        event_loop_remove(capture->pipe_fd);
+        close(capture->pipe_fd);
+    }
+    if (capture->file_fd >= 0) {
+        close(capture->file_fd);
+    }
+    capture->pipe_fd = capture->file_fd = -1;
+}
+
+/**
+ * @brief Event loop callback: the pipe has data, or the producer has closed it.
+ *
+ * splice() returns 0 once every writer has closed the pipe and it is empty,
+ * which ends the capture.
+ */
+static void handle_capture_ready(int fd, uint32_t events, void *context) {
+    (void)events;
+    CAPTURE *capture = context;
+
+    size_t moved = 0;
+    while (moved < CAPTURE_BUDGET) {
+        ssize_t n = splice(fd, NULL, capture->file_fd, &capture->length, CAPTURE_BUDGET - moved,
+                           SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0) {
+            moved += (size_t)n;
+            continue;
+        }
+
+        int error = (n == 0) ? 0 : errno;
+        if (error == EAGAIN) {
+            break;  // Pipe empty; wait for the next EPOLLIN
+        }
+        if (error == EINTR) {
+            continue;
+        }
+        close_capture(capture);
+        capture->progress(capture->context, capture->length, 1, error);
+        return;
+    }
+    capture->progress(capture->context, capture->length, 0, 0);
+}
+
+/**
+ * @brief Prepares a capture for use; it starts out inactive.
+ */
+void capture_init(CAPTURE *capture) {
+    capture->pipe_fd = capture->file_fd = -1;
+    capture->length = 0;
+}
+
+/**
+ * @brief Creates the pipe and starts watching its read end.
+ */
+int capture_start(CAPTURE *capture, int file_fd, capture_progress_func_t *progress, void *context) {
+    int pipefd[2];
+    if (pipe2(pipefd, O_CLOEXEC | O_NONBLOCK) < 0) {
+        close(file_fd);
+        return -1;
+    }
+
+    // Only the read end is ours; the producer's end must block as an ordinary pipe would
+    int flags = fcntl(pipefd[1], F_GETFL);
+    if (flags < 0 || fcntl(pipefd[1], F_SETFL, flags & ~O_NONBLOCK) < 0 ||
+        event_loop_add(pipefd[0], EPOLLIN, handle_capture_ready, capture) < 0) {
+        close(pipefd[0]);
+        close(pipefd[1]);
+        close(file_fd);
+        return -1;
+    }
+
+    capture->pipe_fd = pipefd[0];
+    capture->file_fd = file_fd;
+    capture->length = 0;
+    capture->progress = progress;
+    capture->context = context;
+    return pipefd[1];
+}
+
+/**
+ * @brief Closes an active capture without running its callback.
+ */
+void capture_cancel(CAPTURE *capture) {
+    if (capture_is_active(capture)) {
+        close_capture(capture);
+    }
+}
+
+/**
+ * @brief Reports whether the capture still owns its descriptors.
+ */
+int capture_is_active(const CAPTURE *capture) {
+    return capture->pipe_fd >= 0;
+}
@@ -5,170 +5,335 @@
  * This module supports both interactive and batch modes for reading and interpreting user commands,
  * handling signals (SIGCHLD), and updating the states of print jobs accordingly. Each major section
  * features explanatory comments that avoid personal pronouns and highlight both functionality and rationale.
+ *
+ * All input is driven by the event loop: command input, and a signalfd that reports SIGCHLD, are
+ * both registered with it (alongside the pidfds of running pipelines, owned by the job manager), so
+ * pipelines are reaped and waiting jobs dispatched as soon as the children change state, in
+ * interactive and batch mode alike.
  */
 
-#include <stdio.h>      ///< Provides FILE, stdin, stdout, fgets, etc.
+#include <stdio.h>      ///< Provides FILE, stdin, stdout, fputs, etc.
 #include <stdlib.h>     ///< Provides malloc, free, exit, etc.
-#include <string.h>     ///< Provides strcmp, strdup, etc.
+#include <string.h>     ///< Provides strcmp, memchr, etc.
 #include <ctype.h>      ///< Provides isspace
-#include <signal.h>     ///< Provides signal, sig_atomic_t
-#include <sys/wait.h>   ///< Provides waitpid, WIFEXITED macros
-#include <unistd.h>     ///< Provides pid_t, fork, getpid
+#include <errno.h>      ///< Provides errno, EINTR, EAGAIN
+#include <signal.h>     ///< Provides sigset_t, sigprocmask
+#include <sys/signalfd.h> ///< Provides signalfd and struct signalfd_siginfo
+#include <sys/stat.h>   ///< Provides fstat, S_ISREG
+#include <sys/epoll.h>  ///< Provides EPOLLIN
+#include <sys/mman.h>   ///< Provides mmap, madvise, munmap
+#include <sys/wait.h>   ///< Provides waitid, WSTOPPED, WCONTINUED
+#include <unistd.h>     ///< Provides pid_t, read
 #include <time.h>       ///< Provides time, time_t, localtime
 
-#include "sf_readline.h"
 #include "command_handler.h"
 #include "presi.h"
 #include "printer_manager.h"
 #include "job_manager.h"
 #include "job_struct.h"
+#include "conversion_cache.h"
+#include "output_cache.h"
+#include "journal.h"
+#include "control_socket.h"
+#include "metrics_exporter.h"
+#include "tracer.h"
+#include "event_loop.h"
+#include "event_ring.h"
+#include "timer_wheel.h"
+#include "tokenizer.h"
 
 #define MAX_COMMAND_TOKENS 32  ///< Maximum number of tokens allowed per command line
+#define INPUT_CHUNK_SIZE 4096  ///< Number of bytes requested from the input descriptor per read
+#define BATCH_POLL_LINES 64    ///< Batch lines executed between two passes over the event loop
+
+/**
+ * @struct command_input
+ * @brief Buffered, line-oriented reader over the descriptor that supplies commands.
+ *
+ * Bytes are appended to a growable buffer as they arrive; complete lines are
+ * handed out in place, so lines of any length are supported. A batch file is
+ * instead mapped into memory whole, as a private copy-on-write mapping, so its
+ * lines are handed out and tokenized in place without being read or copied.
+ */
+struct command_input {
+    int fd;            ///< Descriptor commands are read from.
+    int pollable;      ///< Nonzero if fd can be watched by epoll (i.e. it is not a regular file).
+    int at_eof;        ///< Set once read() has reported end of input.
+    char *buffer;      ///< Bytes read but not yet consumed.
+    size_t start;      ///< Offset of the first unconsumed byte.
+    size_t length;     ///< Offset one past the last byte read.
+    size_t capacity;   ///< Allocated size of buffer.
+    size_t mapped;     ///< Size of the mapping if buffer maps the input file, 0 if it was allocated.
+};
 
 /**
- * @var child_signal_received
- * A global flag used to indicate that SIGCHLD has been caught, signaling
- * that one or more child processes have changed state. Declared volatile
- * to prevent compiler reordering and of type sig_atomic_t to allow
- * asynchronous updates by the signal handler.
+ * @var child_status_fd
+ * A signalfd that becomes readable whenever SIGCHLD is pending. SIGCHLD itself
+ * is kept blocked, so child state changes are consumed synchronously by the event
+ * loop instead of interrupting the spooler at arbitrary points.
  */
-static volatile sig_atomic_t child_signal_received = 0;
+static int child_status_fd = -1;
 
 /**
- * @brief Signal handler for SIGCHLD.
+ * @brief Processes pending stop and continue reports.
  *
- * This function sets a global flag rather than performing complex operations.
- * This approach avoids reentrancy issues and preserves async-signal-safety.
+ * Invoked by the event loop when the SIGCHLD signalfd becomes readable. The
+ * queued signal notifications are drained first (several SIGCHLDs may have been
+ * merged into one), then waitid is called in a loop for each stopped or continued
+ * child. Exits are not collected here: each pipeline stage is reaped through its
+ * own pidfd by the job manager, so this handler never consumes an exit status.
+ */
+static void handle_child_status_updates(int fd, uint32_t events, void *context)
+{
+    (void)events;
+    (void)context;
+
+    struct signalfd_siginfo info;
+    while (read(fd, &info, sizeof(info)) == sizeof(info))
+    {
+        // Only the fact that SIGCHLD arrived matters; waitid reports the details
+    }
+
+    siginfo_t child;
+    while (1)
+    {
+        child.si_pid = 0;
+        if (waitid(P_ALL, 0, &child, WSTOPPED | WCONTINUED | WNOHANG) < 0 || child.si_pid == 0)
+        {
+            break;
+        }
+        // Every stage is a direct child; its process group identifies the job
+        update_job_from_child_event(get_job_by_pgid(getpgid(child.si_pid)), &child);
+    }
+}
+
+/**
+ * @brief Blocks SIGCHLD and registers a signalfd for it with the event loop.
  *
- * @param signum The signal number passed by the system (unused in this handler).
+ * @return 0 on success, -1 on failure.
  */
-static void sigchld_handler(int signum)
+static int install_child_status_source(void)
 {
-    (void)signum;
-    child_signal_received = 1;
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0)
+    {
+        return -1;
+    }
+
+    child_status_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (child_status_fd < 0)
+    {
+        return -1;
+    }
+    return event_loop_add(child_status_fd, EPOLLIN, handle_child_status_updates, NULL);
 }
 
 /**
- * @brief Processes any pending child status changes if the signal flag is set.
+ * @brief Reads whatever input is available into the buffer.
  *
- * This function checks if child_signal_received is nonzero and, if so, it calls
- * waitpid in a loop to handle each changed child process. The spooler’s job
- * status and printer status are updated accordingly.
+ * Consumed bytes are first moved to the front of the buffer, and the buffer is
+ * doubled whenever it is full, so a single line may be arbitrarily long.
+ * Reaching end of input sets at_eof.
  *
- * The design ensures that the signal handler itself remains minimal, and that
- * the waitpid logic, which is not guaranteed async-signal-safe, is executed in
- * a controlled environment.
+ * @param input The reader to fill.
+ * @return 0 on success (including EOF and "no data yet"), -1 on a read error or allocation failure.
  */
-static void handle_child_status_updates(void)
+static int fill_command_input(struct command_input *input)
 {
-    if (!child_signal_received)
+    if (input->start > 0)
     {
-        return;
+        memmove(input->buffer, input->buffer + input->start, input->length - input->start);
+        input->length -= input->start;
+        input->start = 0;
     }
 
-    child_signal_received = 0; // Resets the flag for future SIGCHLD events
+    if (input->capacity - input->length < INPUT_CHUNK_SIZE)
+    {
+        size_t capacity = input->capacity ? input->capacity * 2 : INPUT_CHUNK_SIZE * 2;
+        char *buffer = realloc(input->buffer, capacity);
+        if (!buffer)
+        {
+            return -1;
+        }
+        input->buffer = buffer;
+        input->capacity = capacity;
+    }
 
-    int status;
-    pid_t pid;
+    ssize_t n = read(input->fd, input->buffer + input->length, input->capacity - input->length - 1);
+    if (n > 0)
+    {
+        input->length += (size_t)n;
+    }
+    else if (n == 0)
+    {
+        input->at_eof = 1;
+    }
+    else if (errno != EINTR && errno != EAGAIN)
+    {
+        return -1;
+    }
+    return 0;
+}
 
-    /**
-     * Calls waitpid with WNOHANG (non-blocking), WUNTRACED (detecting stops),
-     * and WCONTINUED (detecting continues). Continues until no more changed
-     * child processes exist.
-     */
-    while ((pid = waitpid(-1, &status, WNOHANG | WUNTRACED | WCONTINUED)) > 0)
+/**
+ * @brief Maps a regular input file into memory, as the whole of its input.
+ *
+ * The mapping is private and writable, so lines can be terminated in place
+ * without touching the file. Because take_command_line() may write a NUL just
+ * past a final line that lacks a newline, such a file is only mapped when that
+ * byte still falls inside the last page; otherwise it is read as usual.
+ *
+ * @param input A reader over a regular file, with nothing buffered yet.
+ * @return 0 if the file was mapped, -1 if it is to be read instead.
+ */
+static int map_command_input(struct command_input *input)
+{
+    struct stat input_stat;
+    off_t offset = lseek(input->fd, 0, SEEK_CUR);
+    if (offset < 0 || fstat(input->fd, &input_stat) < 0 || input_stat.st_size <= offset)
     {
-        for (int i = 0; i < get_job_count(); i++)
-        {
-            JOB* job = get_job_by_index(i);
-            if (!job || job->pgid != pid)
-            {
-                continue;
-            }
+        return -1;
+    }
 
-            if (WIFSTOPPED(status))
-            {
-                job->status = JOB_PAUSED;
-                sf_job_status(job->id, JOB_PAUSED);
-            }
-            else if (WIFCONTINUED(status))
-            {
-                job->status = JOB_RUNNING;
-                sf_job_status(job->id, JOB_RUNNING);
-            }
-            else if (WIFEXITED(status))
-            {
-                job->status = JOB_FINISHED;
-                job->status_changed_at = time(NULL);
-                sf_job_status(job->id, JOB_FINISHED);
-                sf_job_finished(job->id, WEXITSTATUS(status));
-                if (job->target_printer)
-                {
-                    job->target_printer->status = PRINTER_IDLE;
-                    sf_printer_status(job->target_printer->name, PRINTER_IDLE);
-                }
-            }
-            else if (WIFSIGNALED(status))
-            {
-                job->status = JOB_ABORTED;
-                job->status_changed_at = time(NULL);
-                sf_job_status(job->id, JOB_ABORTED);
-                sf_job_aborted(job->id, WTERMSIG(status));
-                if (job->target_printer)
-                {
-                    job->target_printer->status = PRINTER_IDLE;
-                    sf_printer_status(job->target_printer->name, PRINTER_IDLE);
-                }
-            }
-        }
+    size_t size = (size_t)input_stat.st_size;
+    long page_size = sysconf(_SC_PAGESIZE);
+    char *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, input->fd, 0);
+    if (map == MAP_FAILED)
+    {
+        return -1;
+    }
+    if (map[size - 1] != '\n' && page_size > 0 && size % (size_t)page_size == 0)
+    {
+        munmap(map, size);
+        return -1;
     }
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    input->buffer = map;
+    input->start = (size_t)offset;
+    input->length = input->capacity = input->mapped = size;
+    input->at_eof = 1;
+    lseek(input->fd, 0, SEEK_END);
+    return 0;
+}
 
-    try_scheduling_jobs(); // Attempt to start eligible jobs after changes
+/**
+ * @brief Event loop callback for a pollable input descriptor.
+ */
+static void handle_command_input(int fd, uint32_t events, void *context)
+{
+    (void)fd;
+    (void)events;
+    struct command_input *input = context;
+    if (fill_command_input(input) < 0)
+    {
+        input->at_eof = 1;
+    }
 }
 
 /**
- * @brief Splits a line of text into an array of tokens separated by whitespace.
+ * @brief Hands out the next complete line, terminated in place.
  *
- * The function continues until it either reaches the end of the string or fills
- * the available token slots. Leading whitespace is skipped, and additional
- * whitespace between tokens is replaced with null terminators.
+ * At end of input a final line without a newline is also returned, matching
+ * the behavior of sf_readline().
  *
- * @param line   A mutable string that will be tokenized in-place.
- * @param tokens An array to hold the resulting tokens.
- * @return The number of tokens extracted from the line.
+ * @param input The reader to take the line from.
+ * @return The line (without its newline), or NULL if no complete line is buffered.
  */
-static int split_input_line_into_tokens(char* line, char** tokens)
+static char *take_command_line(struct command_input *input)
 {
-    int count = 0;
+    if (input->start == input->length)
+    {
+        return NULL;
+    }
 
-    while (*line != '\0')
+    char *line = input->buffer + input->start;
+    char *newline = memchr(line, '\n', input->length - input->start);
+    if (newline)
     {
-        while (isspace((unsigned char)*line))
-        {
-            line++;
-        }
-        if (*line == '\0')
-        {
+        *newline = '\0';
+        input->start = (size_t)(newline - input->buffer) + 1;
+        return line;
+    }
+    if (input->at_eof)
+    {
+        input->buffer[input->length] = '\0'; // fill_command_input always leaves room for this
+        input->start = input->length;
+        return line;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Executes one line of input.
+ *
+ * @param input_line The line, which is tokenized in place.
+ * @param out        The output stream for command results.
+ * @return -1 if the line was a valid 'quit' command, 0 otherwise.
+ */
+static int execute_command_line(char *input_line, FILE *out)
+{
+    // conversions.o reports some events directly, so earlier ones must not still be in the ring
+    event_ring_drain();
+
+    /*
+     * Ignore lines that are blank or contain only whitespace.
+     * This also ensures that lines like "   help" are not treated as valid.
+     * The demo does not print any message for these.
+     */
+    int is_all_whitespace = 1;
+    for (char *p = input_line; *p != '\0'; ++p) {
+        if (!isspace((unsigned char)*p)) {
+            is_all_whitespace = 0;
             break;
         }
+    }
 
-        tokens[count++] = line;
+    if (is_all_whitespace || isspace((unsigned char)input_line[0])) {
+        return 0;
+    }
 
-        while (*line && !isspace((unsigned char)*line))
-        {
-            line++;
-        }
-        if (*line)
-        {
-            *line++ = '\0';
-        }
+    // Split the line into tokens for parsing
+    char *tokens[MAX_COMMAND_TOKENS];
+    int num_tokens = tokenize_line(input_line, tokens, MAX_COMMAND_TOKENS);
 
-        if (count >= MAX_COMMAND_TOKENS)
-        {
-            break;
+    // If tokenization failed or first token is null, reject
+    if (num_tokens == 0 || tokens[0] == NULL) {
+        fprintf(out, "Unrecognized command: \n");
+        emit_cmd_error("Unrecognized command.");
+        return 0;
+    }
+
+    /*
+     * Handle 'quit' separately to allow argument count validation
+     * and proper termination behavior.
+     */
+    if (strcmp(tokens[0], "quit") == 0) {
+        if (num_tokens != 1) {
+            fprintf(out,
+                    "Wrong number of args (given: %d, required: 0) for CLI command 'quit'\n",
+                    num_tokens - 1);
+            emit_cmd_error("Invalid number of arguments for 'quit'");
+        } else {
+            emit_cmd_ok();
+            return -1;
         }
+    } else {
+        // Dispatch normal user commands to the command handler
+        handle_user_command(tokens, num_tokens, out);
     }
-    return count;
+
+    return 0;
+}
+
+/**
+ * @brief Journal callback: executes a command recovered from the journal.
+ */
+static void replay_journal_command(char *command, void *context)
+{
+    execute_command_line(command, context);
 }
 
 /**
@@ -176,8 +341,14 @@ static int split_input_line_into_tokens(char* line, char** tokens)
  *
  * This function is called once or more by the main program to read commands
  * from either standard input or a batch file. It initializes the spooler
- * subsystems only once, installs the SIGCHLD handler, and calls handle_child_status_updates
- * before blocking for user input to safely handle job state changes.
+ * subsystems only once, including the event loop and its SIGCHLD signalfd.
+ *
+ * Each iteration executes every complete line already buffered and then waits
+ * in the event loop, where command input and child status changes are serviced
+ * as they arrive. A batch file (a regular file, which epoll cannot watch) is
+ * mapped into memory and executed directly, with a non-blocking pass over the
+ * event loop every BATCH_POLL_LINES lines, so pipelines are reaped and jobs
+ * dispatched while the batch is still running.
  *
  * @param in  The input stream (stdin for interactive mode, or a file for batch mode).
  * @param out The output stream (stdout or another file).
@@ -188,92 +359,113 @@ int run_cli(FILE *in, FILE *out) {
 
     /*
      * One-time initialization for printer and job systems,
-     * along with SIGCHLD setup and async-safe input handling.
+     * along with the event loop, its timer wheel and its SIGCHLD source.
      */
     if (!initialized) {
         printer_manager_initialize();
         job_manager_initialize();
+        conversion_cache_initialize();
+        output_cache_initialize();
 
-        signal(SIGCHLD, sigchld_handler);
-        sf_set_readline_signal_hook(handle_child_status_updates);
+        // Relays write to printer sockets; a printer that goes away must be an EPIPE, not a fatal signal
+        signal(SIGPIPE, SIG_IGN);
 
-        initialized = 1;
-    }
+        if (event_loop_initialize() < 0 || timer_wheel_initialize() < 0 ||
+            install_child_status_source() < 0) {
+            perror("event loop");
+            return -1;
+        }
 
-    while (1) {
-        char *input_line = NULL;
+        // Trace job lifecycles from the start, replayed jobs included, if asked to
+        if (tracer_start() < 0) {
+            perror("tracer");
+        }
 
-        if (in != stdin) {
-            // Batch mode: read one line of input from file
-            char buffer[1024];
-            if (!fgets(buffer, sizeof(buffer), in)) {
-                return 0;
-            }
-            buffer[strcspn(buffer, "\n")] = '\0';
-            input_line = strdup(buffer);
-        } else {
-            // Interactive mode: show prompt and read with sf_readline
-            input_line = sf_readline("presi> ");
-            if (input_line == NULL) {
-                return -1;
-            }
+        // Recover the configuration and the unfinished jobs of an earlier run, if journaling
+        if (journal_open(replay_journal_command, out) < 0) {
+            perror("journal");
         }
 
-        /*
-         * Ignore lines that are blank or contain only whitespace.
-         * This also ensures that lines like "   help" are not treated as valid.
-         * The demo does not print any message for these.
-         */
-        int is_all_whitespace = 1;
-        for (char *p = input_line; *p != '\0'; ++p) {
-            if (!isspace((unsigned char)*p)) {
-                is_all_whitespace = 0;
-                break;
-            }
+        // Let other programs submit and manage jobs too, if asked to
+        if (control_socket_open() < 0) {
+            perror("control socket");
         }
 
-        if (is_all_whitespace || isspace((unsigned char)input_line[0])) {
-            free(input_line);
-            continue;
+        // Serve metrics to scrapers, from a thread of their own, if asked to
+        if (metrics_exporter_start() < 0) {
+            perror("metrics exporter");
         }
 
-        // Split the line into tokens for parsing
-        char *tokens[MAX_COMMAND_TOKENS];
-        int num_tokens = split_input_line_into_tokens(input_line, tokens);
+        initialized = 1;
+    }
 
-        // If tokenization failed or first token is null, reject
-        if (num_tokens == 0 || tokens[0] == NULL) {
-            fprintf(out, "Unrecognized command: \n");
-            sf_cmd_error("Unrecognized command.");
-            free(input_line);
-            continue;
-        }
+    int interactive = (in == stdin);
+    struct command_input input = { .fd = fileno(in) };
+    struct stat input_stat;
+    input.pollable = !(fstat(input.fd, &input_stat) == 0 && S_ISREG(input_stat.st_mode));
+    if (input.pollable && event_loop_add(input.fd, EPOLLIN, handle_command_input, &input) < 0) {
+        input.pollable = 0;
+    }
+    if (!input.pollable) {
+        map_command_input(&input);
+    }
 
+    int result = 0;
+    int prompt_pending = interactive;
+    while (1) {
         /*
-         * Handle 'quit' separately to allow argument count validation
-         * and proper termination behavior.
+         * A batch yields to the event loop every BATCH_POLL_LINES lines, so
+         * pipelines are reaped and jobs dispatched while a long script runs.
          */
-        if (strcmp(tokens[0], "quit") == 0) {
-            if (num_tokens != 1) {
-                fprintf(out,
-                        "Wrong number of args (given: %d, required: 0) for CLI command 'quit'\n",
-                        num_tokens - 1);
-                sf_cmd_error("Invalid number of arguments for 'quit'");
-            } else {
-                sf_cmd_ok();
-                free(input_line);
-                return -1;
+        char *input_line;
+        int batch_lines = 0;
+        while (result == 0 && (input.pollable || batch_lines < BATCH_POLL_LINES) &&
+               (input_line = take_command_line(&input)) != NULL) {
+            result = execute_command_line(input_line, out);
+            prompt_pending = interactive;
+            batch_lines++;
+        }
+        // Report the events of this pass, from the commands and the event loop, as one batch
+        event_ring_drain();
+        if (result != 0 || (input.at_eof && input.start == input.length)) {
+            break;
+        }
+
+        if (prompt_pending) {
+            // Interactive mode: show the prompt, as sf_readline did
+            fputs("presi> ", stdout);
+            fflush(stdout);
+            prompt_pending = 0;
+        }
+
+        if (input.pollable) {
+            if (event_loop_run_once(-1) < 0) {
+                break;
             }
         } else {
-            // Dispatch normal user commands to the command handler
-            handle_user_command(tokens, num_tokens, out);
+            event_loop_run_once(0);
+            if (!input.at_eof && fill_command_input(&input) < 0) {
+                break;
+            }
         }
+    }
 
-        delete_expired_jobs_if_needed(); // Clean up expired jobs
-        free(input_line);
+    if (input.pollable) {
+        event_loop_remove(input.fd);
+    }
+    if (input.mapped) {
+        munmap(input.buffer, input.mapped);
+    } else {
+        free(input.buffer);
     }
 
-    return 0;
-}
+    event_ring_drain();
 
+    // Whatever happens next, the changes made so far are on disk
+    journal_sync();
 
+    if (result != 0) {
+        return -1;
+    }
+    return interactive ? -1 : 0;
+}
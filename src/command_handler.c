@@ -12,6 +12,7 @@
  * developer with minimal C background can understand the implementation details and their motivations.
  */
 
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -19,49 +20,13 @@
 #include "command_handler.h"
 #include "presi.h"
 #include "conversions.h"
+#include "conversion_cache.h"
+#include "event_ring.h"
 #include "printer_manager.h"
 #include "job_manager.h"
-
-/**
- * @brief Prints a summary of all supported commands to an output stream.
- *
- * This function displays a quick reference covering each command keyword and
- * the expected arguments. Commands include 'help', 'quit', and spooler-related
- * commands like 'type', 'printer', etc.
- *
- * @param user_output_stream The FILE stream to which the help text is written.
- */
-static void display_help_message(FILE *user_output_stream) {
-    fprintf(user_output_stream,
-        "Supported commands:\n"
-        "  help                                - Show this help message.\n"
-        "  quit                                - Exit the program.\n"
-        "  type <file_type>                    - Declare a supported file type.\n"
-        "  conversion <from> <to> <cmd...>     - Define a conversion between file types.\n"
-        "  printer <name> <type>               - Declare a printer for a given file type.\n"
-        "  enable <printer>                    - Enable a previously declared printer.\n"
-        "  print <filename>                    - Submit a print job for a file.\n"
-        "  cancel <job_id>                     - Cancel a running job.\n"
-        "  pause <job_id>                      - Pause a running job.\n"
-        "  resume <job_id>                     - Resume a paused job.\n"
-        "  printers                            - List all registered printers and their status.\n"
-        "  jobs                                - List all submitted jobs.\n"
-    );
-}
-
-/**
- * @brief Prints the one-line summary of supported commands (demo-style).
- *
- * This is used after certain errors like undefined file types, malformed conversion,
- * or misparsed input — to match the demo binary exactly.
- *
- * @param out The output stream to write to.
- */
-static void print_command_list_summary(FILE *out) {
-    fprintf(out,
-        "Commands are: help quit type printer conversion printers jobs print cancel disable enable pause resume\n");
-}
-
+#include "journal.h"
+#include "latency_stats.h"
+#include "stage_usage.h"
 
 /**
  * @brief Handles the 'type' command to declare a new file type (e.g., "pdf", "txt").
@@ -73,22 +38,15 @@ static void print_command_list_summary(FILE *out) {
  * @param out  Output stream for printing status messages or errors.
  */
 static void handle_type_command(char **argv, int argc, FILE *out) {
-    if (argc != 2) {
-        fprintf(out,
-            "Wrong number of args (given: %d, required: 1) for CLI command 'type'\n",
-            argc - 1);
-        sf_cmd_error("Invalid number of arguments for 'type'.");
-        return;
-    }
-
     FILE_TYPE *type = define_type(argv[1]);
     if (!type) {
         fprintf(out, "Command error: type (failed)\n");
-        sf_cmd_error("define_type() failed.");
+        emit_cmd_error("define_type() failed.");
         return;
     }
 
-    sf_cmd_ok();
+    journal_record_command(argv, argc);
+    emit_cmd_ok();
 }
 
 /**
@@ -113,14 +71,6 @@ static void handle_type_command(char **argv, int argc, FILE *out) {
  * @param out  Output stream for printing status or error messages.
  */
 static void handle_conversion_command(char **argv, int argc, FILE *out) {
-    if (argc < 4) {
-        fprintf(out,
-            "Wrong number of args (given: %d, required: 3) for CLI command 'conversion'\n",
-            argc - 1);
-        sf_cmd_error("Invalid number of arguments for 'conversion'.");
-        return;
-    }
-
     const char *from_type = argv[1];
     const char *to_type = argv[2];
 
@@ -135,7 +85,7 @@ static void handle_conversion_command(char **argv, int argc, FILE *out) {
             fprintf(out, "Undeclared file type: %s\n", to_type);
         }
 
-        sf_cmd_error("conversion");
+        emit_cmd_error("conversion");
         fprintf(out, "Command error: conversion (failed)\n");
         return;
     }
@@ -144,7 +94,7 @@ static void handle_conversion_command(char **argv, int argc, FILE *out) {
     int cmd_argc = argc - 3;
     char **cmd_and_args = calloc(cmd_argc + 1, sizeof(char *));
     if (!cmd_and_args) {
-        sf_cmd_error("Memory allocation failed.");
+        emit_cmd_error("Memory allocation failed.");
         return;
     }
 
@@ -159,11 +109,18 @@ static void handle_conversion_command(char **argv, int argc, FILE *out) {
 
     if (!conv) {
         fprintf(out, "Command error: conversion (failed)\n");
-        sf_cmd_error("define_conversion() failed.");
+        emit_cmd_error("define_conversion() failed.");
         return;
     }
 
-    sf_cmd_ok();
+    // The new conversion may create or shorten paths between any pair of types
+    invalidate_conversion_paths();
+    invalidate_stage_usage_slots();
+    invalidate_printer_eligibility();
+    refresh_job_eligibility();
+
+    journal_record_command(argv, argc);
+    emit_cmd_ok();
 }
 
 /**
@@ -190,42 +147,38 @@ static void handle_conversion_command(char **argv, int argc, FILE *out) {
  * @param out  The output stream for printing messages (e.g., stdout or redirected file).
  */
 static void handle_printer_command(char **argv, int argc, FILE *out) {
-    if (argc != 3) {
-        fprintf(out,
-            "Wrong number of args (given: %d, required: 2) for CLI command 'printer'\n",
-            argc - 1);
-        sf_cmd_error("Invalid number of arguments for 'printer'.");
-        return;
-    }
-
     const char *name = argv[1];
     const char *type = argv[2];
 
     FILE_TYPE *file_type = find_type((char *)type);
     if (!file_type) {
         fprintf(out, "Unknown file type: %s\n", type);
-        sf_cmd_error("printer");
+        emit_cmd_error("printer");
         fprintf(out, "Command error: printer (failed)\n");
         return;
     }
 
     if (add_printer_to_system(name, type) != 0) {
-        sf_cmd_error("printer");
+        emit_cmd_error("printer");
         fprintf(out, "Command error: printer (failed)\n");
         return;
     }
 
+    // Waiting jobs may now also be printable on the new printer
+    refresh_job_eligibility();
+
     // This call must come after adding printer so index is up-to-date
     PRINTER *printer = get_printer_by_name(name);
     if (printer) {
         fprintf(out, "PRINTER: id=%d, name=%s, type=%s, status=%s\n",
-                get_printer_count() - 1,
+                get_printer_id(printer),
                 printer->name,
                 printer->type->name,
                 printer_status_names[printer->status]);
     }
 
-    sf_cmd_ok();
+    journal_record_command(argv, argc);
+    emit_cmd_ok();
 }
 
 
@@ -244,32 +197,57 @@ static void handle_printer_command(char **argv, int argc, FILE *out) {
  * @param out  Output stream for printing status or error messages.
  */
 static void handle_enable_command(char **argv, int argc, FILE *out) {
-    if (argc != 2) {
-        fprintf(out, "Wrong number of args (given: %d, required: 1) for CLI command 'enable'\n",
-                argc - 1);
-        sf_cmd_error("Invalid number of arguments for 'enable'.");
-        return;
-    }
-
     PRINTER *printer = get_printer_by_name(argv[1]);
     if (!printer) {
-        sf_cmd_error("enable");
+        emit_cmd_error("enable");
         fprintf(out, "Command error: enable (no printer)\n");
         return;
     }
 
-    printer->status = PRINTER_IDLE;
-    sf_printer_status(printer->name, printer->status);
+    enable_printer(printer);
 
     fprintf(out, "PRINTER: id=%d, name=%s, type=%s, status=%s\n",
-            get_printer_count() - 1,
+            get_printer_id(printer),
             printer->name,
             printer->type->name,
             printer_status_names[printer->status]);
 
     try_scheduling_jobs();
 
-    sf_cmd_ok();
+    journal_record_command(argv, argc);
+    emit_cmd_ok();
+}
+
+
+/**
+ * @brief Handles the 'disable' command to take a printer out of service.
+ *
+ * The printer is set to PRINTER_DISABLED and stops receiving jobs. A job that is
+ * already running on it is allowed to finish; the printer then stays disabled
+ * until it is enabled again.
+ *
+ * @param argv Array of command tokens (["disable", "printer_name"]).
+ * @param argc Number of tokens in argv.
+ * @param out  Output stream for printing status or error messages.
+ */
+static void handle_disable_command(char **argv, int argc, FILE *out) {
+    PRINTER *printer = get_printer_by_name(argv[1]);
+    if (!printer) {
+        emit_cmd_error("disable");
+        fprintf(out, "Command error: disable (no printer)\n");
+        return;
+    }
+
+    disable_printer(printer);
+
+    fprintf(out, "PRINTER: id=%d, name=%s, type=%s, status=%s\n",
+            get_printer_id(printer),
+            printer->name,
+            printer->type->name,
+            printer_status_names[printer->status]);
+
+    journal_record_command(argv, argc);
+    emit_cmd_ok();
 }
 
 
@@ -291,7 +269,9 @@ static void handle_enable_command(char **argv, int argc, FILE *out) {
  *
  * @param out The output stream for printing printer information (typically stdout).
  */
-static void handle_printers_command(FILE *out) {
+static void handle_printers_command(char **argv, int argc, FILE *out) {
+    (void)argv;
+    (void)argc;
     for (int i = 0; i < get_printer_count(); i++) {
         PRINTER *p = get_printer_by_index(i);
         if (p) {
@@ -299,7 +279,7 @@ static void handle_printers_command(FILE *out) {
                     i, p->name, p->type->name, printer_status_names[p->status]);
         }
     }
-    sf_cmd_ok();
+    emit_cmd_ok();
 }
 
 
@@ -317,6 +297,11 @@ static void handle_printers_command(FILE *out) {
  * If inference succeeds, the print job is submitted using the job manager. If the submission fails
  * (e.g., no printers, pipeline error, or memory allocation issue), a generic command error is shown.
  *
+ * With `--copies-to p,q,...`, one copy is printed on each of the listed printers at
+ * once (see submit_print_copies()); the printers must all be idle and of one type.
+ * With `--split`, the file is cut into chunks printed in parallel on the idle
+ * printers able to print it (see submit_split_job()).
+ *
  * On success, the function calls sf_cmd_ok(). All failure paths call sf_cmd_error().
  *
  * @param argv Array of command tokens (e.g., {"print", "somefile.pdf"}).
@@ -324,11 +309,13 @@ static void handle_printers_command(FILE *out) {
  * @param out  Output stream for user-facing error or status messages.
  */
 static void handle_print_command(char **argv, int argc, FILE *out) {
-    if (argc != 2) {
+    int copies = (argc == 4 && strcmp(argv[2], "--copies-to") == 0);
+    int split = (argc == 3 && strcmp(argv[2], "--split") == 0);
+    if (argc != 2 && !copies && !split) {
         fprintf(out,
             "Wrong number of args (given: %d, required: 1) for CLI command 'print'\n",
             argc - 1);
-        sf_cmd_error("Invalid number of arguments for 'print'.");
+        emit_cmd_error("Invalid number of arguments for 'print'.");
         return;
     }
 
@@ -336,19 +323,49 @@ static void handle_print_command(char **argv, int argc, FILE *out) {
     if (!type) {
         // Match demo: only print the error line (no file type name or command list)
         fprintf(out, "Command error: print (file type)\n");
-        sf_cmd_error("print");
+        emit_cmd_error("print");
+        return;
+    }
+
+    if (copies) {
+        PRINTER *printers[MAX_PRINTERS];
+        int count = 0;
+        for (char *name = strtok(argv[3], ","); name; name = strtok(NULL, ",")) {
+            PRINTER *printer = get_printer_by_name(name);
+            if (!printer || count == MAX_PRINTERS) {
+                count = -1;
+                break;
+            }
+            printers[count++] = printer;
+        }
+        if (count <= 0 || submit_print_copies(argv[1], printers, count) != 0) {
+            fprintf(out, "Command error: print (failed)\n");
+            emit_cmd_error("submit_print_copies() failed.");
+            return;
+        }
+        emit_cmd_ok();
+        return;
+    }
+
+    if (split) {
+        if (submit_split_job(argv[1]) != 0) {
+            fprintf(out, "Command error: print (failed)\n");
+            emit_cmd_error("submit_split_job() failed.");
+            return;
+        }
+        emit_cmd_ok();
         return;
     }
 
     PRINTER *printer = NULL;  // Let the job manager choose an appropriate printer
 
-    if (submit_print_job(argv[1], printer) != 0) {
+    if (submit_print_job(argv[1], printer) < 0) {
         fprintf(out, "Command error: print (failed)\n");
-        sf_cmd_error("submit_print_job() failed.");
+        emit_cmd_error("submit_print_job() failed.");
         return;
     }
 
-    sf_cmd_ok();
+    emit_cmd_ok();
 }
 
 
@@ -362,14 +379,13 @@ static void handle_print_command(char **argv, int argc, FILE *out) {
  *
  * @param out Output stream for listing job states.
  */
-static void handle_jobs_command(FILE *out) {
-    for (int i = 0; i < get_job_count(); i++) {
-        JOB *job = get_job_by_index(i);
-        if (job) {
-            sf_job_status(job->id, job->status);
-        }
+static void handle_jobs_command(char **argv, int argc, FILE *out) {
+    (void)argv;
+    (void)argc;
+    for (JOB *job = get_first_job(); job; job = get_next_job(job)) {
+        emit_job_status(job->id, job->status);
     }
-    sf_cmd_ok();
+    emit_cmd_ok();
 }
 
 /**
@@ -384,20 +400,14 @@ static void handle_jobs_command(FILE *out) {
  * @param out  Output stream for printing messages or errors.
  */
 static void handle_cancel_command(char **argv, int argc, FILE *out) {
-    if (argc != 2) {
-        fprintf(out, "Error: 'cancel' requires 1 argument: <job_id>\n");
-        sf_cmd_error("Invalid arguments for 'cancel'");
-        return;
-    }
-
     int job_id = atoi(argv[1]);
     if (cancel_job(job_id) != 0) {
         fprintf(out, "Error: Failed to cancel job %d\n", job_id);
-        sf_cmd_error("cancel_job() failed");
+        emit_cmd_error("cancel_job() failed");
         return;
     }
 
-    sf_cmd_ok();
+    emit_cmd_ok();
 }
 
 /**
@@ -411,20 +421,14 @@ static void handle_cancel_command(char **argv, int argc, FILE *out) {
  * @param out  Output stream for printing status or errors.
  */
 static void handle_pause_command(char **argv, int argc, FILE *out) {
-    if (argc != 2) {
-        fprintf(out, "Error: 'pause' requires 1 argument: <job_id>\n");
-        sf_cmd_error("Invalid arguments for 'pause'");
-        return;
-    }
-
     int job_id = atoi(argv[1]);
     if (pause_job(job_id) != 0) {
         fprintf(out, "Error: Failed to pause job %d\n", job_id);
-        sf_cmd_error("pause_job() failed");
+        emit_cmd_error("pause_job() failed");
         return;
     }
 
-    sf_cmd_ok();
+    emit_cmd_ok();
 }
 
 /**
@@ -439,27 +443,191 @@ static void handle_pause_command(char **argv, int argc, FILE *out) {
  * @param out  Output stream for printing status or errors.
  */
 static void handle_resume_command(char **argv, int argc, FILE *out) {
-    if (argc != 2) {
-        fprintf(out, "Error: 'resume' requires 1 argument: <job_id>\n");
-        sf_cmd_error("Invalid arguments for 'resume'");
-        return;
-    }
-
     int job_id = atoi(argv[1]);
     if (resume_job(job_id) != 0) {
         fprintf(out, "Error: Failed to resume job %d\n", job_id);
-        sf_cmd_error("resume_job() failed");
+        emit_cmd_error("resume_job() failed");
         return;
     }
 
-    sf_cmd_ok();
+    emit_cmd_ok();
+}
+
+/**
+ * @brief Handles the 'stats' command: prints the job latency percentiles and
+ * the resources used by each conversion command.
+ *
+ * @param argv Array of command tokens (["stats"]).
+ * @param argc Number of tokens in argv.
+ * @param out  Output stream for the statistics.
+ */
+static void handle_stats_command(char **argv, int argc, FILE *out) {
+    (void)argv;
+    (void)argc;
+    latency_stats_print(out);
+    stage_usage_print(out);
+    emit_cmd_ok();
+}
+
+/* The help and quit handlers print from the command table, so they follow it. */
+static void handle_help_command(char **argv, int argc, FILE *out);
+static void handle_quit_command(char **argv, int argc, FILE *out);
+
+/**
+ * @brief The command table, in the order the commands are listed by 'help'.
+ *
+ * It is the single description of every command: find_command() resolves a
+ * name to one of these entries, handle_user_command() checks the argument
+ * count against it before running the handler, and both help texts are
+ * printed from it.
+ */
+static const COMMAND_DESCRIPTOR commands[COMMAND_COUNT] = {
+    [COMMAND_HELP]       = { "help",       handle_help_command,       0, 0,  "",
+                             "Show the list of commands." },
+    [COMMAND_QUIT]       = { "quit",       handle_quit_command,       0, 0,  "",
+                             "Exit the program." },
+    [COMMAND_TYPE]       = { "type",       handle_type_command,       1, 1,  "<file_type>",
+                             "Declare a supported file type." },
+    [COMMAND_PRINTER]    = { "printer",    handle_printer_command,    2, 2,  "<name> <type>",
+                             "Declare a printer for a given file type." },
+    [COMMAND_CONVERSION] = { "conversion", handle_conversion_command, 3, -1, "<from> <to> <cmd...>",
+                             "Define a conversion between file types." },
+    [COMMAND_PRINTERS]   = { "printers",   handle_printers_command,   0, 0,  "",
+                             "List all registered printers and their status." },
+    [COMMAND_JOBS]       = { "jobs",       handle_jobs_command,       0, 0,  "",
+                             "List all submitted jobs." },
+    [COMMAND_PRINT]      = { "print",      handle_print_command,      1, 3,  "<filename> [--copies-to <p,q> | --split]",
+                             "Submit a print job; a copy per listed printer, or in chunks on all idle printers." },
+    [COMMAND_CANCEL]     = { "cancel",     handle_cancel_command,     1, 1,  "<job_id>",
+                             "Cancel a job." },
+    [COMMAND_DISABLE]    = { "disable",    handle_disable_command,    1, 1,  "<printer>",
+                             "Stop sending new jobs to a printer." },
+    [COMMAND_ENABLE]     = { "enable",     handle_enable_command,     1, 1,  "<printer>",
+                             "Enable a previously declared printer." },
+    [COMMAND_PAUSE]      = { "pause",      handle_pause_command,      1, 1,  "<job_id>",
+                             "Pause a running job." },
+    [COMMAND_RESUME]     = { "resume",     handle_resume_command,     1, 1,  "<job_id>",
+                             "Resume a paused job." },
+    [COMMAND_STATS]      = { "stats",      handle_stats_command,      0, 0,  "",
+                             "Show latency percentiles and the CPU, memory and I/O of each conversion." },
+};
+
+/** @brief Slots in the command name hash; a power of two, well above COMMAND_COUNT. */
+#define COMMAND_HASH_SIZE 64
+
+/** @brief Open-addressed (linear probing) hash of the command names: table index plus one, or 0 if free. */
+static unsigned char command_hash[COMMAND_HASH_SIZE];
+
+/** @brief Nonzero once command_hash has been filled from the command table. */
+static int command_hash_built = 0;
+
+/**
+ * @brief Hashes a command name (FNV-1a, 32 bits) to its home slot in command_hash.
+ */
+static unsigned command_slot(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)name; *c; c++) {
+        hash = (hash ^ *c) * 16777619u;
+    }
+    return hash & (COMMAND_HASH_SIZE - 1);
+}
+
+/**
+ * @brief Fills the name hash from the command table, so that adding a command
+ * to the table is all it takes to make it known.
+ */
+static void build_command_hash(void) {
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        unsigned slot = command_slot(commands[i].name);
+        while (command_hash[slot]) {
+            slot = (slot + 1) & (COMMAND_HASH_SIZE - 1);
+        }
+        command_hash[slot] = (unsigned char)(i + 1);
+    }
+    command_hash_built = 1;
+}
+
+/**
+ * @brief Looks a command name up in constant time.
+ *
+ * The hash is at most a quarter full, so a lookup hashes the name once and
+ * compares it against one or two entries of the table.
+ *
+ * @return The command's descriptor, or NULL if the name is not a command.
+ */
+const COMMAND_DESCRIPTOR *find_command(const char *name) {
+    if (!command_hash_built) {
+        build_command_hash();
+    }
+    if (strnlen(name, MAX_COMMAND_NAME + 1) > MAX_COMMAND_NAME) {
+        return NULL;
+    }
+    for (unsigned slot = command_slot(name); command_hash[slot]; slot = (slot + 1) & (COMMAND_HASH_SIZE - 1)) {
+        const COMMAND_DESCRIPTOR *command = &commands[command_hash[slot] - 1];
+        if (strcmp(name, command->name) == 0) {
+            return command;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Prints the one-line summary of supported commands (demo-style), from the command table.
+ *
+ * @param out The output stream to write to.
+ */
+static void print_command_list_summary(FILE *out) {
+    fputs("Commands are:", out);
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        fprintf(out, " %s", commands[i].name);
+    }
+    fputc('\n', out);
+}
+
+/**
+ * @brief Prints every command with its arguments and description, from the command table.
+ *
+ * @param out The output stream to write to.
+ */
+static void display_help_message(FILE *out) {
+    fputs("Supported commands:\n", out);
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        char usage[64];
+        snprintf(usage, sizeof(usage), "%s %s", commands[i].name, commands[i].usage);
+        fprintf(out, "  %-52s - %s\n", usage, commands[i].help);
+    }
+}
+
+/**
+ * @brief Handles the 'help' command: the command names, as the demo lists
+ * them, then every command with its arguments and description.
+ */
+static void handle_help_command(char **argv, int argc, FILE *out) {
+    (void)argv;
+    (void)argc;
+    print_command_list_summary(out);
+    display_help_message(out);
+    emit_cmd_ok();
+}
+
+/**
+ * @brief Handles the 'quit' command when it reaches the command handler.
+ *
+ * 'quit' is normally intercepted by run_cli(), which ends the session.
+ */
+static void handle_quit_command(char **argv, int argc, FILE *out) {
+    (void)argv;
+    (void)argc;
+    (void)out;
+    emit_cmd_ok();
 }
 
 /**
  * @brief Routes a user-issued command to the appropriate handler based on argv[0].
  *
  * This function matches the exact behavior and output format of the demo version of the spooler.
- * It supports all officially recognized commands and enforces argument count validation where required.
+ * The command is looked up in the command table, and its argument count is
+ * checked against the table before its handler runs.
  *
  * If an unknown command is given, it prints:
  *     Unrecognized command: <name>
@@ -467,12 +635,6 @@ static void handle_resume_command(char **argv, int argc, FILE *out) {
  * For argument mismatches, it prints:
  *     Wrong number of args (given: X, required: Y) for CLI command '<name>'
  *
- * Valid commands:
- * - help, quit
- * - type, conversion
- * - printer, enable, disable, printers
- * - print, cancel, pause, resume, jobs
- *
  * On any failure, this function ensures sf_cmd_error() is called.
  * On valid command execution, it ensures sf_cmd_ok() is called.
  *
@@ -484,50 +646,23 @@ void handle_user_command(char **argv, int argc, FILE *out) {
     if (argc == 0 || argv == NULL)
         return;
 
-    const char *cmd = argv[0];
-
-    if (strcmp(cmd, "help") == 0) {
-        if (argc != 1) {
-            fprintf(out,
-                "Wrong number of args (given: %d, required: 0) for CLI command 'help'\n",
-                argc - 1);
-            sf_cmd_error("Invalid number of arguments for 'help'");
-        } else {
-            // Match demo: print one-line summary instead of full help block
-            fprintf(out,
-                "Commands are: help quit type printer conversion printers jobs print cancel disable enable pause resume\n");
-            sf_cmd_ok();
-        }
-    } else if (strcmp(cmd, "type") == 0) {
-        handle_type_command(argv, argc, out);
-    } else if (strcmp(cmd, "conversion") == 0) {
-        handle_conversion_command(argv, argc, out);
-    } else if (strcmp(cmd, "printer") == 0) {
-        handle_printer_command(argv, argc, out);
-    } else if (strcmp(cmd, "enable") == 0) {
-        handle_enable_command(argv, argc, out);
-    } else if (strcmp(cmd, "disable") == 0) {
-        fprintf(out, "Command error: disable (not implemented)\n");
-        sf_cmd_error("disable command not implemented");
-    } else if (strcmp(cmd, "printers") == 0) {
-        handle_printers_command(out);
-    } else if (strcmp(cmd, "print") == 0) {
-        handle_print_command(argv, argc, out);
-    } else if (strcmp(cmd, "jobs") == 0) {
-        handle_jobs_command(out);
-    } else if (strcmp(cmd, "cancel") == 0) {
-        handle_cancel_command(argv, argc, out);
-    } else if (strcmp(cmd, "pause") == 0) {
-        handle_pause_command(argv, argc, out);
-    } else if (strcmp(cmd, "resume") == 0) {
-        handle_resume_command(argv, argc, out);
-    } else if (strcmp(cmd, "quit") == 0) {
-        // 'quit' is handled directly in run_cli
-        sf_cmd_ok();
-    } else {
+    const COMMAND_DESCRIPTOR *command = find_command(argv[0]);
+    if (!command) {
         // Matches demo: print unrecognized command without extra help
-        fprintf(out, "Unrecognized command: %s\n", cmd);
-        sf_cmd_error("Unknown command.");
+        fprintf(out, "Unrecognized command: %s\n", argv[0]);
+        emit_cmd_error("Unknown command.");
+        return;
     }
-}
 
+    int given = argc - 1;
+    if (given < command->min_args || (command->max_args >= 0 && given > command->max_args)) {
+        char message[64];
+        fprintf(out, "Wrong number of args (given: %d, required: %d) for CLI command '%s'\n",
+                given, command->min_args, command->name);
+        snprintf(message, sizeof(message), "Invalid number of arguments for '%s'.", command->name);
+        emit_cmd_error(message);
+        return;
+    }
+
+    command->handler(argv, argc, out);
+}
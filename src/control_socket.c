@@ -0,0 +1,316 @@
+/**
+ * @file control_socket.c
+ * @brief Implements the control socket and its binary protocol.
+ *
+ * Each client has an input buffer and an output buffer of CONTROL_BUFFER
+ * bytes. Whenever its socket is readable, everything available is read, every
+ * complete request in the input buffer is carried out, and the responses are
+ * gathered in the output buffer and written with one write() per wakeup, so a
+ * client that pipelines many requests costs few system calls. A client whose
+ * responses are not being read stops being read itself until its output buffer
+ * has drained, so it can neither exhaust memory nor hold up the other clients.
+ */
+
+#define _GNU_SOURCE  // accept4()
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "control_socket.h"
+#include "event_loop.h"
+#include "job_manager.h"
+#include "job_struct.h"
+#include "printer_manager.h"
+
+/** @brief Size of a request or response carrying the largest payload. */
+#define CONTROL_MAX_FRAME (sizeof(CONTROL_HEADER) + CONTROL_MAX_PAYLOAD)
+
+/** @brief Size of each client's input and output buffers; several frames fit in each. */
+#define CONTROL_BUFFER (4 * CONTROL_MAX_FRAME)
+
+/**
+ * @struct control_client
+ * @brief One connected client.
+ */
+struct control_client {
+    int fd;                       ///< The connection, or -1 if the slot is free.
+    char input[CONTROL_BUFFER];   ///< Bytes received and not yet carried out.
+    size_t input_length;          ///< Number of bytes in input.
+    char output[CONTROL_BUFFER];  ///< Responses not yet written.
+    size_t output_start;          ///< Offset of the first unwritten byte of output.
+    size_t output_length;         ///< Offset one past the last byte of output.
+    int closing;                  ///< Set once the client has closed its end or broken the protocol.
+    uint32_t watched;             ///< Events currently watched for fd.
+};
+
+/** @brief The listening socket, or -1 if the control socket is off. */
+static int listen_fd = -1;
+
+/** @brief Client slots, free when fd is -1. */
+static struct control_client clients[MAX_CONTROL_CLIENTS];
+
+/**
+ * @brief Closes a client's connection and frees its slot.
+ */
+static void close_client(struct control_client *client) {
+    event_loop_remove(client->fd);
+    close(client->fd);
+    client->fd = -1;
+}
+
+/**
+ * @brief Appends a response to the client's output buffer, which has room for it.
+ */
+static void respond(struct control_client *client, const CONTROL_HEADER *request, uint16_t status,
+                    const void *payload, size_t length, const void *extra, size_t extra_length) {
+    CONTROL_HEADER header = {
+        .length = (uint32_t)(length + extra_length),
+        .tag = request->tag,
+        .opcode = request->opcode,
+        .status = status,
+    };
+    char *end = client->output + client->output_length;
+    memcpy(end, &header, sizeof(header));
+    if (length > 0) {
+        memcpy(end + sizeof(header), payload, length);
+    }
+    if (extra_length > 0) {
+        memcpy(end + sizeof(header) + length, extra, extra_length);
+    }
+    client->output_length += sizeof(header) + length + extra_length;
+}
+
+/**
+ * @brief Carries out one request and appends its response.
+ */
+static void execute_request(struct control_client *client, const CONTROL_HEADER *request, const char *payload) {
+    int32_t job_id;
+    if (request->opcode == CONTROL_SUBMIT) {
+        char path[CONTROL_MAX_PAYLOAD + 1];
+        memcpy(path, payload, request->length);
+        path[request->length] = '\0';
+        job_id = (request->length > 0 && memchr(path, '\0', request->length) == NULL)
+                 ? submit_print_job(path, NULL) : -1;
+        if (job_id < 0) {
+            respond(client, request, CONTROL_FAILED, NULL, 0, NULL, 0);
+        } else {
+            respond(client, request, CONTROL_OK, &job_id, sizeof(job_id), NULL, 0);
+        }
+        return;
+    }
+
+    if (request->opcode < CONTROL_CANCEL || request->opcode > CONTROL_QUERY || request->length != sizeof(job_id)) {
+        respond(client, request, CONTROL_BAD_REQUEST, NULL, 0, NULL, 0);
+        return;
+    }
+    memcpy(&job_id, payload, sizeof(job_id));
+
+    int result;
+    switch (request->opcode) {
+        case CONTROL_CANCEL:
+            result = cancel_job(job_id);
+            break;
+        case CONTROL_PAUSE:
+            result = pause_job(job_id);
+            break;
+        case CONTROL_RESUME:
+            result = resume_job(job_id);
+            break;
+        default: {
+            JOB *job = get_job_by_id(job_id);
+            if (!job) {
+                result = -1;
+                break;
+            }
+            CONTROL_JOB_INFO info = {
+                .job_id = job->id,
+                .status = (int32_t)job->status,
+                .printer_id = job->target_printer ? get_printer_id(job->target_printer) : -1,
+            };
+            size_t path_length = strlen(job->input_file_path);
+            if (path_length > CONTROL_MAX_PAYLOAD - sizeof(info)) {
+                path_length = CONTROL_MAX_PAYLOAD - sizeof(info);
+            }
+            respond(client, request, CONTROL_OK, &info, sizeof(info), job->input_file_path, path_length);
+            return;
+        }
+    }
+    respond(client, request, (result == 0) ? CONTROL_OK : CONTROL_FAILED, NULL, 0, NULL, 0);
+}
+
+/**
+ * @brief Carries out the complete requests in the input buffer, as long as
+ * the output buffer has room for their responses.
+ */
+static void execute_requests(struct control_client *client) {
+    size_t consumed = 0;
+    while (client->input_length - consumed >= sizeof(CONTROL_HEADER) &&
+           CONTROL_BUFFER - client->output_length >= CONTROL_MAX_FRAME) {
+        CONTROL_HEADER request;
+        memcpy(&request, client->input + consumed, sizeof(request));
+        if (request.length > CONTROL_MAX_PAYLOAD) {
+            // The stream cannot be followed past this header; nothing else will be read
+            respond(client, &request, CONTROL_BAD_REQUEST, NULL, 0, NULL, 0);
+            client->closing = 1;
+            consumed = client->input_length;
+            break;
+        }
+        if (client->input_length - consumed < sizeof(request) + request.length) {
+            break;  // The rest of this request has not arrived yet
+        }
+        execute_request(client, &request, client->input + consumed + sizeof(request));
+        consumed += sizeof(request) + request.length;
+    }
+
+    memmove(client->input, client->input + consumed, client->input_length - consumed);
+    client->input_length -= consumed;
+}
+
+/**
+ * @brief Writes as much of the output buffer as the socket accepts.
+ *
+ * @return 0 on success, -1 if the connection is broken.
+ */
+static int flush_output(struct control_client *client) {
+    while (client->output_start < client->output_length) {
+        ssize_t n = write(client->fd, client->output + client->output_start,
+                          client->output_length - client->output_start);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (errno == EAGAIN) ? 0 : -1;
+        }
+        client->output_start += (size_t)n;
+    }
+    client->output_start = client->output_length = 0;
+    return 0;
+}
+
+/**
+ * @brief Reads whatever the client has sent, up to the free space of the input buffer.
+ *
+ * @return 0 on success, -1 if the connection is broken. End of input sets closing.
+ */
+static int fill_input(struct control_client *client) {
+    while (client->input_length < CONTROL_BUFFER) {
+        ssize_t n = read(client->fd, client->input + client->input_length, CONTROL_BUFFER - client->input_length);
+        if (n > 0) {
+            client->input_length += (size_t)n;
+            continue;
+        }
+        if (n == 0) {
+            client->closing = 1;
+            return 0;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        return (errno == EAGAIN) ? 0 : -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Event loop callback for a client connection.
+ *
+ * Input is read only while the pending responses leave room for more, and
+ * EPOLLOUT is watched only while responses are waiting to be written.
+ */
+static void handle_client(int fd, uint32_t events, void *context) {
+    (void)fd;
+    struct control_client *client = context;
+
+    if (((events & EPOLLIN) && fill_input(client) < 0) || (events & EPOLLERR)) {
+        close_client(client);
+        return;
+    }
+    execute_requests(client);
+    if (flush_output(client) < 0) {
+        close_client(client);
+        return;
+    }
+    // Output written may make room for requests that are already buffered
+    if (client->output_length == 0 && client->input_length >= sizeof(CONTROL_HEADER)) {
+        execute_requests(client);
+        if (flush_output(client) < 0) {
+            close_client(client);
+            return;
+        }
+    }
+
+    int pending_output = client->output_length > 0;
+    if (client->closing && !pending_output) {
+        close_client(client);
+        return;
+    }
+    uint32_t wanted = (pending_output ? EPOLLOUT : 0) | ((client->closing || pending_output) ? 0 : EPOLLIN);
+    if (wanted != client->watched && event_loop_modify(client->fd, wanted) == 0) {
+        client->watched = wanted;
+    }
+}
+
+/**
+ * @brief Event loop callback for the listening socket: accepts every pending connection.
+ */
+static void accept_clients(int fd, uint32_t events, void *context) {
+    (void)events;
+    (void)context;
+
+    int client_fd;
+    while ((client_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        struct control_client *client = NULL;
+        for (int i = 0; i < MAX_CONTROL_CLIENTS && !client; i++) {
+            if (clients[i].fd < 0) {
+                client = &clients[i];
+            }
+        }
+        if (!client || event_loop_add(client_fd, EPOLLIN, handle_client, client) < 0) {
+            close(client_fd);
+            continue;
+        }
+        client->fd = client_fd;
+        client->input_length = client->output_start = client->output_length = 0;
+        client->closing = 0;
+        client->watched = EPOLLIN;
+    }
+}
+
+/**
+ * @brief Binds and listens on CONTROL_SOCKET_PATH when CONTROL_ENV is set.
+ */
+int control_socket_open(void) {
+    if (!getenv(CONTROL_ENV) || listen_fd >= 0) {
+        return 0;
+    }
+    for (int i = 0; i < MAX_CONTROL_CLIENTS; i++) {
+        clients[i].fd = -1;
+    }
+
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    strncpy(address.sun_path, CONTROL_SOCKET_PATH, sizeof(address.sun_path) - 1);
+    mkdir("spool", 0777);
+    unlink(CONTROL_SOCKET_PATH);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        return -1;
+    }
+    if (bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+        listen(listen_fd, SOMAXCONN) < 0 ||
+        event_loop_add(listen_fd, EPOLLIN, accept_clients, NULL) < 0) {
+        close(listen_fd);
+        listen_fd = -1;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+/**
+ * @file conversion_cache.c
+ * @brief Memoizes conversion path searches for the presi spooler.
+ *
+ * Each (from, to) pair of file type indexes owns one cell of a fixed table.
+ * A cell is either not yet computed, known to have no path, or holds the
+ * array returned by find_conversion_path(), which the cache owns from then on.
+ * Lookups after the first are a table access with no allocation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "conversions.h"
+#include "conversion_cache.h"
+
+/** @brief State of one cell of the path table. */
+typedef enum {
+    PATH_UNKNOWN = 0,  ///< Not computed since the last invalidation.
+    PATH_PRESENT,      ///< path_table holds the (owned) path.
+    PATH_ABSENT        ///< No conversion path exists.
+} PATH_STATE;
+
+/** @brief Cached paths, indexed by [from->index][to->index]. */
+static CONVERSION **path_table[MAX_FILE_TYPES][MAX_FILE_TYPES];
+
+/** @brief What each cell of path_table currently means. */
+static unsigned char path_state[MAX_FILE_TYPES][MAX_FILE_TYPES];
+
+/**
+ * @brief Starts with every cell unknown.
+ */
+void conversion_cache_initialize(void) {
+    invalidate_conversion_paths();
+}
+
+/**
+ * @brief Frees all cached paths, leaving the cache empty.
+ */
+void conversion_cache_cleanup(void) {
+    invalidate_conversion_paths();
+}
+
+/**
+ * @brief Frees every cached path and marks all cells unknown, so the next
+ * lookup of each pair searches the (possibly changed) conversion graph again.
+ */
+void invalidate_conversion_paths(void) {
+    for (int from = 0; from < MAX_FILE_TYPES; from++) {
+        for (int to = 0; to < MAX_FILE_TYPES; to++) {
+            if (path_state[from][to] == PATH_PRESENT) {
+                free(path_table[from][to]);
+            }
+            path_table[from][to] = NULL;
+            path_state[from][to] = PATH_UNKNOWN;
+        }
+    }
+}
+
+/**
+ * @brief Looks up (and on a miss computes and stores) the path between two types.
+ *
+ * Types whose index falls outside the table cannot be cached and are reported
+ * as having no path.
+ *
+ * @param from Source file type.
+ * @param to   Destination file type.
+ * @return The shared path, or NULL if none exists.
+ */
+CONVERSION *const *lookup_conversion_path(FILE_TYPE *from, FILE_TYPE *to) {
+    if (!from || !to ||
+        from->index < 0 || from->index >= MAX_FILE_TYPES ||
+        to->index < 0 || to->index >= MAX_FILE_TYPES) {
+        return NULL;
+    }
+
+    unsigned char *state = &path_state[from->index][to->index];
+    if (*state == PATH_UNKNOWN) {
+        CONVERSION **path = find_conversion_path(from->name, to->name);
+        path_table[from->index][to->index] = path;
+        *state = path ? PATH_PRESENT : PATH_ABSENT;
+    }
+    return path_table[from->index][to->index];
+}
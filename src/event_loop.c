@@ -0,0 +1,228 @@
+/**
+ * @file event_loop.c
+ * @brief Implements the epoll-based event loop of the presi spooler.
+ *
+ * Each registered descriptor is described by an event_source referenced from
+ * its epoll registration and from a table indexed by the descriptor, so
+ * finding, modifying and removing a registration take constant time however
+ * many descriptors are watched. Sources removed while a batch of events is
+ * being dispatched are only marked dead, moved to a list of dead sources and
+ * freed once the batch is over, so a handler may remove any descriptor
+ * (including its own) without leaving a dangling pointer behind for a later
+ * event in the same batch.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "event_loop.h"
+
+/** @brief Maximum number of events collected by a single epoll_wait() call. */
+#define MAX_EVENTS_PER_WAIT 64
+
+/**
+ * @struct event_source
+ * @brief One registered descriptor and the callback that services it.
+ */
+struct event_source {
+    int fd;                          ///< The watched descriptor.
+    int dead;                        ///< Set once removed; the entry is freed after the current batch.
+    event_handler_func_t *handler;   ///< Callback for ready events.
+    void *context;                   ///< Opaque pointer passed to the callback.
+    struct event_source *next_dead;  ///< Next source awaiting release, once dead.
+};
+
+/** @brief The epoll instance, or -1 before initialization. */
+static int epoll_fd = -1;
+
+/** @brief Live source of each descriptor, or NULL; grown to cover the largest descriptor registered. */
+static struct event_source **sources_by_fd = NULL;
+
+/** @brief Number of entries of sources_by_fd. */
+static int source_table_size = 0;
+
+/** @brief Sources removed during the current batch, awaiting release. */
+static struct event_source *dead_sources = NULL;
+
+/** @brief Nonzero while handlers of a batch are running. */
+static int dispatching = 0;
+
+/** @brief CLOCK_MONOTONIC time in nanoseconds at which the current batch was received. */
+static uint64_t wake_time_ns = 0;
+
+/**
+ * @brief Frees every source that has been marked dead.
+ */
+static void release_dead_sources(void) {
+    while (dead_sources) {
+        struct event_source *source = dead_sources;
+        dead_sources = source->next_dead;
+        free(source);
+    }
+}
+
+/**
+ * @brief Finds the live source registered for a descriptor.
+ */
+static struct event_source *find_source(int fd) {
+    return (fd >= 0 && fd < source_table_size) ? sources_by_fd[fd] : NULL;
+}
+
+/**
+ * @brief Grows the descriptor table so that it has an entry for fd.
+ *
+ * @return 0 on success, -1 if memory runs out.
+ */
+static int reserve_source_entry(int fd) {
+    if (fd < source_table_size) {
+        return 0;
+    }
+    int size = source_table_size ? source_table_size : 64;
+    while (size <= fd) {
+        size *= 2;
+    }
+    struct event_source **table = realloc(sources_by_fd, (size_t)size * sizeof(*table));
+    if (!table) {
+        return -1;
+    }
+    for (int i = source_table_size; i < size; i++) {
+        table[i] = NULL;
+    }
+    sources_by_fd = table;
+    source_table_size = size;
+    return 0;
+}
+
+/**
+ * @brief Creates the epoll instance (close-on-exec, so pipelines never inherit it).
+ *
+ * @return 0 on success or if already initialized, -1 on failure.
+ */
+int event_loop_initialize(void) {
+    if (epoll_fd >= 0) {
+        return 0;
+    }
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    return (epoll_fd < 0) ? -1 : 0;
+}
+
+/**
+ * @brief Releases every source and closes the epoll instance.
+ */
+void event_loop_cleanup(void) {
+    for (int fd = 0; fd < source_table_size; fd++) {
+        free(sources_by_fd[fd]);
+    }
+    free(sources_by_fd);
+    sources_by_fd = NULL;
+    source_table_size = 0;
+    release_dead_sources();
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+}
+
+/**
+ * @brief Allocates a source for the descriptor and adds it to the epoll set.
+ *
+ * @return 0 on success, -1 if the descriptor is already registered or if allocation or epoll_ctl() fails.
+ */
+int event_loop_add(int fd, uint32_t events, event_handler_func_t *handler, void *context) {
+    if (fd < 0 || find_source(fd) || reserve_source_entry(fd) < 0) {
+        return -1;
+    }
+    struct event_source *source = calloc(1, sizeof(*source));
+    if (!source) {
+        return -1;
+    }
+    source->fd = fd;
+    source->handler = handler;
+    source->context = context;
+
+    struct epoll_event event = { .events = events, .data.ptr = source };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        free(source);
+        return -1;
+    }
+
+    sources_by_fd[fd] = source;
+    return 0;
+}
+
+/**
+ * @brief Replaces the event mask of a registered descriptor.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int event_loop_modify(int fd, uint32_t events) {
+    struct event_source *source = find_source(fd);
+    if (!source) {
+        return -1;
+    }
+    struct epoll_event event = { .events = events, .data.ptr = source };
+    return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
+}
+
+/**
+ * @brief Removes a descriptor from the epoll set. While a batch is being
+ * dispatched the source is only marked dead, and freed after the batch.
+ *
+ * @return 0 on success, -1 if the descriptor is not registered.
+ */
+int event_loop_remove(int fd) {
+    struct event_source *source = find_source(fd);
+    if (!source) {
+        return -1;
+    }
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    sources_by_fd[fd] = NULL;
+    source->dead = 1;
+    source->next_dead = dead_sources;
+    dead_sources = source;
+    if (!dispatching) {
+        release_dead_sources();
+    }
+    return 0;
+}
+
+/**
+ * @brief Waits up to timeout_ms for events and dispatches them to their handlers.
+ *
+ * @return The number of events received, 0 on timeout or EINTR, -1 on error.
+ */
+int event_loop_run_once(int timeout_ms) {
+    struct epoll_event events[MAX_EVENTS_PER_WAIT];
+
+    int ready = epoll_wait(epoll_fd, events, MAX_EVENTS_PER_WAIT, timeout_ms);
+    if (ready < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+    if (ready > 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        wake_time_ns = (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+    }
+
+    dispatching = 1;
+    for (int i = 0; i < ready; i++) {
+        struct event_source *source = events[i].data.ptr;
+        if (!source->dead) {
+            source->handler(source->fd, events[i].events, source->context);
+        }
+    }
+    dispatching = 0;
+
+    release_dead_sources();
+    return ready;
+}
+
+/**
+ * @brief Returns the time stamped when the current batch was received.
+ */
+uint64_t event_loop_wake_time_ns(void) {
+    return wake_time_ns;
+}
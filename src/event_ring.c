@@ -0,0 +1,235 @@
+/**
+ * @file event_ring.c
+ * @brief Implements the event ring.
+ *
+ * Records are variable-length: a fixed header with the event type and its
+ * integer arguments, followed by its string arguments, each NUL-terminated.
+ * A record never wraps around the end of the ring; if it does not fit in the
+ * bytes left before the end, those bytes become a padding record and the
+ * record starts again at the beginning.
+ *
+ * The producer only advances tail and the consumer only advances head, each
+ * published with a release store and read with an acquire load, so the ring
+ * needs no lock even if it were drained from another thread.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "event_ring.h"
+
+/**
+ * @brief Longest pipeline a job-started record can carry; emit_job_started()
+ * reports a longer one with a direct sf_job_started() call instead.
+ */
+#define EVENT_MAX_PATH 64
+
+/** @brief Kinds of record. */
+enum event_type {
+    EVENT_PADDING,
+    EVENT_CMD_OK,
+    EVENT_CMD_ERROR,
+    EVENT_PRINTER_DEFINED,
+    EVENT_PRINTER_STATUS,
+    EVENT_JOB_CREATED,
+    EVENT_JOB_STARTED,
+    EVENT_JOB_FINISHED,
+    EVENT_JOB_ABORTED,
+    EVENT_JOB_DELETED,
+    EVENT_JOB_STATUS
+};
+
+/**
+ * @struct event_record
+ * @brief The fixed part of a record; string_count strings follow it.
+ */
+struct event_record {
+    uint16_t length;       ///< Size of the whole record, a multiple of 4.
+    uint8_t type;          ///< An event_type.
+    uint8_t string_count;  ///< Number of strings after the header.
+    int32_t id;            ///< Job ID, where there is one.
+    int32_t value;         ///< Status, process group or signal, where there is one.
+};
+
+/** @brief The ring itself. */
+static char ring[EVENT_RING_SIZE] __attribute__((aligned(8)));
+
+/** @brief Total bytes ever consumed; advanced only by event_ring_drain(). */
+static uint32_t head;
+
+/** @brief Total bytes ever produced; advanced only by the emit_* functions. */
+static uint32_t tail;
+
+/**
+ * @brief Appends a record, draining the ring first if it is full.
+ *
+ * @param strings Array of string_count strings to copy into the record.
+ * @return 0 on success, -1 if the record is larger than EVENT_RECORD_MAX.
+ */
+static int push(int type, int id, int value, char **strings, int string_count) {
+    size_t size = sizeof(struct event_record);
+    for (int i = 0; i < string_count; i++) {
+        size += strlen(strings[i]) + 1;
+    }
+    size = (size + 3) & ~(size_t)3;
+    if (size > EVENT_RECORD_MAX) {
+        return -1;
+    }
+
+    uint32_t offset = tail & (EVENT_RING_SIZE - 1);
+    uint32_t contiguous = EVENT_RING_SIZE - offset;
+    uint32_t needed = (uint32_t)size + ((size > contiguous) ? contiguous : 0);
+    if (EVENT_RING_SIZE - (tail - __atomic_load_n(&head, __ATOMIC_ACQUIRE)) < needed) {
+        event_ring_drain();
+    }
+
+    uint32_t position = tail;
+    if (size > contiguous) {
+        struct event_record padding = { .length = (uint16_t)contiguous, .type = EVENT_PADDING };
+        memcpy(ring + offset, &padding, (contiguous < sizeof(padding)) ? contiguous : sizeof(padding));
+        position += contiguous;
+        offset = 0;
+    }
+
+    struct event_record *record = (struct event_record *)(ring + offset);
+    record->length = (uint16_t)size;
+    record->type = (uint8_t)type;
+    record->string_count = (uint8_t)string_count;
+    record->id = id;
+    record->value = value;
+    char *text = (char *)(record + 1);
+    for (int i = 0; i < string_count; i++) {
+        size_t length = strlen(strings[i]) + 1;
+        memcpy(text, strings[i], length);
+        text += length;
+    }
+    __atomic_store_n(&tail, position + (uint32_t)size, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * @brief Makes the sf_* call for one record.
+ */
+static void deliver(const struct event_record *record) {
+    char *strings[EVENT_MAX_PATH + 2] = { NULL };
+    char *text = (char *)(record + 1);
+    for (int i = 0; i < record->string_count; i++) {
+        strings[i] = text;
+        text += strlen(text) + 1;
+    }
+
+    switch (record->type) {
+        case EVENT_CMD_OK:
+            sf_cmd_ok();
+            break;
+        case EVENT_CMD_ERROR:
+            sf_cmd_error(strings[0]);
+            break;
+        case EVENT_PRINTER_DEFINED:
+            sf_printer_defined(strings[0], strings[1]);
+            break;
+        case EVENT_PRINTER_STATUS:
+            sf_printer_status(strings[0], (PRINTER_STATUS)record->value);
+            break;
+        case EVENT_JOB_CREATED:
+            sf_job_created(record->id, strings[0], strings[1]);
+            break;
+        case EVENT_JOB_STARTED:
+            sf_job_started(record->id, strings[0], record->value, strings + 1);
+            break;
+        case EVENT_JOB_FINISHED:
+            sf_job_finished(record->id, record->value);
+            break;
+        case EVENT_JOB_ABORTED:
+            sf_job_aborted(record->id, record->value);
+            break;
+        case EVENT_JOB_DELETED:
+            sf_job_deleted(record->id);
+            break;
+        case EVENT_JOB_STATUS:
+            sf_job_status(record->id, (JOB_STATUS)record->value);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Delivers every record produced so far.
+ */
+void event_ring_drain(void) {
+    uint32_t end = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+    uint32_t position = head;
+    while (position != end) {
+        const struct event_record *record = (const struct event_record *)(ring + (position & (EVENT_RING_SIZE - 1)));
+        position += record->length;
+        if (record->type != EVENT_PADDING) {
+            deliver(record);
+        }
+        __atomic_store_n(&head, position, __ATOMIC_RELEASE);
+    }
+}
+
+void emit_cmd_ok(void) {
+    push(EVENT_CMD_OK, 0, 0, NULL, 0);
+}
+
+void emit_cmd_error(char *msg) {
+    if (push(EVENT_CMD_ERROR, 0, 0, &msg, 1) < 0) {
+        event_ring_drain();
+        sf_cmd_error(msg);
+    }
+}
+
+void emit_printer_defined(char *name, char *type) {
+    char *strings[] = { name, type };
+    if (push(EVENT_PRINTER_DEFINED, 0, 0, strings, 2) < 0) {
+        event_ring_drain();
+        sf_printer_defined(name, type);
+    }
+}
+
+void emit_printer_status(char *name, PRINTER_STATUS status) {
+    if (push(EVENT_PRINTER_STATUS, 0, (int)status, &name, 1) < 0) {
+        event_ring_drain();
+        sf_printer_status(name, status);
+    }
+}
+
+void emit_job_created(int id, char *file_name, char *file_type) {
+    char *strings[] = { file_name, file_type };
+    if (push(EVENT_JOB_CREATED, id, 0, strings, 2) < 0) {
+        event_ring_drain();
+        sf_job_created(id, file_name, file_type);
+    }
+}
+
+void emit_job_started(int id, char *printer, int pgid, char **path) {
+    char *strings[EVENT_MAX_PATH + 1] = { printer };
+    int count = 1;
+    while (count <= EVENT_MAX_PATH && path[count - 1]) {
+        strings[count] = path[count - 1];
+        count++;
+    }
+    // A pipeline too long for a record is delivered whole, like a record too large for the ring
+    if (path[count - 1] || push(EVENT_JOB_STARTED, id, pgid, strings, count) < 0) {
+        event_ring_drain();
+        sf_job_started(id, printer, pgid, path);
+    }
+}
+
+void emit_job_finished(int id, int status) {
+    push(EVENT_JOB_FINISHED, id, status, NULL, 0);
+}
+
+void emit_job_aborted(int id, int status) {
+    push(EVENT_JOB_ABORTED, id, status, NULL, 0);
+}
+
+void emit_job_deleted(int id) {
+    push(EVENT_JOB_DELETED, id, 0, NULL, 0);
+}
+
+void emit_job_status(int id, JOB_STATUS status) {
+    push(EVENT_JOB_STATUS, id, (int)status, NULL, 0);
+}
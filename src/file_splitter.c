@@ -0,0 +1,218 @@
+/**
+ * @file file_splitter.c
+ * @brief Implements the splitting of a print file into chunk files.
+ *
+ * The file is read once to find, for every target cut (an equal share of its
+ * size), the first page delimiter and the first record delimiter at or past it.
+ * The chunks are then copied out with copy_file_range(), falling back to
+ * pread()/write() where the kernel cannot copy between the two files.
+ */
+
+#define _GNU_SOURCE  // copy_file_range()
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "file_splitter.h"
+#include "presi.h"
+
+/** @brief Size of the buffer used to scan for delimiters and to copy as a fallback. */
+#define SPLIT_CHUNK (64 * 1024)
+
+/** @brief Length of a chunk file path: directory, separator and two numbers. */
+#define SPLIT_PATH_MAX (sizeof(SPLIT_DIR) + 32)
+
+/**
+ * @struct cut_search
+ * @brief Cut positions found so far for one delimiter.
+ */
+struct cut_search {
+    char delimiter;             ///< The delimiter looked for.
+    off_t cuts[MAX_PRINTERS];   ///< Offset just past the chosen delimiter for each target.
+    int found;                  ///< Number of targets that have a cut.
+};
+
+/**
+ * @brief Records the delimiters of one buffer: each one settles every target it reaches.
+ */
+static void find_cuts(struct cut_search *search, const char *buffer, size_t length, off_t base,
+                      const off_t targets[], int target_count) {
+    const char *p = buffer;
+    const char *end = buffer + length;
+    while (search->found < target_count && (p = memchr(p, search->delimiter, (size_t)(end - p))) != NULL) {
+        off_t cut = base + (p - buffer) + 1;
+        while (search->found < target_count && cut >= targets[search->found]) {
+            search->cuts[search->found++] = cut;
+        }
+        p++;
+    }
+}
+
+/**
+ * @brief Turns the cuts found for the targets into strictly increasing cuts
+ * inside the file, dropping repeats and cuts at its very end.
+ *
+ * @return The number of distinct cuts.
+ */
+static int distinct_cuts(const struct cut_search *search, off_t size, off_t cuts[]) {
+    int count = 0;
+    for (int i = 0; i < search->found; i++) {
+        if (search->cuts[i] < size && (count == 0 || search->cuts[i] > cuts[count - 1])) {
+            cuts[count++] = search->cuts[i];
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Copies length bytes at offset of in_fd to out_fd.
+ */
+static int copy_range(int in_fd, off_t offset, int out_fd, off_t length) {
+    while (length > 0) {
+        ssize_t n = copy_file_range(in_fd, &offset, out_fd, NULL, (size_t)length, 0);
+        if (n > 0) {
+            length -= n;
+            continue;
+        }
+        if (n == 0) {
+            return -1;  // The file shrank meanwhile
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP) {
+            return -1;
+        }
+
+        // The kernel cannot copy between these files; do it by hand
+        static char buffer[SPLIT_CHUNK];
+        while (length > 0) {
+            ssize_t got = pread(in_fd, buffer, (length < SPLIT_CHUNK) ? (size_t)length : SPLIT_CHUNK, offset);
+            if (got <= 0) {
+                if (got < 0 && errno == EINTR) {
+                    continue;
+                }
+                return -1;
+            }
+            for (ssize_t done = 0; done < got;) {
+                ssize_t put = write(out_fd, buffer + done, (size_t)(got - done));
+                if (put < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return -1;
+                }
+                done += put;
+            }
+            offset += got;
+            length -= got;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Finds the cuts, then writes each chunk to SPLIT_DIR/<tag>.<n>.
+ */
+int split_file(const char *input_path, int max_chunks, int tag, char *chunk_paths[]) {
+    struct stat file_stat;
+    int in_fd = open(input_path, O_RDONLY | O_CLOEXEC);
+    if (in_fd < 0) {
+        return -1;
+    }
+    if (fstat(in_fd, &file_stat) < 0) {
+        close(in_fd);
+        return -1;
+    }
+    off_t size = file_stat.st_size;
+    if (max_chunks > MAX_PRINTERS) {
+        max_chunks = MAX_PRINTERS;
+    }
+    if (max_chunks < 2 || size < 2) {
+        close(in_fd);
+        return 0;
+    }
+
+    // Cut k + 1 should fall as close as possible past (k + 1) / max_chunks of the file
+    off_t targets[MAX_PRINTERS];
+    int target_count = max_chunks - 1;
+    for (int k = 0; k < target_count; k++) {
+        targets[k] = size * (k + 1) / max_chunks;
+    }
+
+    struct cut_search pages = { .delimiter = PAGE_DELIMITER, .found = 0 };
+    struct cut_search records = { .delimiter = RECORD_DELIMITER, .found = 0 };
+    static char buffer[SPLIT_CHUNK];
+    off_t base = 0;
+    ssize_t n;
+    while ((pages.found < target_count || records.found < target_count) &&
+           (n = read(in_fd, buffer, sizeof(buffer))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            close(in_fd);
+            return -1;
+        }
+        find_cuts(&pages, buffer, (size_t)n, base, targets, target_count);
+        find_cuts(&records, buffer, (size_t)n, base, targets, target_count);
+        base += n;
+    }
+
+    // Whole pages if the file has any page breaks, whole records otherwise
+    off_t cuts[MAX_PRINTERS];
+    int cut_count = distinct_cuts(&pages, size, cuts);
+    if (cut_count == 0) {
+        cut_count = distinct_cuts(&records, size, cuts);
+    }
+    if (cut_count == 0) {
+        close(in_fd);
+        return 0;
+    }
+
+    mkdir("spool", 0777);
+    mkdir(SPLIT_DIR, 0777);
+    int chunk_count = 0;
+    int failed = 0;
+    for (int i = 0; i <= cut_count && !failed; i++) {
+        off_t start = (i == 0) ? 0 : cuts[i - 1];
+        off_t end = (i == cut_count) ? size : cuts[i];
+
+        char *path = malloc(SPLIT_PATH_MAX);
+        if (!path) {
+            failed = 1;
+            break;
+        }
+        snprintf(path, SPLIT_PATH_MAX, SPLIT_DIR "/%d.%d", tag, i);
+        chunk_paths[chunk_count++] = path;
+
+        int out_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        failed = (out_fd < 0 || copy_range(in_fd, start, out_fd, end - start) < 0);
+        if (out_fd >= 0) {
+            close(out_fd);
+        }
+    }
+    close(in_fd);
+
+    if (failed) {
+        discard_chunk_files(chunk_paths, chunk_count);
+        return -1;
+    }
+    return chunk_count;
+}
+
+/**
+ * @brief Unlinks every chunk file and frees its path.
+ */
+void discard_chunk_files(char *chunk_paths[], int count) {
+    for (int i = 0; i < count; i++) {
+        unlink(chunk_paths[i]);
+        free(chunk_paths[i]);
+        chunk_paths[i] = NULL;
+    }
+}
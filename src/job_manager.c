@@ -2,18 +2,39 @@
  * @file job_manager.c
  * @brief Manages the creation, lifecycle, and scheduling of print jobs within the presi spooler system.
  *
- * This module holds an array of active jobs, provides functions to create jobs,
+ * This module holds a slab of job slots, provides functions to create jobs,
  * schedule them on compatible printers, manage conversion pipelines, and handle
  * job termination or cleanup. The design includes concurrency safeguards (a mutex)
  * for shared data and a 10-second delay for final job removal, ensuring a brief
- * window for inspection of completed or aborted jobs.
+ * window for inspection of completed or aborted jobs. That delay is an expiry
+ * timer embedded in each job slot and driven by the timer wheel.
+ *
+ * Jobs never move once they are placed in a slot. Free slots are kept on a
+ * free list, live jobs are threaded through a creation-ordered list, and an
+ * open-addressed hash maps each job ID to its slot, so creation, lookup and
+ * removal are all constant time and an ID keeps naming the same job no matter
+ * how many other jobs come and go.
+ *
+ * Pipeline stages are started with posix_spawnp() (see pipeline_launcher.c)
+ * rather than by forking the spooler. Every stage is tracked through a pidfd
+ * registered with the event loop, which reports the exit of that one process,
+ * and a second hash maps the pipeline's process group ID to its slot for the
+ * stop/continue reports delivered through SIGCHLD. Control signals go through
+ * the pidfds too, so they can never reach an unrelated process that happens to
+ * have recycled a PID.
  */
 
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/pidfd.h>
+#include <sys/epoll.h>
 #include <errno.h>
 #include <pthread.h>
 #include <signal.h>
@@ -24,449 +45,2024 @@
 #include "printer_manager.h"
 #include "printer_struct.h"
 #include "conversions.h"
+#include "conversion_cache.h"
+#include "capture.h"
+#include "debug.h"
+#include "event_loop.h"
+#include "event_ring.h"
+#include "file_splitter.h"
+#include "journal.h"
+#include "latency_stats.h"
+#include "output_cache.h"
+#include "pipeline_launcher.h"
+#include "relay.h"
+#include "stage_usage.h"
+#include "timer_wheel.h"
+#include "tracer.h"
 #include "presi.h"
 
-/** @brief Global array storing all tracked print jobs. */
-static JOB job_spool[MAX_JOBS];
+/** @brief Number of buckets in each slot hash (a power of two, at least twice MAX_JOBS). */
+#define SLOT_TABLE_SIZE (MAX_JOBS * 2)
+
+/**
+ * @brief Maximum number of stages in a pipeline. A conversion path visits each
+ * file type at most once, so it has fewer than MAX_FILE_TYPES conversions.
+ */
+#define MAX_PIPELINE_STAGES MAX_FILE_TYPES
+
+/** @brief Marks an empty hash bucket or the end of a slot list. */
+#define NO_SLOT (-1)
+
+/** @brief Milliseconds a finished or aborted job stays visible before it is deleted. */
+#define JOB_RETENTION_MS 10000
+
+/** @brief Maximum number of ahead-of-time conversions running at once. */
+#define MAX_PRECONVERSIONS 2
+
+/** @brief Maximum number of fan-out groups at once; each one keeps at least one printer busy. */
+#define MAX_FANOUT_GROUPS MAX_PRINTERS
+
+/** @brief Milliseconds to wait before reconnecting to a printer that dropped a job's connection. */
+#define RELAY_RECONNECT_MS 100
+
+/** @brief Number of times a job reconnects to its printer before it gives up and fails. */
+#define MAX_RELAY_RECONNECTS 10
+
+/** @brief States of the ahead-of-time conversion of a waiting job. */
+#define PRECONVERSION_NONE 0     ///< Not attempted yet.
+#define PRECONVERSION_RUNNING 1  ///< Its pipeline is writing the output into the output cache.
+#define PRECONVERSION_DONE 2     ///< Finished, abandoned, or not applicable to the job.
+
+/** @brief Results of dispatch_job() other than 0, the job was started. */
+#define DISPATCH_NO_PATH (-1)   ///< No conversion path exists; the job is left untouched.
+#define DISPATCH_DEFERRED 1     ///< The printer cannot be reached yet; a retry is scheduled.
+
+/**
+ * @struct pipeline_stage
+ * @brief One process of a running pipeline, as registered with the event loop.
+ */
+struct pipeline_stage {
+    JOB *job;   ///< The job the stage belongs to.
+    pid_t pid;  ///< PID of the stage, or -1 if it could not be started.
+    int pidfd;  ///< pidfd of the stage, or -1 once it has been reaped (or was never started).
+    int usage_slot;  ///< Where its resource usage is accounted (see stage_usage_slot()), or -1.
+    uint64_t started_ns;  ///< When the stage was started, for its trace span.
+};
+
+/**
+ * @struct fanout_group
+ * @brief One conversion whose output is printed on one or more printers.
+ *
+ * The pipeline belongs to the first copy, the leader. Its last stage writes
+ * into a capture that saves the output in a file of the output cache, and every
+ * copy, the leader included, has a growing relay that sends that file to its
+ * own printer as it grows. Each printer thus receives the data at its own pace
+ * while the conversion runs only once. Every converted job is printed this way,
+ * most of them as the only copy, so that the spooler retains the output a
+ * printer has not read yet and can resend it after a dropped connection.
+ */
+struct fanout_group {
+    int in_use;                        ///< Nonzero while the group is converting.
+    CAPTURE capture;                   ///< Saves the pipeline's output into the file.
+    char *path;                        ///< The file (an output cache temporary file).
+    OUTPUT_CACHE_KEY cache_key;        ///< Output cache key of the file's contents.
+    off_t produced;                    ///< Bytes of output saved so far.
+    int capture_error;                 ///< Nonzero if the output could not be saved completely.
+    JOB_HANDLE members[MAX_PRINTERS];  ///< Every copy; members[0] is the leader.
+    int member_count;                  ///< Number of entries of members in use.
+};
+
+/**
+ * @struct job_slot
+ * @brief One entry of the job slab: the job itself plus the slab bookkeeping.
+ *
+ * The generation counter is bumped every time the slot is released, so a
+ * JOB_HANDLE taken for an earlier occupant stops resolving once the slot is reused.
+ */
+struct job_slot {
+    JOB job;              ///< Must stay first so a JOB pointer maps straight back to its slot.
+    uint32_t generation;  ///< Incremented each time the slot is released.
+    int in_use;           ///< Nonzero while the slot holds a tracked job.
+    int next;             ///< Next free slot, or next live job in creation order.
+    int prev;             ///< Previous live job in creation order.
+    TIMER expiry_timer;   ///< Fires when a terminated job's retention period is over.
+    int ready_next;       ///< Next job in the same ready queue.
+    int ready_prev;       ///< Previous job in the same ready queue.
+    uint64_t sequence;    ///< Submission order; never wraps, unlike the job ID.
+    struct pipeline_stage stages[MAX_PIPELINE_STAGES]; ///< Processes of the job's pipeline.
+    int stage_count;      ///< Number of entries of stages in use.
+    int live_stages;      ///< Stages that have not been reaped yet.
+    int failed_stages;    ///< Stages that could not start or exited unsuccessfully.
+    int abort_signal;     ///< Signal that killed a stage (other than SIGPIPE), or 0.
+    RELAY relay;          ///< Copies the file or the captured output to the printer.
+    TIMER reconnect_timer; ///< Fires when the relay should reconnect after a dropped connection.
+    int reconnects;       ///< Reconnections attempted since the relay started.
+    char *cache_fill_path; ///< Where the pipeline saves its output for the output cache, or NULL.
+    OUTPUT_CACHE_KEY cache_key; ///< Output cache key of the pipeline's output, if cache_fill_path is set.
+    int preconversion;    ///< PRECONVERSION_* state; the pipeline fields serve it while the job waits.
+    int candidate_next;   ///< Next job on the preconversion candidate list.
+    int candidate_prev;   ///< Previous job on the preconversion candidate list.
+    int is_candidate;     ///< Nonzero while the job is on the preconversion candidate list.
+    int relay_failed;     ///< Nonzero if the relay could not deliver the whole file.
+    struct fanout_group *fanout; ///< The fan-out group this job leads, or NULL.
+    int split_chunks;     ///< For the parent of a split job, its number of chunks; 0 otherwise.
+    int pending_chunks;   ///< Chunks of a split job that have not terminated yet.
+    int failed_chunks;    ///< Chunks of a split job that failed or were aborted.
+    int is_chunk;         ///< Nonzero if this job prints one chunk of a split job.
+    JOB_HANDLE split_parent; ///< The parent of a chunk, if is_chunk is set.
+    int owns_input_file;  ///< Nonzero if the input is a chunk file to remove once it has been opened.
+    uint64_t journal_ticket; ///< Ticket of the job's journal records, or 0 if it is not journaled.
+};
+
+/** @brief Slab storing every tracked print job. */
+static struct job_slot job_slab[MAX_JOBS];
+
+/** @brief Head of the free-slot list. */
+static int free_slot_head = NO_SLOT;
+
+/** @brief Oldest and newest live jobs, linked through job_slot.next/prev. */
+static int live_head = NO_SLOT;
+static int live_tail = NO_SLOT;
+
+/**
+ * @brief FIFO of JOB_CREATED jobs for each FILE_TYPE.index, linked through
+ * job_slot.ready_next/ready_prev.
+ */
+static int ready_head[MAX_FILE_TYPES];
+static int ready_tail[MAX_FILE_TYPES];
+
+/** @brief Bit t is set whenever the ready queue for type index t is non-empty. */
+static uint64_t types_with_ready_jobs = 0;
+
+/**
+ * @brief Waiting jobs whose preconversion is PRECONVERSION_NONE, oldest first,
+ * linked through job_slot.candidate_next/candidate_prev.
+ */
+static int candidate_head = NO_SLOT;
+static int candidate_tail = NO_SLOT;
+
+/** @brief Sequence number given to the next submitted job. */
+static uint64_t next_job_sequence = 0;
 
-/** @brief Current count of active jobs in job_spool. */
+/** @brief Open-addressed (linear probing) map from job ID to slot index. */
+static int job_id_table[SLOT_TABLE_SIZE];
+
+/** @brief Map from pipeline process group ID to slot index, for jobs whose pipeline has not been fully reaped. */
+static int job_pid_table[SLOT_TABLE_SIZE];
+
+/** @brief Fires when a dispatch put off because its printer could not be reached is due again. */
+static TIMER dispatch_retry_timer;
+
+/** @brief Fan-out groups, free when not in_use. */
+static struct fanout_group fanout_groups[MAX_FANOUT_GROUPS];
+
+/** @brief Number of jobs whose preconversion is PRECONVERSION_RUNNING. */
+static int running_preconversions = 0;
+
+/** @brief ID handed to the next submitted job; IDs only ever increase until they wrap. */
+static int next_job_id = 0;
+
+/** @brief Current count of active jobs in job_slab. */
 static int job_count = 0;
 
 /** @brief Mutex used to synchronize access to job-related data structures. */
 static pthread_mutex_t job_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/** @brief Counters reported by job_manager_get_metrics(). */
+static unsigned long jobs_submitted = 0;
+static unsigned long pipelines_launched = 0;
+static unsigned long spawn_failures = 0;
+
+/** @brief Name of every FILE_TYPE.index a job has been submitted for, so its queue depth is reported even at 0. */
+static const char *submitted_type_names[MAX_FILE_TYPES];
+
+/** @brief Delays between the report of a stage's exit and its reaping. */
+static LATENCY_HISTOGRAM reap_latency;
+
+/**
+ * @brief Maps a job pointer handed out by this module back to its slab index.
+ */
+static int slot_of_job(const JOB *job) {
+    return (int)((const struct job_slot *)job - job_slab);
+}
+
+/** @brief Extracts the key a slot is filed under in one of the slot hashes. */
+typedef int slot_key_func_t(int slot);
+
+/** @brief Key of job_id_table: the job ID. */
+static int job_id_key(int slot) {
+    return job_slab[slot].job.id;
+}
+
+/** @brief Key of job_pid_table: the pipeline's process group ID. */
+static int job_pid_key(int slot) {
+    return job_slab[slot].job.pgid;
+}
+
+/**
+ * @brief Returns the home bucket of a key in a slot hash.
+ */
+static int slot_bucket(int key) {
+    return (int)((unsigned int)key & (SLOT_TABLE_SIZE - 1));
+}
+
+/**
+ * @brief Looks up the slot filed under the given key.
+ *
+ * @return The slot index, or NO_SLOT if no slot in the table has that key.
+ */
+static int find_slot(const int *table, slot_key_func_t *key_of, int key) {
+    for (int b = slot_bucket(key); table[b] != NO_SLOT; b = (b + 1) & (SLOT_TABLE_SIZE - 1)) {
+        if (key_of(table[b]) == key) {
+            return table[b];
+        }
+    }
+    return NO_SLOT;
+}
+
+/**
+ * @brief Files slot under key. A table can never fill up because it has twice
+ * as many buckets as there are slots.
+ */
+static void insert_slot(int *table, int key, int slot) {
+    int b = slot_bucket(key);
+    while (table[b] != NO_SLOT) {
+        b = (b + 1) & (SLOT_TABLE_SIZE - 1);
+    }
+    table[b] = slot;
+}
+
+/**
+ * @brief Removes key from a slot hash using backward-shift deletion, so no
+ * tombstones build up under heavy churn. The slot must still report the key it
+ * was filed under.
+ */
+static void remove_slot(int *table, slot_key_func_t *key_of, int key) {
+    int b = slot_bucket(key);
+    while (table[b] != NO_SLOT && key_of(table[b]) != key) {
+        b = (b + 1) & (SLOT_TABLE_SIZE - 1);
+    }
+    if (table[b] == NO_SLOT) {
+        return;
+    }
+
+    int hole = b;
+    for (int i = (hole + 1) & (SLOT_TABLE_SIZE - 1); table[i] != NO_SLOT; i = (i + 1) & (SLOT_TABLE_SIZE - 1)) {
+        int home = slot_bucket(key_of(table[i]));
+        // Move the entry into the hole unless its home bucket lies cyclically in (hole, i].
+        int stays = (hole <= i) ? (hole < home && home <= i) : (hole < home || home <= i);
+        if (!stays) {
+            table[hole] = table[i];
+            hole = i;
+        }
+    }
+    table[hole] = NO_SLOT;
+}
+
+/**
+ * @brief Takes a slot off the free list, gives it a fresh job ID and links it
+ * at the tail of the live list.
+ *
+ * IDs increase monotonically. If the counter ever wraps, IDs still held by
+ * live jobs are skipped so that no two live jobs can share an ID.
+ *
+ * @return The initialized (zeroed apart from its ID) job, or NULL if the slab is full.
+ */
+static JOB *allocate_job(void) {
+    if (free_slot_head == NO_SLOT) {
+        return NULL;
+    }
+
+    int slot = free_slot_head;
+    struct job_slot *entry = &job_slab[slot];
+    free_slot_head = entry->next;
+
+    int job_id = next_job_id;
+    while (find_slot(job_id_table, job_id_key, job_id) != NO_SLOT) {
+        job_id = (job_id == INT_MAX) ? 0 : job_id + 1;
+    }
+    next_job_id = (job_id == INT_MAX) ? 0 : job_id + 1;
+
+    memset(&entry->job, 0, sizeof(entry->job));
+    entry->job.id = job_id;
+    entry->job.pgid = -1;
+    entry->stage_count = entry->live_stages = 0;
+    entry->preconversion = PRECONVERSION_NONE;
+    entry->split_chunks = entry->pending_chunks = entry->failed_chunks = 0;
+    entry->is_chunk = 0;
+    entry->owns_input_file = 0;
+    entry->journal_ticket = 0;
+    entry->reconnects = 0;
+    entry->in_use = 1;
+    entry->ready_next = entry->ready_prev = NO_SLOT;
+    entry->candidate_next = entry->candidate_prev = NO_SLOT;
+    entry->is_candidate = 0;
+    entry->sequence = next_job_sequence++;
+    insert_slot(job_id_table, job_id, slot);
+
+    entry->next = NO_SLOT;
+    entry->prev = live_tail;
+    if (live_tail != NO_SLOT) {
+        job_slab[live_tail].next = slot;
+    } else {
+        live_head = slot;
+    }
+    live_tail = slot;
+
+    job_count++;
+    return &entry->job;
+}
+
+/**
+ * @brief Unlinks a job from the live list and the ID hash and returns its
+ * slot to the free list. The caller must already have released the job's resources.
+ */
+static void release_job(JOB *job) {
+    int slot = slot_of_job(job);
+    struct job_slot *entry = &job_slab[slot];
+
+    remove_slot(job_id_table, job_id_key, job->id);
+
+    if (entry->prev != NO_SLOT) {
+        job_slab[entry->prev].next = entry->next;
+    } else {
+        live_head = entry->next;
+    }
+    if (entry->next != NO_SLOT) {
+        job_slab[entry->next].prev = entry->prev;
+    } else {
+        live_tail = entry->prev;
+    }
+
+    entry->in_use = 0;
+    entry->generation++;
+    entry->prev = NO_SLOT;
+    entry->next = free_slot_head;
+    free_slot_head = slot;
+    job_count--;
+}
+
+/**
+ * @brief Stamps the dispatch of a job and records how long it waited in the queue.
+ */
+static void mark_job_dispatched(JOB *job) {
+    job->dispatched_ns = latency_now_ns();
+    latency_record(LATENCY_QUEUE_WAIT, job->target_printer, job->file_type, job->dispatched_ns - job->submitted_ns);
+    trace_span(TRACE_JOB_PROCESS(job->id), 0, "queued", job->submitted_ns, job->dispatched_ns);
+}
+
+/**
+ * @brief Stamps the end of a job and, if it ran to completion, records its
+ * first byte, runtime and end-to-end latencies.
+ *
+ * Canceled and aborted jobs are left out, so that the histograms describe
+ * how long printing takes rather than how soon users give up. Every job that
+ * was dispatched gets its printing span traced, from its first byte (or its
+ * dispatch, if none was sent) to its end.
+ */
+static void record_job_latency(JOB *job) {
+    struct job_slot *entry = &job_slab[slot_of_job(job)];
+    job->exited_ns = latency_now_ns();
+    if (!job->dispatched_ns) {
+        return;
+    }
+    // The relay may still hold the stamp of an earlier occupant of the slot if this job had none
+    int sent = entry->relay.first_sent_ns >= job->dispatched_ns;
+    trace_span(TRACE_JOB_PROCESS(job->id), 0, job->status == JOB_FINISHED ? "printing" : "printing (aborted)",
+               sent ? entry->relay.first_sent_ns : job->dispatched_ns, job->exited_ns);
+    if (job->status != JOB_FINISHED) {
+        return;
+    }
+    if (sent) {
+        job->first_byte_ns = entry->relay.first_sent_ns;
+        latency_record(LATENCY_FIRST_BYTE, job->target_printer, job->file_type,
+                       job->first_byte_ns - job->dispatched_ns);
+    }
+    latency_record(LATENCY_RUNTIME, job->target_printer, job->file_type, job->exited_ns - job->dispatched_ns);
+    latency_record(LATENCY_END_TO_END, job->target_printer, job->file_type, job->exited_ns - job->submitted_ns);
+}
+
+/**
+ * @brief Arms the job's expiry timer so that it is deleted once its retention
+ * period is over, records its latencies, and journals that the job has terminated.
+ */
+static void schedule_job_expiry(JOB *job) {
+    struct job_slot *entry = &job_slab[slot_of_job(job)];
+    timer_wheel_schedule(&entry->expiry_timer, JOB_RETENTION_MS);
+    record_job_latency(job);
+
+    // A terminated job is not to be recovered after a restart
+    journal_record_job_end(entry->journal_ticket);
+    entry->journal_ticket = 0;
+}
+
 /**
- * @brief Launches a conversion pipeline for a print job.
+ * @brief Puts a waiting job on the preconversion candidate list, in submission order.
  *
- * This function forks a master pipeline process, which sets a new process group
- * and launches a series of child processes — one for each conversion stage — connected
- * via pipes. If no conversion is needed (i.e., `path == NULL`), a single stage with `/bin/cat`
- * is used to directly stream the input file to the printer.
+ * New jobs are the newest, so the search from the tail normally stops at once.
+ */
+static void add_preconversion_candidate(int slot) {
+    struct job_slot *entry = &job_slab[slot];
+    if (entry->is_candidate) {
+        return;
+    }
+    int prev = candidate_tail;
+    while (prev != NO_SLOT && job_slab[prev].sequence > entry->sequence) {
+        prev = job_slab[prev].candidate_prev;
+    }
+    int next = (prev != NO_SLOT) ? job_slab[prev].candidate_next : candidate_head;
+
+    entry->candidate_prev = prev;
+    entry->candidate_next = next;
+    if (prev != NO_SLOT) {
+        job_slab[prev].candidate_next = slot;
+    } else {
+        candidate_head = slot;
+    }
+    if (next != NO_SLOT) {
+        job_slab[next].candidate_prev = slot;
+    } else {
+        candidate_tail = slot;
+    }
+    entry->is_candidate = 1;
+}
+
+/**
+ * @brief Takes a job off the preconversion candidate list, if it is on it.
+ */
+static void remove_preconversion_candidate(int slot) {
+    struct job_slot *entry = &job_slab[slot];
+    if (!entry->is_candidate) {
+        return;
+    }
+    if (entry->candidate_prev != NO_SLOT) {
+        job_slab[entry->candidate_prev].candidate_next = entry->candidate_next;
+    } else {
+        candidate_head = entry->candidate_next;
+    }
+    if (entry->candidate_next != NO_SLOT) {
+        job_slab[entry->candidate_next].candidate_prev = entry->candidate_prev;
+    } else {
+        candidate_tail = entry->candidate_prev;
+    }
+    entry->candidate_next = entry->candidate_prev = NO_SLOT;
+    entry->is_candidate = 0;
+}
+
+/**
+ * @brief Appends a JOB_CREATED job to the ready queue for its file type, and
+ * to the preconversion candidates unless its preconversion was already tried.
+ */
+static void enqueue_ready_job(JOB *job) {
+    int slot = slot_of_job(job);
+    int type_index = job->file_type->index;
+
+    job_slab[slot].ready_next = NO_SLOT;
+    job_slab[slot].ready_prev = ready_tail[type_index];
+    if (ready_tail[type_index] != NO_SLOT) {
+        job_slab[ready_tail[type_index]].ready_next = slot;
+    } else {
+        ready_head[type_index] = slot;
+    }
+    ready_tail[type_index] = slot;
+    types_with_ready_jobs |= (uint64_t)1 << type_index;
+
+    if (job_slab[slot].preconversion == PRECONVERSION_NONE) {
+        add_preconversion_candidate(slot);
+    }
+}
+
+/**
+ * @brief Unlinks a job from its ready queue, wherever it sits in the queue,
+ * and from the preconversion candidates.
+ */
+static void remove_ready_job(JOB *job) {
+    int slot = slot_of_job(job);
+    int type_index = job->file_type->index;
+    struct job_slot *entry = &job_slab[slot];
+    remove_preconversion_candidate(slot);
+
+    if (entry->ready_prev != NO_SLOT) {
+        job_slab[entry->ready_prev].ready_next = entry->ready_next;
+    } else {
+        ready_head[type_index] = entry->ready_next;
+    }
+    if (entry->ready_next != NO_SLOT) {
+        job_slab[entry->ready_next].ready_prev = entry->ready_prev;
+    } else {
+        ready_tail[type_index] = entry->ready_prev;
+    }
+    entry->ready_next = entry->ready_prev = NO_SLOT;
+
+    if (ready_head[type_index] == NO_SLOT) {
+        types_with_ready_jobs &= ~((uint64_t)1 << type_index);
+    }
+}
+
+static void handle_stage_exit(int fd, uint32_t events, void *context);
+
+/**
+ * @brief Launches a conversion pipeline for a print job and starts tracking it.
  *
- * The final stage in the pipeline writes to a file descriptor obtained by calling
- * `presi_connect_to_printer()` for the job's assigned printer.
+ * One process per conversion stage is started with launch_pipeline(), connected
+ * via pipes. The last stage writes to output_fd: the capture of the job's
+ * fan-out group when the job is dispatched (or the printer connection, if the
+ * output cannot be captured), or a file of the output cache for an ahead-of-time
+ * conversion. (Jobs that need no conversion, and jobs whose converted output is
+ * cached, do not get a pipeline at all; see start_file_relay().)
  *
  * Each process in the pipeline becomes part of the same process group, allowing the
  * spooler to manage the entire job using signals (e.g., SIGSTOP, SIGCONT, SIGTERM).
+ * Every started stage gets a pidfd registered with the event loop; the job ends
+ * once all of them have been reaped. A stage that cannot be started counts as a
+ * failed stage, just like one that exits with an error.
+ *
+ * @param job  Pointer to the JOB structure for which the pipeline is launched.
+ * @param path A non-empty, NULL-terminated array of CONVERSION pointers
+ *             representing the conversion stages.
+ * @param output_fd Where the last stage writes, or -1 if it could not be opened.
+ * @return The process group ID of the pipeline (stored as job->pgid), or -1 if no stage could be started.
+ */
+static pid_t start_conversion_pipeline(JOB *job, CONVERSION *const *path, int output_fd) {
+    int slot = slot_of_job(job);
+    struct job_slot *entry = &job_slab[slot];
+
+    char **stage_argv[MAX_PIPELINE_STAGES];
+    int num_stages = 0;
+    while (path[num_stages] && num_stages < MAX_PIPELINE_STAGES) {
+        stage_argv[num_stages] = path[num_stages]->cmd_and_args;
+        num_stages++;
+    }
+
+    pid_t pids[MAX_PIPELINE_STAGES];
+    uint64_t spawn_start_ns = latency_now_ns();
+    pid_t pgid = launch_pipeline(stage_argv, num_stages, job->input_file_path, output_fd, pids);
+    uint64_t spawn_end_ns = latency_now_ns();
+    trace_span(TRACE_JOB_PROCESS(job->id), 0, "spawn", spawn_start_ns, spawn_end_ns);
+
+    entry->stage_count = num_stages;
+    entry->live_stages = 0;
+    entry->failed_stages = 0;
+    entry->abort_signal = 0;
+    entry->relay_failed = 0;
+    for (int i = 0; i < num_stages; i++) {
+        struct pipeline_stage *stage = &entry->stages[i];
+        stage->job = job;
+        stage->pid = pids[i];
+        stage->pidfd = -1;
+        stage->usage_slot = stage_usage_slot(path[i]);
+        stage->started_ns = spawn_end_ns;
+        if (pids[i] < 0) {
+            entry->failed_stages++;
+            continue;
+        }
+
+        stage->pidfd = pidfd_open(pids[i], 0);
+        if (stage->pidfd >= 0 && event_loop_add(stage->pidfd, EPOLLIN, handle_stage_exit, stage) < 0) {
+            close(stage->pidfd);
+            stage->pidfd = -1;
+        }
+        if (stage->pidfd < 0) {
+            // Its exit could never be reported; the stage is still unreaped, so its PID is safe to use
+            kill(pids[i], SIGKILL);
+            waitpid(pids[i], NULL, 0);
+            entry->failed_stages++;
+            continue;
+        }
+        entry->live_stages++;
+    }
+
+    job->pgid = pgid;
+    if (entry->live_stages > 0) {
+        insert_slot(job_pid_table, pgid, slot);
+    }
+    pipelines_launched += (pgid >= 0);
+    for (int i = 0; i < num_stages; i++) {
+        spawn_failures += (pids[i] < 0);
+    }
+    return pgid;
+}
+
+static void complete_job_pipeline(JOB *job);
+static void report_chunk_outcome(JOB *chunk, int succeeded);
+static void end_preconversion(JOB *job);
+static void settle_fanout_if_done(struct fanout_group *group);
+
+/**
+ * @brief Relay callback: the whole file has reached the printer, the copy
+ * failed, or the printer dropped the connection.
+ *
+ * A dropped connection is not a failure as long as reconnections remain: the
+ * relay is detached at its checkpoint and reconnect_relay() resumes it shortly.
+ */
+static void handle_relay_done(void *context, int error) {
+    JOB *job = context;
+    struct job_slot *entry = &job_slab[slot_of_job(job)];
+    if (relay_is_detached(&entry->relay)) {
+        if (entry->reconnects < MAX_RELAY_RECONNECTS) {
+            entry->reconnects++;
+            debug("Job %d lost its printer connection (%s); resuming at byte %lld", job->id, strerror(error),
+                  (long long)entry->relay.delivered);
+            timer_wheel_schedule(&entry->reconnect_timer, RELAY_RECONNECT_MS);
+            return;
+        }
+        relay_cancel(&entry->relay);
+    }
+    if (error) {
+        entry->relay_failed = 1;
+    }
+    if (entry->live_stages == 0) {  // A fan-out leader also waits for its conversion
+        complete_job_pipeline(job);
+    }
+    try_scheduling_jobs();
+}
+
+/**
+ * @brief Timer callback: reconnects to the printer of a job whose relay was
+ * detached, and resumes the relay from its checkpoint.
+ *
+ * A failed attempt counts as one more dropped connection.
+ */
+static void reconnect_relay(void *context) {
+    JOB *job = context;
+    struct job_slot *entry = &job_slab[slot_of_job(job)];
+    if (!relay_is_detached(&entry->relay)) {
+        return;  // Canceled meanwhile
+    }
+    int out_fd = connect_to_printer(job->target_printer);
+    if (out_fd >= 0 && relay_reattach(&entry->relay, out_fd) == 0) {
+        return;
+    }
+    handle_relay_done(job, ECONNREFUSED);
+}
+
+/**
+ * @brief Connects to the job's printer and starts relaying in_fd to it.
+ *
+ * A printer that cannot be reached right now is treated like one that dropped
+ * the connection: the relay starts detached and reconnect_relay() tries again.
+ *
+ * @param job     A job whose target printer is set.
+ * @param in_fd   The file to send (the relay takes ownership), or -1 if it could not be opened.
+ * @param growing Nonzero for a file that is still being written (see relay_start_growing()).
+ */
+static void attach_relay(JOB *job, int in_fd, int growing) {
+    struct job_slot *entry = &job_slab[slot_of_job(job)];
+
+    entry->relay_failed = 1;
+    entry->reconnects = 0;
+    if (in_fd < 0) {
+        return;
+    }
+    int out_fd = connect_to_printer(job->target_printer);
+    // On failure, either function has closed both descriptors
+    if ((growing ? relay_start_growing : relay_start)(&entry->relay, in_fd, out_fd, handle_relay_done, job) < 0) {
+        return;
+    }
+    entry->relay_failed = 0;
+    if (out_fd < 0) {
+        entry->reconnects++;
+        timer_wheel_schedule(&entry->reconnect_timer, RELAY_RECONNECT_MS);
+    }
+}
+
+/**
+ * @brief Prints a job by relaying a file to the printer as is.
+ *
+ * Used for the job's own file when no conversion is needed, and for a cached
+ * output. Instead of a `cat` process, the spooler connects to the printer and
+ * lets the event loop move the bytes with sendfile(). A file that could not be
+ * opened, or a printer that still cannot be reached after MAX_RELAY_RECONNECTS
+ * attempts, makes the job fail with status 1, as a failing `cat` did.
+ *
+ * @param job   The job being dispatched.
+ * @param in_fd The file to send (the relay takes ownership), or -1 if it could not be opened.
+ */
+static void start_file_relay(JOB *job, int in_fd) {
+    struct job_slot *entry = &job_slab[slot_of_job(job)];
+
+    entry->stage_count = 0;
+    entry->live_stages = 0;
+    entry->failed_stages = 0;
+    entry->abort_signal = 0;
+    entry->cache_fill_path = NULL;
+    job->pgid = -1;  // No processes are involved
+
+    attach_relay(job, in_fd, 0);
+}
+
+/**
+ * @brief Reports whether a running job still has a pipeline stage or a relay at work.
+ */
+static int job_is_printing(const JOB *job) {
+    const struct job_slot *entry = &job_slab[slot_of_job(job)];
+    return entry->live_stages > 0 || relay_is_active(&entry->relay);
+}
+
+/**
+ * @brief Reaps a stage that has exited, accounts for the resources it used and
+ * traces its run.
+ *
+ * wait4() is given the stage's PID rather than its pidfd, because only it
+ * returns the rusage. That is as safe: the stage is an unreaped child, so its
+ * PID cannot have been recycled, and nothing else reaps a stage.
+ *
+ * @param stage   A stage whose pidfd is still open.
+ * @param options 0 to wait for the stage, or WNOHANG.
+ * @param status  Where the wait status goes.
+ * @return The stage's PID once reaped, 0 if it is still running (with WNOHANG), or -1 on error.
+ */
+static pid_t reap_stage(struct pipeline_stage *stage, int options, int *status) {
+    struct rusage usage;
+    pid_t pid = wait4(stage->pid, status, options, &usage);
+    if (pid > 0) {
+        stage_usage_record(stage->usage_slot, &usage);
+        int index = (int)(stage - job_slab[slot_of_job(stage->job)].stages);
+        trace_span(TRACE_JOB_PROCESS(stage->job->id), index + 1, stage_usage_command(stage->usage_slot),
+                   stage->started_ns, latency_now_ns());
+    }
+    return pid;
+}
+
+/**
+ * @brief Stops tracking one stage once it has been reaped.
+ *
+ * When the last stage goes, the pipeline's process group ID is dropped from
+ * job_pid_table; job->pgid itself is kept for display.
+ */
+static void forget_stage(struct pipeline_stage *stage) {
+    if (stage->pidfd < 0) {
+        return;
+    }
+    struct job_slot *entry = &job_slab[slot_of_job(stage->job)];
+
+    event_loop_remove(stage->pidfd);
+    close(stage->pidfd);
+    stage->pidfd = -1;
+    if (--entry->live_stages == 0) {
+        remove_slot(job_pid_table, job_pid_key, stage->job->pgid);
+    }
+}
+
+/**
+ * @brief Sends a signal to every process of a job's pipeline.
+ *
+ * Each stage is signaled through its own pidfd, which keeps naming that
+ * process even once it has been reaped, so a signal can never reach an
+ * unrelated process that has inherited a stage's PID.
+ *
+ * @param job A job with a running pipeline.
+ * @param sig The signal to send.
+ * @return 0 if at least one stage was signaled, -1 if the pipeline is gone.
+ */
+static int signal_job_pipeline(JOB *job, int sig) {
+    struct job_slot *entry = &job_slab[slot_of_job(job)];
+    int delivered = 0;
+
+    for (int i = 0; i < entry->stage_count; i++) {
+        if (entry->stages[i].pidfd >= 0 && pidfd_send_signal(entry->stages[i].pidfd, sig, NULL, 0) == 0) {
+            delivered++;
+        }
+    }
+    return delivered ? 0 : -1;
+}
+
+/**
+ * @brief Adds the output saved by a job's pipeline to the output cache, or
+ * discards it.
+ *
+ * @param job  The job whose pipeline has ended or is being abandoned.
+ * @param keep Nonzero if the file is complete: every stage succeeded and the
+ *             job was not canceled meanwhile.
+ */
+static void settle_output_cache(JOB *job, int keep) {
+    struct job_slot *entry = &job_slab[slot_of_job(job)];
+    if (!entry->cache_fill_path) {
+        return;
+    }
+
+    if (keep) {
+        output_cache_commit(entry->cache_key, entry->cache_fill_path);
+    } else {
+        output_cache_abandon(entry->cache_fill_path);
+    }
+    entry->cache_fill_path = NULL;
+}
+
+/**
+ * @brief Records the outcome of the pipeline once every stage has been reaped.
+ *
+ * A stage killed by a signal aborts the job with that signal; otherwise the job
+ * finishes with status 0 if every stage succeeded and 1 if any failed (or the
+ * relay could not deliver the data), which is what the former pipeline master
+ * process reported. A stage killed by SIGPIPE
+ * only failed because a later stage did, so it counts as a failure, not an abort.
+ * Jobs that were already canceled keep their JOB_ABORTED status. The output
+ * saved for the output cache, if any, is settled first.
+ */
+static void complete_job_pipeline(JOB *job) {
+    struct job_slot *entry = &job_slab[slot_of_job(job)];
+    settle_output_cache(job, job->status == JOB_RUNNING && entry->failed_stages == 0);
+    if (job->status == JOB_FINISHED || job->status == JOB_ABORTED) {
+        return;
+    }
+
+    pthread_mutex_lock(&job_mutex);
+    job->status = entry->abort_signal ? JOB_ABORTED : JOB_FINISHED;
+    job->status_changed_at = time(NULL);
+    schedule_job_expiry(job);
+    pthread_mutex_unlock(&job_mutex);
+
+    int succeeded = job->status == JOB_FINISHED && !entry->failed_stages && !entry->relay_failed;
+    emit_job_status(job->id, job->status);
+    if (job->status == JOB_FINISHED) {
+        // The sf_* functions take wait-status words, as the master's status used to be
+        emit_job_finished(job->id, (succeeded ? 0 : 1) << 8);
+    } else {
+        emit_job_aborted(job->id, entry->abort_signal);
+    }
+    if (job->target_printer) {
+        release_printer(job->target_printer);
+    }
+    if (entry->is_chunk) {
+        report_chunk_outcome(job, succeeded);
+    }
+}
+
+/**
+ * @brief Event loop callback for a stage's pidfd, which becomes readable when
+ * the stage exits.
+ *
+ * The stage is reaped by its own PID (see reap_stage()), so no other child's
+ * status is consumed. When it was the last live stage, the job's outcome is recorded and
+ * the freed printer is offered to waiting jobs. The end of an ahead-of-time
+ * conversion only settles its output and frees its place for another one. A
+ * fan-out leader's job lasts until its own relay is done too.
+ */
+static void handle_stage_exit(int fd, uint32_t events, void *context) {
+    (void)events;
+    struct pipeline_stage *stage = context;
+    JOB *job = stage->job;
+    struct job_slot *entry = &job_slab[slot_of_job(job)];
+
+    (void)fd;
+    int status = 0;
+    pid_t reaped = reap_stage(stage, WNOHANG, &status);
+    if (reaped < 0) {
+        // The stage cannot be waited for (already reaped elsewhere, if ECHILD); its outcome is
+        // unknown, and its pidfd must go all the same, or the loop would spin on it
+        if (errno != ECHILD) {
+            perror("reap stage");
+        }
+        status = 1 << 8;
+    } else if (reaped == 0) {
+        return;  // Not exited yet
+    }
+    uint64_t reaped_ns = latency_now_ns();
+    if (reaped_ns > event_loop_wake_time_ns()) {
+        latency_histogram_record(&reap_latency, reaped_ns - event_loop_wake_time_ns());
+    }
+
+    if (WIFEXITED(status)) {
+        if (WEXITSTATUS(status) != 0) {
+            entry->failed_stages++;
+        }
+    } else {
+        entry->failed_stages++;
+        if (WTERMSIG(status) != SIGPIPE && !entry->abort_signal) {
+            entry->abort_signal = WTERMSIG(status);
+        }
+    }
+
+    pthread_mutex_lock(&job_mutex);
+    forget_stage(stage);
+    pthread_mutex_unlock(&job_mutex);
+
+    if (entry->live_stages == 0) {
+        if (entry->preconversion == PRECONVERSION_RUNNING) {
+            settle_output_cache(job, entry->failed_stages == 0);
+            end_preconversion(job);
+        } else {
+            if (entry->fanout) {
+                settle_fanout_if_done(entry->fanout);
+            }
+            if (!relay_is_active(&entry->relay)) {
+                complete_job_pipeline(job);  // Otherwise the relay completes the job when it is done
+            }
+        }
+        try_scheduling_jobs();
+    }
+}
+
+/**
+ * @brief Marks a job's ahead-of-time conversion, if one was running, as over.
+ */
+static void end_preconversion(JOB *job) {
+    struct job_slot *entry = &job_slab[slot_of_job(job)];
+    if (entry->preconversion == PRECONVERSION_RUNNING) {
+        entry->preconversion = PRECONVERSION_DONE;
+        running_preconversions--;
+    }
+}
+
+/**
+ * @brief Tells every copy of a fan-out group how much of the output can be sent.
+ *
+ * @param group  The group.
+ * @param final  Nonzero once the output is complete (or will not grow any more).
+ * @param failed Nonzero if the output is incomplete; every copy then finishes
+ *               with a failure status, as if its own pipeline had failed.
+ */
+static void announce_fanout_output(struct fanout_group *group, int final, int failed) {
+    for (int i = 0; i < group->member_count; i++) {
+        JOB *member = get_job_by_handle(group->members[i]);
+        if (!member) {
+            continue;  // Already deleted
+        }
+        struct job_slot *entry = &job_slab[slot_of_job(member)];
+        if (final && failed) {
+            entry->failed_stages = 1;
+        }
+        relay_grow(&entry->relay, group->produced, final);
+    }
+}
+
+/**
+ * @brief Ends a fan-out group: the copies get the final length of the output,
+ * which joins the output cache if the conversion succeeded.
+ */
+static void finish_fanout(struct fanout_group *group, int succeeded) {
+    capture_cancel(&group->capture);
+    announce_fanout_output(group, 1, !succeeded);
+    if (succeeded) {
+        output_cache_commit(group->cache_key, group->path);
+    } else {
+        output_cache_abandon(group->path);
+    }
+
+    JOB *leader = get_job_by_handle(group->members[0]);
+    if (leader) {
+        job_slab[slot_of_job(leader)].fanout = NULL;
+    }
+    group->path = NULL;
+    group->in_use = 0;
+}
+
+/**
+ * @brief Ends a fan-out group once its output has been captured completely and
+ * every stage of the leader's pipeline has been reaped.
+ */
+static void settle_fanout_if_done(struct fanout_group *group) {
+    JOB *leader = get_job_by_handle(group->members[0]);
+    struct job_slot *entry = &job_slab[slot_of_job(leader)];
+    if (capture_is_active(&group->capture) || entry->live_stages > 0) {
+        return;
+    }
+    finish_fanout(group, !group->capture_error && entry->failed_stages == 0 && entry->abort_signal == 0);
+}
+
+/**
+ * @brief Capture callback: more of a fan-out group's output has been saved.
+ */
+static void handle_fanout_progress(void *context, off_t length, int done, int error) {
+    struct fanout_group *group = context;
+    group->produced = length;
+    if (!done) {
+        announce_fanout_output(group, 0, 0);
+        return;
+    }
+    group->capture_error = error;
+    settle_fanout_if_done(group);
+}
+
+/**
+ * @brief Stops tracking every stage of a job without waiting for them, and
+ * abandons its relay.
+ */
+static void forget_job_pipeline(JOB *job) {
+    struct job_slot *entry = &job_slab[slot_of_job(job)];
+    relay_cancel(&entry->relay);
+    timer_wheel_cancel(&entry->reconnect_timer);
+    for (int i = 0; i < entry->stage_count; i++) {
+        forget_stage(&entry->stages[i]);
+    }
+    settle_output_cache(job, 0);
+    end_preconversion(job);
+    if (entry->fanout) {
+        finish_fanout(entry->fanout, 0);
+    }
+}
+
+/**
+ * @brief Kills and reaps a pipeline that outlived its job's retention period
+ * (for example one that ignored SIGTERM), so its slot can be reused safely.
+ */
+static void reap_job_pipeline_now(JOB *job) {
+    struct job_slot *entry = &job_slab[slot_of_job(job)];
+    relay_cancel(&entry->relay);
+    timer_wheel_cancel(&entry->reconnect_timer);
+    if (entry->live_stages > 0) {
+        signal_job_pipeline(job, SIGKILL);
+    }
+    for (int i = 0; i < entry->stage_count; i++) {
+        int status;
+        struct pipeline_stage *stage = &entry->stages[i];
+        while (stage->pidfd >= 0 && reap_stage(stage, 0, &status) < 0 && errno == EINTR) {
+            // Retry until the stage is gone
+        }
+        forget_stage(stage);
+    }
+    settle_output_cache(job, 0);
+    end_preconversion(job);
+    if (entry->fanout) {
+        finish_fanout(entry->fanout, 0);
+    }
+}
+
+static void expire_job(void *context);
+static void retry_dispatch(void *context);
+static int dispatch_fanout(JOB *jobs[], int count, CONVERSION *const *path, OUTPUT_CACHE_KEY cache_key);
+
+/**
+ * @brief Initializes the job manager, emptying the slab.
+ *
+ * Every slot is placed on the free list (lowest index first) and the ID hash is
+ * cleared. This should be called once at startup to ensure a clean state for the job list.
+ */
+void job_manager_initialize(void) {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        job_slab[i].in_use = 0;
+        job_slab[i].prev = NO_SLOT;
+        job_slab[i].next = (i + 1 < MAX_JOBS) ? i + 1 : NO_SLOT;
+        timer_wheel_init_timer(&job_slab[i].expiry_timer, expire_job, &job_slab[i].job);
+        timer_wheel_init_timer(&job_slab[i].reconnect_timer, reconnect_relay, &job_slab[i].job);
+        relay_init(&job_slab[i].relay);
+        job_slab[i].cache_fill_path = NULL;
+        job_slab[i].preconversion = PRECONVERSION_NONE;
+        job_slab[i].is_candidate = 0;
+        job_slab[i].fanout = NULL;
+    }
+    for (int i = 0; i < MAX_FANOUT_GROUPS; i++) {
+        fanout_groups[i].in_use = 0;
+        capture_init(&fanout_groups[i].capture);
+    }
+    timer_wheel_init_timer(&dispatch_retry_timer, retry_dispatch, NULL);
+    for (int i = 0; i < SLOT_TABLE_SIZE; i++) {
+        job_id_table[i] = NO_SLOT;
+        job_pid_table[i] = NO_SLOT;
+    }
+    for (int i = 0; i < MAX_FILE_TYPES; i++) {
+        ready_head[i] = ready_tail[i] = NO_SLOT;
+    }
+    types_with_ready_jobs = 0;
+    candidate_head = candidate_tail = NO_SLOT;
+    next_job_sequence = 0;
+    free_slot_head = 0;
+    live_head = live_tail = NO_SLOT;
+    next_job_id = 0;
+    job_count = 0;
+}
+
+/**
+ * @brief Helper function to release resources allocated to a job.
+ *
+ * Frees the input_file_path (removing the file first if it is a chunk file
+ * the job still owns) and resets the job fields to defaults, preparing the
+ * slot for reuse or permanent removal.
+ *
+ * @param job Pointer to the JOB structure to be cleaned.
+ */
+static void cleanup_job(JOB *job) {
+    if (!job) return;
+    struct job_slot *entry = &job_slab[slot_of_job(job)];
+    if (entry->owns_input_file) {
+        unlink(job->input_file_path);  // A chunk that was never dispatched
+        entry->owns_input_file = 0;
+    }
+    free(job->input_file_path);
+    job->input_file_path = NULL;
+    job->target_printer = NULL;
+    job->status = JOB_DELETED;
+    job->pgid = -1;
+    job->created_at = 0;
+    job->status_changed_at = 0;
+    job->submitted_ns = job->dispatched_ns = job->first_byte_ns = job->exited_ns = 0;
+}
+
+/**
+ * @brief Timer callback that deletes a job whose retention period is over.
+ *
+ * Finished (JOB_FINISHED) or aborted (JOB_ABORTED) jobs remain visible for
+ * 10 seconds after completion, to allow users to inspect their statuses. The
+ * expiry timer fires exactly when that period ends, even if the spooler is idle,
+ * and the job is then cleaned and its slot returned to the free list.
+ *
+ * @param context The JOB to delete.
+ */
+static void expire_job(void *context) {
+    JOB *job = context;
+
+    emit_job_deleted(job->id);
+    pthread_mutex_lock(&job_mutex);
+    reap_job_pipeline_now(job);
+    cleanup_job(job);
+    release_job(job);
+    pthread_mutex_unlock(&job_mutex);
+}
+
+/**
+ * @brief Cleans up all tracked jobs, releasing memory.
+ *
+ * Walks the live list, cleaning every entry with cleanup_job() and returning
+ * its slot to the free list.
+ */
+void job_manager_cleanup(void) {
+    while (live_head != NO_SLOT) {
+        JOB *job = &job_slab[live_head].job;
+        forget_job_pipeline(job);
+        timer_wheel_cancel(&job_slab[live_head].expiry_timer);
+        cleanup_job(job);
+        release_job(job);
+    }
+    for (int i = 0; i < MAX_FILE_TYPES; i++) {
+        ready_head[i] = ready_tail[i] = NO_SLOT;
+    }
+    types_with_ready_jobs = 0;
+}
+
+/**
+ * @brief Timer callback: tries again to dispatch the jobs put off by an unreachable printer.
+ */
+static void retry_dispatch(void *context) {
+    (void)context;
+    try_scheduling_jobs();
+}
+
+/**
+ * @brief Starts a job's conversion pipeline on the given idle printer.
+ *
+ * Resolves the conversion path and launches the pipeline, whose output is
+ * captured and relayed to the printer (see dispatch_fanout()), or, when the
+ * printer already accepts the job's type, starts a relay that sends the file as
+ * is. A conversion whose output is in the output cache is not run again; the
+ * cached output is relayed instead. The
+ * job is marked JOB_RUNNING and the printer PRINTER_BUSY, and the transitions
+ * are reported through the sf_* event functions. If nothing could be started,
+ * the job finishes at once with a failure status, as it would have if every
+ * stage had exited with an error.
+ *
+ * A printer that the last stage must write to but that cannot be reached yet
+ * puts the dispatch off: the job is left as it was, with its own target
+ * printer, and dispatch_retry_timer will run the scheduler again. The caller
+ * must see that the job is on the ready queue by then (see queue_deferred_job()).
+ *
+ * @param job     A job that is not yet running.
+ * @param printer An idle printer able to print the job's type.
+ * @return 0 if the job was started, DISPATCH_NO_PATH if no conversion path
+ *         exists (the job is left untouched), or DISPATCH_DEFERRED if the
+ *         dispatch was put off.
+ */
+static int dispatch_job(JOB *job, PRINTER *printer) {
+    CONVERSION *const *path = NULL;
+    if (strcmp(job->file_type->name, printer->type->name) != 0) {
+        path = lookup_conversion_path(job->file_type, printer->type);
+        if (!path) {
+            return DISPATCH_NO_PATH;
+        }
+    }
+
+    // The printer became free first; an unfinished ahead-of-time conversion is of no use any more
+    if (job_slab[slot_of_job(job)].preconversion == PRECONVERSION_RUNNING) {
+        reap_job_pipeline_now(job);
+    }
+
+    // A converted output printed before is sent from the cache instead of being converted again
+    OUTPUT_CACHE_KEY cache_key;
+    int cacheable = path && output_cache_key(job->input_file_path, path, &cache_key) == 0;
+    int cached_fd = cacheable ? output_cache_open(cache_key) : -1;
+
+    PRINTER *requested_printer = job->target_printer;
+    pthread_mutex_lock(&job_mutex);
+    job->target_printer = printer;
+    pthread_mutex_unlock(&job_mutex);
+
+    // A new conversion is captured and relayed, as a fan-out with a single copy
+    if (cacheable && cached_fd < 0 && dispatch_fanout(&job, 1, path, cache_key) == 0) {
+        return 0;
+    }
+
+    /*
+     * Otherwise the last stage writes to the printer directly, so the printer must
+     * be reachable before the pipeline starts. A printer that is not (its daemon is
+     * starting, or overloaded) is tried again from the timer wheel, up to
+     * MAX_RELAY_RECONNECTS times, as a relay would; the job waits meanwhile.
+     */
+    int printer_fd = -1;
+    if (path && cached_fd < 0) {
+        struct job_slot *entry = &job_slab[slot_of_job(job)];
+        printer_fd = connect_to_printer(printer);
+        if (printer_fd < 0 && entry->reconnects++ < MAX_RELAY_RECONNECTS) {
+            pthread_mutex_lock(&job_mutex);
+            job->target_printer = requested_printer;
+            pthread_mutex_unlock(&job_mutex);
+            timer_wheel_schedule(&dispatch_retry_timer, RELAY_RECONNECT_MS);
+            return DISPATCH_DEFERRED;
+        }
+    }
+
+    pthread_mutex_lock(&job_mutex);
+    pid_t pgid = -1;
+    if (cached_fd >= 0) {
+        start_file_relay(job, cached_fd);
+    } else if (path) {
+        // The output cannot be captured; the last stage writes to the printer directly
+        job_slab[slot_of_job(job)].cache_fill_path = NULL;
+        pgid = start_conversion_pipeline(job, path, printer_fd);
+        if (printer_fd >= 0) {
+            close(printer_fd);  // The last stage holds its own copy
+        }
+    } else {
+        start_file_relay(job, open(job->input_file_path, O_RDONLY | O_CLOEXEC));
+    }
+    job->status = JOB_RUNNING;
+    job->status_changed_at = time(NULL);
+    mark_job_dispatched(job);
+    pthread_mutex_unlock(&job_mutex);
+
+    // Format command list for logging
+    char *cmds[64] = { NULL };
+    if (path && cached_fd < 0) {
+        for (int i = 0; path[i] && i < 63; i++) {
+            cmds[i] = path[i]->cmd_and_args[0];
+        }
+    } else {
+        cmds[0] = "cat";  // Passthrough or cached output, relayed by the spooler itself
+    }
+
+    emit_job_status(job->id, JOB_RUNNING);
+    mark_printer_busy(printer);
+    emit_job_started(job->id, printer->name, pgid, cmds);
+
+    if (!job_is_printing(job)) {
+        complete_job_pipeline(job);
+    }
+    return 0;
+}
+
+/**
+ * @brief Starts the copies of a fan-out print: one conversion, one or more printers.
+ *
+ * The first job leads: it runs the conversion pipeline, whose output is
+ * captured into an output cache file. Every job, the leader included, gets a
+ * growing relay from that file to its own printer. All jobs become JOB_RUNNING
+ * and their printers PRINTER_BUSY, exactly as if each had been dispatched on
+ * its own; only the leader reports a process group.
+ *
+ * @param jobs      The copies, not yet running, each with its target printer set.
+ * @param count     Number of copies (1 for an ordinary converted job).
+ * @param path      The conversion path shared by every copy.
+ * @param cache_key The output cache key of the converted output.
+ * @return 0 on success, -1 if the shared output file could not be set up.
+ */
+static int dispatch_fanout(JOB *jobs[], int count, CONVERSION *const *path, OUTPUT_CACHE_KEY cache_key) {
+    struct fanout_group *group = NULL;
+    for (int i = 0; i < MAX_FANOUT_GROUPS && !group; i++) {
+        if (!fanout_groups[i].in_use) {
+            group = &fanout_groups[i];
+        }
+    }
+    char *file_path = group ? output_cache_begin(cache_key, jobs[0]->id) : NULL;
+    if (!file_path) {
+        return -1;
+    }
+    int file_fd = open(file_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    int source_fd = (file_fd < 0) ? -1 : capture_start(&group->capture, file_fd, handle_fanout_progress, group);
+    if (source_fd < 0) {
+        output_cache_abandon(file_path);
+        return -1;
+    }
+
+    group->in_use = 1;
+    group->path = file_path;
+    group->cache_key = cache_key;
+    group->produced = 0;
+    group->capture_error = 0;
+    group->member_count = count;
+
+    pthread_mutex_lock(&job_mutex);
+    JOB *leader = jobs[0];
+    job_slab[slot_of_job(leader)].cache_fill_path = NULL;
+    pid_t pgid = start_conversion_pipeline(leader, path, source_fd);
+    close(source_fd);  // The last stage holds its own copy
+    job_slab[slot_of_job(leader)].fanout = group;
+
+    for (int i = 0; i < count; i++) {
+        struct job_slot *entry = &job_slab[slot_of_job(jobs[i])];
+        group->members[i] = get_job_handle(jobs[i]);
+        if (i > 0) {
+            entry->stage_count = entry->live_stages = 0;
+            entry->failed_stages = entry->abort_signal = 0;
+            entry->cache_fill_path = NULL;
+            jobs[i]->pgid = -1;
+        }
+        attach_relay(jobs[i], open(file_path, O_RDONLY | O_CLOEXEC), 1);
+        jobs[i]->status = JOB_RUNNING;
+        jobs[i]->status_changed_at = time(NULL);
+        mark_job_dispatched(jobs[i]);
+    }
+    pthread_mutex_unlock(&job_mutex);
+
+    char *cmds[64] = { NULL };
+    for (int i = 0; path[i] && i < 63; i++) {
+        cmds[i] = path[i]->cmd_and_args[0];
+    }
+    char *copy_cmds[] = { "cat", NULL };  // The other copies only relay the leader's output
+    for (int i = 0; i < count; i++) {
+        emit_job_status(jobs[i]->id, JOB_RUNNING);
+        mark_printer_busy(jobs[i]->target_printer);
+        emit_job_started(jobs[i]->id, jobs[i]->target_printer->name, (i == 0) ? pgid : -1, (i == 0) ? cmds : copy_cmds);
+    }
+
+    // Copies whose relay could not start end now; the leader waits for its pipeline too
+    for (int i = 0; i < count; i++) {
+        if (!job_is_printing(jobs[i])) {
+            complete_job_pipeline(jobs[i]);
+        }
+    }
+    if (job_slab[slot_of_job(leader)].live_stages == 0) {
+        settle_fanout_if_done(group);
+    }
+    return 0;
+}
+
+/**
+ * @brief Registers a new job in the slab and announces it with sf_job_created().
+ *
+ * @param file_path The file to print.
+ * @param from_type The file's type.
+ * @param printer   The printer the job is bound to, or NULL to let the scheduler choose.
+ * @return The new job, or NULL if the slab is full.
+ */
+static JOB *create_job(const char *file_path, FILE_TYPE *from_type, PRINTER *printer) {
+    pthread_mutex_lock(&job_mutex);
+    JOB *job = allocate_job();
+    if (!job) {
+        pthread_mutex_unlock(&job_mutex);
+        return NULL;
+    }
+    job->input_file_path = strdup(file_path);
+    job->file_type = from_type;
+    job->eligible_printers = printer ? (uint32_t)1 << get_printer_id(printer)
+                                     : get_eligible_printer_mask(from_type);
+    job->target_printer = printer;
+    job->created_at = time(NULL);
+    job->status_changed_at = job->created_at;
+    job->submitted_ns = latency_now_ns();
+    job->dispatched_ns = job->first_byte_ns = job->exited_ns = 0;
+    jobs_submitted++;
+    submitted_type_names[from_type->index] = from_type->name;
+    pthread_mutex_unlock(&job_mutex);
+
+    char trace_name[TRACE_NAME_MAX];
+    snprintf(trace_name, sizeof(trace_name), "job %d: %s", job->id, job->input_file_path);
+    trace_process_name(TRACE_JOB_PROCESS(job->id), trace_name);
+    emit_job_created(job->id, job->input_file_path, from_type->name);
+    return job;
+}
+
+/**
+ * @brief Puts a job whose dispatch was put off, because its printer could not
+ * be reached yet, on the ready queue.
+ *
+ * Its only eligible printer is the one it asked for, and dispatch_job() has
+ * already scheduled the retry that will dispatch it there.
+ */
+static void queue_deferred_job(JOB *job) {
+    pthread_mutex_lock(&job_mutex);
+    job->status = JOB_CREATED;
+    enqueue_ready_job(job);
+    pthread_mutex_unlock(&job_mutex);
+    emit_job_status(job->id, JOB_CREATED);
+}
+
+/**
+ * @brief Prints the summary line of a newly submitted job for CLI feedback.
+ */
+static void print_job_summary(const JOB *job) {
+    char created_str[64], status_str[64];
+    strftime(created_str, sizeof(created_str), "%d %b %H:%M:%S", localtime(&job->created_at));
+    strftime(status_str, sizeof(status_str), "%d %b %H:%M:%S", localtime(&job->status_changed_at));
+    printf("JOB[%d]: type=%s, creation(%s), status(%s)=%s, eligible=%08x, file=%s%s%s\n",
+       job->id, job->file_type->name, created_str, status_str,
+       job_status_names[job->status], job->eligible_printers, job->input_file_path,
+       job->target_printer ? ", printer=" : "",
+       job->target_printer ? job->target_printer->name : "");
+}
+
+/**
+ * @brief Submits a new print job to the spooler.
+ *
+ * This function registers a new job in the job spool. If a compatible printer is supplied,
+ * the job is launched immediately. Otherwise, the job is marked as JOB_CREATED and
+ * scheduled via try_scheduling_jobs().
+ *
+ * Responsibilities:
+ * - Validates the file path and job limit.
+ * - Infers the file type of the print file.
+ * - Verifies printer compatibility and availability if specified.
+ * - Registers job metadata in the spool.
+ * - Launches the job immediately or delegates to the scheduler.
+ * - Logs spooler events for job lifecycle tracking.
+ *
+ * @param file_path The path to the input file to be printed.
+ * @param printer   Pointer to a specific PRINTER if requested; NULL if the system should auto-assign.
+ * @return The new job's ID on success, or -1 on failure (invalid input, no printer, etc.)
+ */
+int submit_print_job(const char *file_path, PRINTER *printer) {
+    // Reject invalid file path or full spool
+    if (!file_path || job_count >= MAX_JOBS) {
+        return -1;
+    }
+
+    // Infer file type from file extension or name
+    FILE_TYPE *from_type = infer_file_type((char *)file_path);
+    if (!from_type || from_type->index < 0 || from_type->index >= MAX_FILE_TYPES) {
+        return -1;
+    }
+
+    // If a printer is provided, validate that it can accept this file type (or a conversion path exists)
+    if (printer) {
+        if (printer->status != PRINTER_IDLE) {
+            return -1;
+        }
+        if (printer->type != from_type && !lookup_conversion_path(from_type, printer->type)) {
+            return -1;
+        }
+    }
+
+    // Claim a slot in the slab; this also assigns the job its ID
+    JOB *job = create_job(file_path, from_type, printer);
+    if (!job) {
+        return -1;
+    }
+
+    // Journaled before it can run, so that a job terminating during dispatch records its end
+    struct job_slot *entry = &job_slab[slot_of_job(job)];
+    entry->journal_ticket = journal_record_job(file_path);
+
+    // Case 1: No printer specified — queue it and let the scheduler pick one
+    if (!printer) {
+        pthread_mutex_lock(&job_mutex);
+        job->status = JOB_CREATED;
+        enqueue_ready_job(job);
+        pthread_mutex_unlock(&job_mutex);
+        emit_job_status(job->id, JOB_CREATED);
+
+        try_scheduling_jobs();
+    }
+    // Case 2: Printer specified — launch immediately, or as soon as the printer can be reached
+    else {
+        int dispatched = dispatch_job(job, printer);
+        if (dispatched == DISPATCH_DEFERRED) {
+            queue_deferred_job(job);
+        } else if (dispatched != 0) {
+            journal_record_job_end(entry->journal_ticket);  // Never submitted after all
+            entry->journal_ticket = 0;
+            pthread_mutex_lock(&job_mutex);
+            cleanup_job(job);
+            release_job(job);
+            pthread_mutex_unlock(&job_mutex);
+            return -1;
+        }
+    }
+
+    // Print summary metadata for CLI feedback
+    print_job_summary(job);
+    return job->id;
+}
+
+/**
+ * @brief Submits one copy of a file for each of several printers.
  *
- * The master waits for all child stages to complete and exits with a status of 0
- * if all stages succeed, or 1 if any stage fails.
+ * Every printer must be idle, able to print the file, and of the same type as
+ * the others, so that one converted output serves them all. When a conversion
+ * is needed and its output is not cached yet, the copies share a single
+ * pipeline (see dispatch_fanout()); otherwise each copy is dispatched on its
+ * own, which then costs no conversion at all.
  *
- * @param job  Pointer to the JOB structure for which the pipeline is launched.
- * @param path A NULL-terminated array of CONVERSION pointers representing the
- *             conversion stages. If NULL, no conversion is needed.
- * @return The PID of the master pipeline process (to be stored as job->pgid), or -1 on failure.
+ * @param file_path The path to the input file to be printed.
+ * @param printers  The printers, without duplicates.
+ * @param count     Number of printers.
+ * @return 0 on success, or -1 on failure (in which case no job was created).
  */
-static pid_t start_conversion_pipeline(JOB *job, CONVERSION **path) {
-    if (!job) return -1;
-
-    int num_stages = 0;
-    if (path) {
-        while (path[num_stages]) {
-            num_stages++;
-        }
+int submit_print_copies(const char *file_path, PRINTER *printers[], int count) {
+    if (!file_path || count < 1 || count > MAX_PRINTERS || job_count + count > MAX_JOBS) {
+        return -1;
     }
-
-    pid_t master = fork();
-    if (master < 0) {
+    FILE_TYPE *from_type = infer_file_type((char *)file_path);
+    if (!from_type || from_type->index < 0 || from_type->index >= MAX_FILE_TYPES) {
         return -1;
     }
 
-    if (master == 0) {
-        // Child (master of the pipeline) — will launch all stages and wait on them
-        setpgid(0, 0);  // Establish a new process group for the pipeline
-
-        int prev_fd = -1;  // Used to hold read end of the previous pipe
-
-        for (int i = 0; i < num_stages || (num_stages == 0 && i == 0); i++) {
-            int pipefd[2];
-            int is_last = ((i == num_stages - 1) || (num_stages == 0));
-
-            if (!is_last && pipe(pipefd) < 0) {
-                exit(1);
-            }
-
-            pid_t stage = fork();
-            if (stage < 0) {
-                exit(1);
-            }
-
-            if (stage == 0) {
-                // Stage child process — runs one conversion stage
-                setpgid(0, 0);  // Join the pipeline's process group
-
-                // Handle input source
-                if (i == 0) {
-                    // First stage: read from the input file
-                    if (!job->input_file_path) exit(1);
-                    int fd = open(job->input_file_path, O_RDONLY);
-                    if (fd < 0) exit(1);
-                    dup2(fd, STDIN_FILENO);
-                    close(fd);
-                } else {
-                    // Intermediate or last: read from previous pipe
-                    dup2(prev_fd, STDIN_FILENO);
-                    close(prev_fd);
-                }
-
-                // Handle output sink
-                if (!is_last) {
-                    // Intermediate stage: write to next pipe
-                    close(pipefd[0]);
-                    dup2(pipefd[1], STDOUT_FILENO);
-                    close(pipefd[1]);
-                } else {
-                    // Last stage: connect to printer
-                    if (!job->target_printer ||
-                        !job->target_printer->name ||
-                        !job->target_printer->type ||
-                        !job->target_printer->type->name) {
-                        exit(1);
-                    }
-
-                    int fd = presi_connect_to_printer(job->target_printer->name,
-                                                      job->target_printer->type->name,
-                                                      PRINTER_NORMAL);
-                    if (fd < 0) exit(1);
-                    dup2(fd, STDOUT_FILENO);
-                    close(fd);
-                }
-
-                // Determine the executable and its arguments
-                char **args = NULL;
-                if (num_stages == 0) {
-                    // No conversion: use passthrough
-                    args = (char *[]) { "/bin/cat", NULL };
-                } else if (path && path[i] && path[i]->cmd_and_args) {
-                    args = path[i]->cmd_and_args;
-                } else {
-                    exit(1);  // Invalid stage
-                }
-
-                execvp(args[0], args);  // Execute stage command
-                exit(1);  // exec failed
-            }
+    uint32_t seen = 0;
+    for (int i = 0; i < count; i++) {
+        uint32_t bit = (uint32_t)1 << get_printer_id(printers[i]);
+        if (printers[i]->status != PRINTER_IDLE || printers[i]->type != printers[0]->type || (seen & bit)) {
+            return -1;
+        }
+        seen |= bit;
+    }
 
-            // Parent (master): prepare for next iteration
-            if (prev_fd != -1) {
-                close(prev_fd);
-            }
+    CONVERSION *const *path = NULL;
+    if (printers[0]->type != from_type) {
+        path = lookup_conversion_path(from_type, printers[0]->type);
+        if (!path) {
+            return -1;
+        }
+    }
 
-            if (!is_last) {
-                prev_fd = pipefd[0];  // Save read end for next stage
-                close(pipefd[1]);     // Parent closes write end
-            }
+    // Share the conversion only if there is one to run
+    OUTPUT_CACHE_KEY cache_key;
+    int shared = count > 1 && path && output_cache_key(file_path, path, &cache_key) == 0;
+    if (shared) {
+        int cached_fd = output_cache_open(cache_key);
+        if (cached_fd >= 0) {
+            close(cached_fd);
+            shared = 0;
         }
+    }
+
+    JOB *jobs[MAX_PRINTERS];
+    for (int i = 0; i < count; i++) {
+        jobs[i] = create_job(file_path, from_type, printers[i]);
+        job_slab[slot_of_job(jobs[i])].journal_ticket = journal_record_job(file_path);
+    }
 
-        // Master waits for all stages and checks for failures
-        int status, failed = 0;
-        while (wait(&status) > 0) {
-            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
-                failed = 1;
+    if (!shared || dispatch_fanout(jobs, count, path, cache_key) != 0) {
+        for (int i = 0; i < count; i++) {
+            if (dispatch_job(jobs[i], printers[i]) == DISPATCH_DEFERRED) {
+                queue_deferred_job(jobs[i]);  // The path was checked above, so only the connection can fail
             }
         }
-
-        exit(failed);
     }
 
-    // Parent (spooler) — return PID of master for tracking
-    return master;
+    for (int i = 0; i < count; i++) {
+        print_job_summary(jobs[i]);
+    }
+    return 0;
 }
 
-
 /**
- * @brief Initializes the job manager, resetting job_count.
+ * @brief Records the end of a split job once its last chunk has terminated.
  *
- * This should be called once at startup to ensure a clean state for the job list.
+ * The parent finishes with status 0 if every chunk printed successfully, and
+ * with status 1 otherwise. A parent that was canceled keeps JOB_ABORTED.
  */
-void job_manager_initialize(void) {
-    job_count = 0;
+static void finish_split_job(JOB *parent) {
+    struct job_slot *entry = &job_slab[slot_of_job(parent)];
+    if (parent->status == JOB_FINISHED || parent->status == JOB_ABORTED) {
+        return;
+    }
+
+    pthread_mutex_lock(&job_mutex);
+    parent->status = JOB_FINISHED;
+    parent->status_changed_at = time(NULL);
+    schedule_job_expiry(parent);
+    pthread_mutex_unlock(&job_mutex);
+
+    emit_job_status(parent->id, JOB_FINISHED);
+    emit_job_finished(parent->id, (entry->failed_chunks ? 1 : 0) << 8);
 }
 
 /**
- * @brief Helper function to release resources allocated to a job.
+ * @brief Tells the parent of a chunk that the chunk has terminated.
  *
- * Frees the input_file_path and resets the job fields to defaults,
- * preparing the slot for reuse or permanent removal.
- *
- * @param job Pointer to the JOB structure to be cleaned.
+ * @param chunk     A chunk that has just become JOB_FINISHED or JOB_ABORTED.
+ * @param succeeded Nonzero if it finished with status 0.
  */
-static void cleanup_job(JOB *job) {
-    if (!job) return;
-    free(job->input_file_path);
-    job->input_file_path = NULL;
-    job->target_printer = NULL;
-    job->status = JOB_DELETED;
-    job->pgid = -1;
-    job->created_at = 0;
-    job->status_changed_at = 0;
+static void report_chunk_outcome(JOB *chunk, int succeeded) {
+    JOB *parent = get_job_by_handle(job_slab[slot_of_job(chunk)].split_parent);
+    if (!parent) {
+        return;
+    }
+    struct job_slot *entry = &job_slab[slot_of_job(parent)];
+    if (!succeeded) {
+        entry->failed_chunks++;
+    }
+    if (--entry->pending_chunks == 0) {
+        finish_split_job(parent);
+    }
 }
 
 /**
- * @brief Cleans up all tracked jobs, releasing memory.
+ * @brief Returns the next live chunk of a split job after the given job, or
+ * NULL once the live list is exhausted.
  *
- * Iterates through the job list and cleans every entry using cleanup_job().
- * Resets job_count to zero.
+ * @param parent The parent of the split job.
+ * @param after  The chunk to continue from, or NULL to start at the oldest job.
  */
-void job_manager_cleanup(void) {
-    for (int i = 0; i < job_count; i++) {
-        cleanup_job(&job_spool[i]);
+static JOB *next_chunk(const JOB *parent, const JOB *after) {
+    JOB_HANDLE handle = get_job_handle(parent);
+    for (JOB *job = after ? get_next_job(after) : get_first_job(); job; job = get_next_job(job)) {
+        struct job_slot *entry = &job_slab[slot_of_job(job)];
+        if (entry->is_chunk && entry->split_parent == handle) {
+            return job;
+        }
     }
-    job_count = 0;
+    return NULL;
 }
 
-
-
-
 /**
- * @brief Submits a new print job to the spooler.
+ * @brief Submits a file to be printed in chunks on several idle printers at once.
  *
- * This function registers a new job in the job spool. If a compatible printer is supplied,
- * the job is launched immediately. Otherwise, the job is marked as JOB_CREATED and
- * scheduled via try_scheduling_jobs().
+ * The file is cut at page boundaries (or at record boundaries, when it has no
+ * pages) into as many chunks as there are idle printers able to print it, and
+ * every chunk becomes a job of its own, dispatched straight to one of those
+ * printers. A parent job, created first, stands for the whole document: it is
+ * JOB_RUNNING while any chunk is printing and finishes when the last chunk
+ * terminates. Canceling, pausing or resuming the parent applies to every chunk.
  *
- * Responsibilities:
- * - Validates the file path and job limit.
- * - Infers the file type of the print file.
- * - Verifies printer compatibility and availability if specified.
- * - Registers job metadata in the spool.
- * - Launches the job immediately or delegates to the scheduler.
- * - Logs spooler events for job lifecycle tracking.
+ * A file that cannot be split, or fewer than two idle printers, make this an
+ * ordinary submission of the parent job, as with submit_print_job().
  *
  * @param file_path The path to the input file to be printed.
- * @param printer   Pointer to a specific PRINTER if requested; NULL if the system should auto-assign.
- * @return 0 on success, or -1 on failure (invalid input, no printer, etc.)
+ * @return 0 on success, or -1 on failure (invalid input, full spool).
  */
-int submit_print_job(const char *file_path, PRINTER *printer) {
-    // Reject invalid file path or full spool
+int submit_split_job(const char *file_path) {
     if (!file_path || job_count >= MAX_JOBS) {
         return -1;
     }
-
-    // Infer file type from file extension or name
     FILE_TYPE *from_type = infer_file_type((char *)file_path);
-    if (!from_type) {
+    if (!from_type || from_type->index < 0 || from_type->index >= MAX_FILE_TYPES) {
         return -1;
     }
 
-    // If a printer is provided, validate that it can accept this file type (or a conversion path exists)
-    if (printer) {
-        if (printer->status != PRINTER_IDLE) {
-            return -1;
-        }
-        if (printer->type != from_type) {
-            CONVERSION **path = find_conversion_path(from_type->name, printer->type->name);
-            if (!path) {
-                return -1;
-            }
-            free(path);
-        }
+    JOB *parent = create_job(file_path, from_type, NULL);
+    if (!parent) {
+        return -1;
     }
 
-    // Initialize and store job metadata in the global spool
-    pthread_mutex_lock(&job_mutex);
-    JOB *job = &job_spool[job_count];
-    job->id = job_count;
-    job->input_file_path = strdup(file_path);
-    job->target_printer = printer;
-    job->pgid = -1;
-    job->created_at = time(NULL);
-    job->status_changed_at = job->created_at;
-    pthread_mutex_unlock(&job_mutex);
+    // Only the parent is journaled: after a restart the whole file is printed again as one job
+    job_slab[slot_of_job(parent)].journal_ticket = journal_record_job(file_path);
 
-    sf_job_created(job->id, job->input_file_path, from_type->name);
+    // One chunk per idle printer, as long as the slab can hold them all
+    uint32_t usable = parent->eligible_printers & get_idle_printer_mask();
+    int max_chunks = __builtin_popcount(usable);
+    if (max_chunks > MAX_JOBS - job_count) {
+        max_chunks = MAX_JOBS - job_count;
+    }
+    char *chunk_paths[MAX_PRINTERS];
+    int chunk_count = (max_chunks >= 2) ? split_file(file_path, max_chunks, parent->id, chunk_paths) : 0;
 
-    // Case 1: No printer specified — defer to scheduler
-    if (!printer) {
+    if (chunk_count < 2) {
         pthread_mutex_lock(&job_mutex);
-        job->status = JOB_CREATED;
+        parent->status = JOB_CREATED;
+        enqueue_ready_job(parent);
         pthread_mutex_unlock(&job_mutex);
-        sf_job_status(job->id, JOB_CREATED);
+        emit_job_status(parent->id, JOB_CREATED);
 
-        job_count++;  // Important: count must be updated before scheduling
         try_scheduling_jobs();
+        print_job_summary(parent);
+        return 0;
     }
-    // Case 2: Printer specified — launch immediately
-    else {
-        CONVERSION **path = find_conversion_path(from_type->name, printer->type->name);
-        pid_t pid = start_conversion_pipeline(job, path);
-        if (pid < 0) {
-            if (path) free(path);
-            return -1;
-        }
 
-        pthread_mutex_lock(&job_mutex);
-        job->status = JOB_RUNNING;
-        job->pgid = pid;
-        job->status_changed_at = time(NULL);
-        printer->status = PRINTER_BUSY;
-        pthread_mutex_unlock(&job_mutex);
+    struct job_slot *parent_entry = &job_slab[slot_of_job(parent)];
+    pthread_mutex_lock(&job_mutex);
+    parent_entry->split_chunks = parent_entry->pending_chunks = chunk_count;
+    parent->status = JOB_RUNNING;
+    parent->status_changed_at = time(NULL);
+    mark_job_dispatched(parent);
+    pthread_mutex_unlock(&job_mutex);
+    emit_job_status(parent->id, JOB_RUNNING);
+    print_job_summary(parent);
+
+    for (int i = 0; i < chunk_count; i++) {
+        PRINTER *printer = get_printer_by_index(ffs((int)usable) - 1);
+        usable &= usable - 1;
+
+        JOB *chunk = create_job(chunk_paths[i], from_type, printer);
+        struct job_slot *entry = &job_slab[slot_of_job(chunk)];
+        entry->is_chunk = 1;
+        entry->split_parent = get_job_handle(parent);
+
+        int dispatched = dispatch_job(chunk, printer);
+        if (dispatched == DISPATCH_DEFERRED) {
+            // Dispatched by the retry, which counts it when it terminates; its file must last until then
+            entry->owns_input_file = 1;
+            queue_deferred_job(chunk);
+            free(chunk_paths[i]);
+            chunk_paths[i] = NULL;
+            print_job_summary(chunk);
+            continue;
+        }
+        // A started chunk has opened its file through its pipeline or relay, so the file can go now
+        discard_chunk_files(&chunk_paths[i], 1);
+        if (dispatched != 0) {
+            pthread_mutex_lock(&job_mutex);
+            cleanup_job(chunk);
+            release_job(chunk);
+            pthread_mutex_unlock(&job_mutex);
+            parent_entry->failed_chunks++;
+            if (--parent_entry->pending_chunks == 0) {
+                finish_split_job(parent);
+            }
+            continue;
+        }
+        print_job_summary(chunk);
+    }
+    return 0;
+}
 
-        // Format command list for logging
-        char *cmds[64] = { NULL };
-        if (path) {
-            for (int i = 0; path[i]; i++)
-                cmds[i] = path[i]->cmd_and_args[0];
-            free(path);
-        } else {
-            cmds[0] = "cat";  // Passthrough fallback
+/**
+ * @brief Returns the file type a waiting job will be converted to, if that is
+ * already certain: every printer eligible for it has the same type, and it is
+ * not the job's own type.
+ */
+static FILE_TYPE *certain_target_type(const JOB *job) {
+    FILE_TYPE *target = NULL;
+    for (uint32_t printers = job->eligible_printers; printers; printers &= printers - 1) {
+        PRINTER *printer = get_printer_by_index(ffs((int)printers) - 1);
+        if (!printer || (target && printer->type != target)) {
+            return NULL;
         }
+        target = printer->type;
+    }
+    return (target == job->file_type) ? NULL : target;
+}
 
-        sf_job_status(job->id, JOB_RUNNING);
-        sf_printer_status(printer->name, PRINTER_BUSY);
-        sf_job_started(job->id, printer->name, pid, cmds);
+/**
+ * @brief Converts a waiting job's file into the output cache ahead of time.
+ *
+ * The pipeline is the one dispatch_job() would run, but its last stage writes
+ * straight into a new output cache file. If the output is complete by the time
+ * a printer frees up, dispatching the job only sends the cached bytes. Jobs
+ * whose target type is not yet certain, or whose output is already cached, are
+ * left alone. The job stays JOB_CREATED throughout.
+ */
+static void start_preconversion(JOB *job) {
+    struct job_slot *entry = &job_slab[slot_of_job(job)];
+    entry->preconversion = PRECONVERSION_DONE;  // Attempted at most once
+    remove_preconversion_candidate(slot_of_job(job));
+
+    FILE_TYPE *target = certain_target_type(job);
+    CONVERSION *const *path = target ? lookup_conversion_path(job->file_type, target) : NULL;
+    OUTPUT_CACHE_KEY cache_key;
+    if (!path || output_cache_key(job->input_file_path, path, &cache_key) < 0) {
+        return;
+    }
 
-        job_count++;  // Must update count for directly launched jobs too
+    int cached_fd = output_cache_open(cache_key);
+    if (cached_fd >= 0) {
+        close(cached_fd);  // Nothing to do
+        return;
     }
 
-    // Print summary metadata for CLI feedback
-    char created_str[64], status_str[64];
-    strftime(created_str, sizeof(created_str), "%d %b %H:%M:%S", localtime(&job->created_at));
-    strftime(status_str, sizeof(status_str), "%d %b %H:%M:%S", localtime(&job->status_changed_at));
-printf("JOB[%d]: type=%s, creation(%s), status(%s)=%s, eligible=ffffffff, file=%s%s%s\n",
-       job->id, from_type->name, created_str, status_str,
-       job_status_names[job->status], job->input_file_path,
-       job->target_printer ? ", printer=" : "",
-       job->target_printer ? job->target_printer->name : "");
+    entry->cache_key = cache_key;
+    entry->cache_fill_path = output_cache_begin(cache_key, job->id);
+    if (!entry->cache_fill_path) {
+        return;
+    }
+    int output_fd = open(entry->cache_fill_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (output_fd < 0) {
+        output_cache_abandon(entry->cache_fill_path);
+        entry->cache_fill_path = NULL;
+        return;
+    }
+
+    pthread_mutex_lock(&job_mutex);
+    start_conversion_pipeline(job, path, output_fd);
+    pthread_mutex_unlock(&job_mutex);
+    close(output_fd);  // The last stage holds its own copy
 
+    if (entry->live_stages == 0) {
+        settle_output_cache(job, 0);
+        return;
+    }
+    entry->preconversion = PRECONVERSION_RUNNING;
+    running_preconversions++;
+}
 
-    return 0;
+/**
+ * @brief Starts ahead-of-time conversions for the oldest waiting jobs, up to
+ * MAX_PRECONVERSIONS at once.
+ *
+ * Every attempt takes its job off the candidate list, so the cost is
+ * proportional to the number of attempts, not to the number of jobs waiting.
+ */
+static void start_preconversions(void) {
+    while (candidate_head != NO_SLOT && running_preconversions < MAX_PRECONVERSIONS) {
+        start_preconversion(&job_slab[candidate_head].job);
+    }
 }
 
 /**
  * @brief Attempts to schedule jobs in the CREATED state to compatible idle printers.
  *
- * This function iterates through all jobs currently in the CREATED state. For each one,
- * it checks for an available IDLE printer that can either:
- *   - Directly handle the job's file type, or
- *   - Accept the file type via a valid conversion path
+ * Waiting jobs sit in one FIFO per file type, so only the head of each
+ * non-empty queue is considered. A head can run on any printer in
+ * `eligible_printers & idle mask`; the lowest such printer is found with ffs().
+ * On every round the oldest head that has a compatible idle printer is dispatched, which preserves submission order
+ * across types just like a scan of the whole job list would. A queue whose
+ * head cannot be placed is skipped for the rest of the pass: dispatching
+ * another job only ever makes printers busy, never idle.
  *
- * If a compatible printer is found, the job is launched via a conversion pipeline,
- * updated to JOB_RUNNING, and the printer is marked BUSY. The job's process group ID (PGID)
- * is tracked for signal control.
+ * The cost of a pass is therefore proportional to the number of file types
+ * with waiting jobs and the number of jobs actually started, independent of
+ * how many jobs are queued.
  */
 void try_scheduling_jobs(void) {
-    for (int i = 0; i < get_job_count(); i++) {
-        JOB *job = get_job_by_index(i);
-        if (!job || job->status != JOB_CREATED) {
-            continue; // Skip if null or not in a schedulable state
-        }
+    uint64_t pass_start_ns = latency_now_ns();
+    uint64_t candidates = types_with_ready_jobs;
 
-        FILE_TYPE *from_type = infer_file_type(job->input_file_path);
-        if (!from_type) {
-            continue; // Skip if file type can't be determined
-        }
+    while (candidates) {
+        JOB *oldest = NULL;
+        PRINTER *oldest_printer = NULL;
 
-        PRINTER *printer = select_compatible_printer(from_type);
-        if (!printer) {
-            continue; // No compatible printer available
-        }
+        for (uint64_t types = candidates; types; types &= types - 1) {
+            int type_index = ffsll((long long)types) - 1;
+            int slot = ready_head[type_index];
 
-        pthread_mutex_lock(&job_mutex);
-        job->target_printer = printer;
-
-        // Case: Direct passthrough (same file type as printer)
-        if (strcmp(from_type->name, printer->type->name) == 0) {
-            pid_t pid = start_conversion_pipeline(job, NULL);
-            if (pid < 0) {
-                job->target_printer = NULL;
-                pthread_mutex_unlock(&job_mutex);
-                continue;
+            if (oldest && job_slab[slot].sequence > job_slab[slot_of_job(oldest)].sequence) {
+                continue; // Cannot beat the current choice; look at it next round
             }
 
-            job->pgid = pid;
-            job->status = JOB_RUNNING;
-            job->status_changed_at = time(NULL);
-            printer->status = PRINTER_BUSY;
-            pthread_mutex_unlock(&job_mutex);
-
-            char *cmds[2] = { "cat", NULL };
-            sf_job_status(job->id, JOB_RUNNING);
-            sf_printer_status(printer->name, PRINTER_BUSY);
-            sf_job_started(job->id, printer->name, pid, cmds);
-            continue;
+            uint32_t usable = job_slab[slot].job.eligible_printers & get_idle_printer_mask();
+            if (!usable) {
+                candidates &= ~((uint64_t)1 << type_index); // No printer for this type
+                continue;
+            }
+            oldest = &job_slab[slot].job;
+            oldest_printer = get_printer_by_index(ffs((int)usable) - 1);
         }
 
-        // Case: Conversion path needed
-        CONVERSION **path = find_conversion_path(from_type->name, printer->type->name);
-        if (!path) {
-            job->target_printer = NULL;
-            pthread_mutex_unlock(&job_mutex);
-            continue;
+        if (!oldest) {
+            break;
         }
 
-        pid_t pid = start_conversion_pipeline(job, path);
-        if (pid < 0) {
-            job->target_printer = NULL;
-            pthread_mutex_unlock(&job_mutex);
-            free(path);
+        if (dispatch_job(oldest, oldest_printer) != 0) {
+            candidates &= ~((uint64_t)1 << oldest->file_type->index);
             continue;
         }
 
-        job->pgid = pid;
-        job->status = JOB_RUNNING;
-        job->status_changed_at = time(NULL);
-        printer->status = PRINTER_BUSY;
+        struct job_slot *entry = &job_slab[slot_of_job(oldest)];
+        if (entry->owns_input_file) {
+            unlink(oldest->input_file_path);  // A chunk whose dispatch was put off has now opened it
+            entry->owns_input_file = 0;
+        }
+        pthread_mutex_lock(&job_mutex);
+        remove_ready_job(oldest);
         pthread_mutex_unlock(&job_mutex);
+        candidates &= types_with_ready_jobs;
+    }
 
-        char *cmds[64] = { NULL };
-        for (int j = 0; path[j]; j++) {
-            cmds[j] = path[j]->cmd_and_args[0];
-        }
-        free(path);
+    start_preconversions();
+    trace_span(TRACE_SCHEDULER_PROCESS, 0, "try_scheduling_jobs", pass_start_ns, latency_now_ns());
+}
 
-        sf_job_status(job->id, JOB_RUNNING);
-        sf_printer_status(printer->name, PRINTER_BUSY);
-        sf_job_started(job->id, printer->name, pid, cmds);
+/**
+ * @brief Recomputes the eligibility masks of all waiting jobs and tries to
+ * schedule them.
+ *
+ * Called after a printer is added or a conversion is defined, since either can
+ * change which printers a job may use (and a new conversion can make a waiting
+ * job runnable on a printer that is already idle). Jobs whose ahead-of-time
+ * conversion was skipped get another chance, as their target type may now be
+ * certain.
+ */
+void refresh_job_eligibility(void) {
+    for (uint64_t types = types_with_ready_jobs; types; types &= types - 1) {
+        int type_index = ffsll((long long)types) - 1;
+        for (int slot = ready_head[type_index]; slot != NO_SLOT; slot = job_slab[slot].ready_next) {
+            job_slab[slot].job.eligible_printers = get_eligible_printer_mask(job_slab[slot].job.file_type);
+            if (job_slab[slot].preconversion == PRECONVERSION_DONE) {
+                job_slab[slot].preconversion = PRECONVERSION_NONE;  // The target type may be certain now
+                add_preconversion_candidate(slot);
+            }
+        }
     }
+    try_scheduling_jobs();
 }
 
+/**
+ * @brief Records a stop or continue of a job's pipeline.
+ *
+ * Every stage reports its own stop and continue (through SIGCHLD); the first
+ * stop moves the job to JOB_PAUSED and the first continue back to JOB_RUNNING,
+ * so the job changes state once per pause or resume. Exits are handled through
+ * the stages' pidfds instead. Reports for jobs that have already terminated (for
+ * example a pipeline that is still dying after `cancel`) are ignored.
+ *
+ * @param job  The job whose pipeline changed state.
+ * @param info The report filled in by waitid().
+ */
+void update_job_from_child_event(JOB *job, const siginfo_t *info) {
+    if (!job) {
+        return;
+    }
 
+    if ((info->si_code == CLD_STOPPED || info->si_code == CLD_TRAPPED) && job->status == JOB_RUNNING) {
+        job->status = JOB_PAUSED;
+        emit_job_status(job->id, JOB_PAUSED);
+    } else if (info->si_code == CLD_CONTINUED && job->status == JOB_PAUSED) {
+        job->status = JOB_RUNNING;
+        emit_job_status(job->id, JOB_RUNNING);
+    }
+}
 
 /**
- * @brief Removes jobs that have been finished or aborted for at least 10 seconds.
+ * @brief Looks up a live job by its ID through the ID hash.
  *
- * Finished (JOB_FINISHED) or aborted (JOB_ABORTED) jobs remain visible for
- * 10 seconds after completion, to allow users to inspect their statuses. Once
- * 10 seconds elapse, the jobs are cleaned and removed from the spool, freeing
- * up their slots for new jobs.
- */
-void delete_expired_jobs_if_needed(void) {
-    time_t now = time(NULL);
-    for (int i = 0; i < job_count; i++) {
-        JOB *job = &job_spool[i];
-        if ((job->status == JOB_FINISHED || job->status == JOB_ABORTED) &&
-            difftime(now, job->status_changed_at) >= 10.0) {
-            sf_job_deleted(job->id);
-            cleanup_job(job);
+ * @param job_id The ID reported when the job was created.
+ * @return A pointer to the JOB, or NULL if no live job has that ID.
+ */
+JOB *get_job_by_id(int job_id) {
+    int slot = find_slot(job_id_table, job_id_key, job_id);
+    return (slot == NO_SLOT) ? NULL : &job_slab[slot].job;
+}
 
-            /* Compact the array after removing the job. */
-            for (int j = i + 1; j < job_count; j++) {
-                job_spool[j - 1] = job_spool[j];
-            }
-            job_count--;
-            i--;
+/**
+ * @brief Counts the live jobs by status and the ready queues by length, and
+ * copies the counters.
+ */
+void job_manager_get_metrics(JOB_METRICS *metrics) {
+    memset(metrics, 0, sizeof(*metrics));
+    metrics->jobs_submitted = jobs_submitted;
+    metrics->pipelines_launched = pipelines_launched;
+    metrics->spawn_failures = spawn_failures;
+
+    for (int slot = live_head; slot != NO_SLOT; slot = job_slab[slot].next) {
+        JOB_STATUS status = job_slab[slot].job.status;
+        if (status >= JOB_CREATED && status <= JOB_DELETED) {
+            metrics->jobs_by_status[status]++;
+        }
+    }
+    for (int type = 0; type < MAX_FILE_TYPES; type++) {
+        metrics->type_names[type] = submitted_type_names[type];
+        for (int slot = ready_head[type]; slot != NO_SLOT; slot = job_slab[slot].ready_next) {
+            metrics->queue_depth[type]++;
         }
     }
+
+    metrics->reap_count = reap_latency.count;
+    metrics->reap_sum_ns = reap_latency.sum;
+    metrics->reap_p50_ns = latency_percentile(&reap_latency, 0.50);
+    metrics->reap_p99_ns = latency_percentile(&reap_latency, 0.99);
+    metrics->reap_max_ns = reap_latency.max;
+}
+
+/**
+ * @brief Returns the handle of a live job: its slot in the low 32 bits and the
+ * slot's generation in the high 32 bits.
+ */
+JOB_HANDLE get_job_handle(const JOB *job) {
+    int slot = slot_of_job(job);
+    return ((JOB_HANDLE)job_slab[slot].generation << 32) | (uint32_t)slot;
 }
 
 /**
- * @brief Retrieves a pointer to a job by its index in job_spool.
+ * @brief Resolves a handle obtained from get_job_handle().
  *
- * @param index Zero-based index of the desired job.
- * @return A pointer to the JOB, or NULL if the index is invalid.
+ * @return The job, or NULL if the slot has since been released (and possibly reused).
  */
-JOB *get_job_by_index(int index) {
-    if (index < 0 || index >= job_count) {
+JOB *get_job_by_handle(JOB_HANDLE handle) {
+    uint32_t slot = (uint32_t)handle;
+    if (slot >= MAX_JOBS || !job_slab[slot].in_use ||
+        job_slab[slot].generation != (uint32_t)(handle >> 32)) {
         return NULL;
     }
-    return &job_spool[index];
+    return &job_slab[slot].job;
+}
+
+/**
+ * @brief Returns the oldest live job, or NULL if there are none.
+ */
+JOB *get_first_job(void) {
+    return (live_head == NO_SLOT) ? NULL : &job_slab[live_head].job;
+}
+
+/**
+ * @brief Returns the job created after the given one, or NULL at the end of the list.
+ */
+JOB *get_next_job(const JOB *job) {
+    int next = job_slab[slot_of_job(job)].next;
+    return (next == NO_SLOT) ? NULL : &job_slab[next].job;
+}
+
+/**
+ * @brief Finds the job whose pipeline runs in the given process group.
+ *
+ * @param pgid Process group ID of a stage reported by waitid().
+ * @return The matching JOB, or NULL if no live job has unreaped processes in that group.
+ */
+JOB *get_job_by_pgid(pid_t pgid) {
+    int slot = find_slot(job_pid_table, job_pid_key, pgid);
+    return (slot == NO_SLOT) ? NULL : &job_slab[slot].job;
 }
 
 /**
  * @brief Returns the current number of active jobs.
  *
- * @return The total count of jobs stored in job_spool.
+ * @return The total count of jobs stored in the slab.
  */
 int get_job_count(void) {
     return job_count;
@@ -477,27 +2073,36 @@ int get_job_count(void) {
  *
  * If the job is RUNNING or PAUSED, its pipeline is signaled to end (SIGTERM,
  * with a SIGCONT if paused). The job and printer states are updated, and spooler
- * event functions are called to record the change.
+ * event functions are called to record the change. Canceling the parent of a
+ * split job cancels each of its chunks that is still printing.
  *
  * @param job_id Numeric ID of the job to cancel.
  * @return 0 on success, -1 if the job cannot be canceled (invalid ID or wrong state).
  */
 int cancel_job(int job_id) {
-    if (job_id < 0 || job_id >= job_count) {
+    JOB *job = get_job_by_id(job_id);
+    if (!job) {
         return -1;
     }
 
-    JOB *job = &job_spool[job_id];
-
     /* If the job has not started running yet, simply mark it as aborted. */
     if (job->status == JOB_CREATED) {
+        if (job_slab[slot_of_job(job)].preconversion == PRECONVERSION_RUNNING) {
+            reap_job_pipeline_now(job);
+        }
+
         pthread_mutex_lock(&job_mutex);
         job->status = JOB_ABORTED;
         job->status_changed_at = time(NULL);
+        remove_ready_job(job);
+        schedule_job_expiry(job);
         pthread_mutex_unlock(&job_mutex);
 
-        sf_job_status(job->id, JOB_ABORTED);
-        sf_job_aborted(job->id, 0);
+        emit_job_status(job->id, JOB_ABORTED);
+        emit_job_aborted(job->id, 0);
+        if (job_slab[slot_of_job(job)].is_chunk) {
+            report_chunk_outcome(job, 0);  // A chunk whose dispatch was put off
+        }
         return 0;
     }
 
@@ -506,21 +2111,93 @@ int cancel_job(int job_id) {
         return -1;
     }
 
-    /* If paused, ensure the pipeline is continued so it can receive SIGTERM. */
-    if (job->status == JOB_PAUSED) {
-        killpg(job->pgid, SIGCONT);
+    /* The parent of a split job is aborted first, so that its chunks' ends are not counted. */
+    struct job_slot *entry = &job_slab[slot_of_job(job)];
+    if (entry->split_chunks) {
+        pthread_mutex_lock(&job_mutex);
+        job->status = JOB_ABORTED;
+        job->status_changed_at = time(NULL);
+        schedule_job_expiry(job);
+        pthread_mutex_unlock(&job_mutex);
+
+        emit_job_status(job->id, JOB_ABORTED);
+        emit_job_aborted(job->id, 0);
+        for (JOB *chunk = next_chunk(job, NULL); chunk; chunk = next_chunk(job, chunk)) {
+            cancel_job(chunk->id);
+        }
+        return 0;
+    }
+
+    /* A fan-out leader has both; stopping its pipeline ends the conversion for every copy. */
+    relay_cancel(&entry->relay);
+    timer_wheel_cancel(&entry->reconnect_timer);
+    if (entry->live_stages > 0) {
+        /* If paused, ensure the pipeline is continued so it can receive SIGTERM. */
+        if (job->status == JOB_PAUSED) {
+            signal_job_pipeline(job, SIGCONT);
+        }
+        signal_job_pipeline(job, SIGTERM);
     }
-    killpg(job->pgid, SIGTERM);
 
     pthread_mutex_lock(&job_mutex);
     job->status = JOB_ABORTED;
     job->status_changed_at = time(NULL);
-    job->target_printer->status = PRINTER_IDLE;
+    schedule_job_expiry(job);
+    pthread_mutex_unlock(&job_mutex);
+
+    emit_job_status(job->id, JOB_ABORTED);
+    release_printer(job->target_printer);
+    emit_job_aborted(job->id, 0);
+    if (entry->is_chunk) {
+        report_chunk_outcome(job, 0);
+    }
+    return 0;
+}
+
+/**
+ * @brief Pauses or resumes the relay of a job and records the new status.
+ *
+ * No child process is stopped or continued, so there is no report to wait
+ * for; the transition is applied and announced here.
+ */
+static int set_relay_job_paused(JOB *job, int paused) {
+    RELAY *relay = &job_slab[slot_of_job(job)].relay;
+    if ((paused ? relay_pause(relay) : relay_resume(relay)) < 0) {
+        return -1;
+    }
+
+    JOB_STATUS status = paused ? JOB_PAUSED : JOB_RUNNING;
+    pthread_mutex_lock(&job_mutex);
+    job->status = status;
+    job->status_changed_at = time(NULL);
+    pthread_mutex_unlock(&job_mutex);
+
+    emit_job_status(job->id, status);
+    return 0;
+}
+
+/**
+ * @brief Pauses or resumes every chunk of a split job and records the parent's new status.
+ *
+ * Chunks that have already terminated, or are already in the requested state,
+ * are left alone.
+ */
+static int set_split_job_paused(JOB *parent, int paused) {
+    for (JOB *chunk = next_chunk(parent, NULL); chunk; chunk = next_chunk(parent, chunk)) {
+        if (paused && chunk->status == JOB_RUNNING) {
+            pause_job(chunk->id);
+        } else if (!paused && chunk->status == JOB_PAUSED) {
+            resume_job(chunk->id);
+        }
+    }
+
+    JOB_STATUS status = paused ? JOB_PAUSED : JOB_RUNNING;
+    pthread_mutex_lock(&job_mutex);
+    parent->status = status;
+    parent->status_changed_at = time(NULL);
     pthread_mutex_unlock(&job_mutex);
 
-    sf_job_status(job->id, JOB_ABORTED);
-    sf_printer_status(job->target_printer->name, PRINTER_IDLE);
-    sf_job_aborted(job->id, 0);
+    emit_job_status(parent->id, status);
     return 0;
 }
 
@@ -532,23 +2209,34 @@ int cancel_job(int job_id) {
  * by the SIGCHLD handler when the OS confirms the job was stopped.
  *
  * This ensures that state changes only happen in response to actual system events,
- * preserving accurate tracking of job lifecycle transitions.
+ * preserving accurate tracking of job lifecycle transitions. A job printed
+ * through a relay (a passthrough job, or a conversion whose output is captured)
+ * is paused at its relay instead, leaving any conversion to run ahead into its
+ * output file; it becomes JOB_PAUSED right away, as does the parent of a split
+ * job, whose chunks are paused.
  *
  * @param job_id The numeric ID of the job to pause.
- * @return 0 on suc cess, -1 on failure (invalid ID or wrong job state).
+ * @return 0 on success, -1 on failure (invalid ID or wrong job state).
  */
 int pause_job(int job_id) {
-    if (job_id < 0 || job_id >= job_count) {
+    JOB *job = get_job_by_id(job_id);
+    if (!job) {
         return -1;  // Invalid job ID
     }
-
-    JOB *job = &job_spool[job_id];
     if (job->status != JOB_RUNNING) {
         return -1;  // Can only pause a job that is actively running
     }
 
+    if (job_slab[slot_of_job(job)].split_chunks) {
+        return set_split_job_paused(job, 1);
+    }
+
+    if (relay_is_active(&job_slab[slot_of_job(job)].relay)) {
+        return set_relay_job_paused(job, 1);
+    }
+
     // Send SIGSTOP to the job's entire pipeline (process group)
-    return killpg(job->pgid, SIGSTOP);
+    return signal_job_pipeline(job, SIGSTOP);
 }
 
 
@@ -560,20 +2248,29 @@ int pause_job(int job_id) {
  * the status back to JOB_RUNNING.
  *
  * This model ensures job state transitions only occur in response to real OS signals.
+ * A job paused at its relay is resumed and marked JOB_RUNNING directly,
+ * and so is the parent of a split job, after its chunks are resumed.
  *
  * @param job_id The numeric ID of the job to resume.
  * @return 0 on success, -1 on failure (invalid ID or job not paused).
  */
 int resume_job(int job_id) {
-    if (job_id < 0 || job_id >= job_count) {
+    JOB *job = get_job_by_id(job_id);
+    if (!job) {
         return -1;  // Invalid job ID
     }
-
-    JOB *job = &job_spool[job_id];
     if (job->status != JOB_PAUSED) {
         return -1;  // Can only resume a paused job
     }
 
+    if (job_slab[slot_of_job(job)].split_chunks) {
+        return set_split_job_paused(job, 0);
+    }
+
+    if (relay_is_active(&job_slab[slot_of_job(job)].relay)) {
+        return set_relay_job_paused(job, 0);
+    }
+
     // Send SIGCONT to the job's process group to resume execution
-    return killpg(job->pgid, SIGCONT);
+    return signal_job_pipeline(job, SIGCONT);
 }
@@ -0,0 +1,481 @@
+/**
+ * @file journal.c
+ * @brief Implements the write-ahead journal, its group commit and its snapshots.
+ *
+ * The journal keeps a compact copy of the state it describes: the
+ * configuration commands in the order they were given, whether each printer
+ * is enabled, and the jobs that have not terminated. Each line is applied to
+ * that copy as it is appended (or read back at recovery), so a snapshot is
+ * simply this copy written out, and never requires asking the other modules.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "journal.h"
+#include "debug.h"
+#include "presi.h"
+#include "timer_wheel.h"
+
+/** @brief Length of the path of a journal file. */
+#define JOURNAL_PATH_MAX 64
+
+/**
+ * @struct text_buffer
+ * @brief A growable run of text lines.
+ */
+struct text_buffer {
+    char *data;       ///< The text, not NUL-terminated.
+    size_t length;    ///< Bytes of text.
+    size_t capacity;  ///< Allocated size of data.
+};
+
+/**
+ * @struct journal_printer
+ * @brief Whether a printer declared in the journal is enabled.
+ */
+struct journal_printer {
+    char *name;   ///< The printer's name.
+    int enabled;  ///< Nonzero after an enable record, zero after a disable record.
+};
+
+/**
+ * @struct journal_job
+ * @brief A job submitted and not yet terminated.
+ */
+struct journal_job {
+    uint64_t ticket;  ///< The job's ticket.
+    char *path;       ///< The file it prints.
+};
+
+/** @brief Nonzero once journal_open() has found JOURNAL_ENV set. */
+static int journal_enabled = 0;
+
+/** @brief Nonzero while journal_open() hands recovered configuration commands back to the CLI. */
+static int replaying = 0;
+
+/** @brief The current journal file, opened for appending, or -1 before the first snapshot. */
+static int log_fd = -1;
+
+/** @brief Generation of the current journal file. */
+static unsigned long long generation = 0;
+
+/** @brief Ticket given to the next submitted job. */
+static uint64_t next_ticket = 1;
+
+/** @brief Lines appended since the last commit. */
+static struct text_buffer uncommitted;
+
+/** @brief Lines written to the current journal file. */
+static int records_since_snapshot = 0;
+
+/** @brief Fires JOURNAL_COMMIT_MS after the first line of a group is appended. */
+static TIMER commit_timer;
+
+/** @brief Configuration commands (type, conversion, printer) in the order they were recorded. */
+static struct text_buffer configuration;
+
+/** @brief Printers declared so far, in declaration order. */
+static struct journal_printer printers[MAX_PRINTERS];
+static int printer_count = 0;
+
+/** @brief Jobs not terminated, in submission order. */
+static struct journal_job jobs[MAX_JOBS];
+static int job_count = 0;
+
+/**
+ * @brief Appends length bytes to a text buffer, growing it as needed.
+ */
+static int append_text(struct text_buffer *buffer, const char *text, size_t length) {
+    if (buffer->length + length > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+        while (capacity < buffer->length + length) {
+            capacity *= 2;
+        }
+        char *data = realloc(buffer->data, capacity);
+        if (!data) {
+            return -1;
+        }
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->length, text, length);
+    buffer->length += length;
+    return 0;
+}
+
+/**
+ * @brief Appends a line and its newline to a text buffer.
+ */
+static int append_line(struct text_buffer *buffer, const char *line) {
+    return (append_text(buffer, line, strlen(line)) < 0 || append_text(buffer, "\n", 1) < 0) ? -1 : 0;
+}
+
+/**
+ * @brief Returns the recorded state of a printer, or NULL if it was never declared.
+ */
+static struct journal_printer *find_printer(const char *name, size_t length) {
+    for (int i = 0; i < printer_count; i++) {
+        if (strlen(printers[i].name) == length && strncmp(printers[i].name, name, length) == 0) {
+            return &printers[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Updates the journal's copy of the state with one record.
+ *
+ * @param line The record, without its newline; it is not modified.
+ */
+static void apply_record(const char *line) {
+    size_t word = strcspn(line, " ");
+    const char *argument = line + word + (line[word] == ' ');
+    size_t argument_length = strcspn(argument, " ");
+
+    if (strncmp(line, "type", word) == 0 && word == 4) {
+        append_line(&configuration, line);
+    } else if (strncmp(line, "conversion", word) == 0 && word == 10) {
+        append_line(&configuration, line);
+    } else if (strncmp(line, "printer", word) == 0 && word == 7) {
+        append_line(&configuration, line);
+        if (printer_count < MAX_PRINTERS && !find_printer(argument, argument_length)) {
+            printers[printer_count].name = strndup(argument, argument_length);
+            printers[printer_count++].enabled = 0;
+        }
+    } else if ((strncmp(line, "enable", word) == 0 && word == 6) ||
+               (strncmp(line, "disable", word) == 0 && word == 7)) {
+        struct journal_printer *printer = find_printer(argument, argument_length);
+        if (printer) {
+            printer->enabled = (line[0] == 'e');
+        }
+    } else if (strncmp(line, "job", word) == 0 && word == 3) {
+        char *path;
+        uint64_t ticket = strtoull(argument, &path, 10);
+        if (*path != ' ' || job_count == MAX_JOBS) {
+            debug("journal: dropping job record '%s'", line);
+            return;
+        }
+        jobs[job_count].ticket = ticket;
+        jobs[job_count++].path = strdup(path + 1);
+        if (ticket >= next_ticket) {
+            next_ticket = ticket + 1;
+        }
+    } else if (strncmp(line, "end", word) == 0 && word == 3) {
+        uint64_t ticket = strtoull(argument, NULL, 10);
+        for (int i = 0; i < job_count; i++) {
+            if (jobs[i].ticket == ticket) {
+                free(jobs[i].path);
+                memmove(&jobs[i], &jobs[i + 1], (size_t)(job_count - i - 1) * sizeof(jobs[0]));
+                job_count--;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Applies every complete line of a file's contents to the journal's state.
+ *
+ * A last line without its newline was being written during a crash, and is ignored.
+ */
+static void apply_records(char *text, size_t length) {
+    char *end = text + length;
+    char *newline;
+    for (char *line = text; line < end && (newline = memchr(line, '\n', (size_t)(end - line))) != NULL;
+         line = newline + 1) {
+        *newline = '\0';
+        apply_record(line);
+    }
+}
+
+/**
+ * @brief Reads a whole file into a newly allocated buffer.
+ *
+ * @return The contents (to be freed), or NULL if the file does not exist or could not be read.
+ */
+static char *read_whole_file(const char *path, size_t *length) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat file_stat;
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &file_stat) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    char *text = malloc((size_t)file_stat.st_size + 1);
+    size_t got = 0;
+    while (text && got < (size_t)file_stat.st_size) {
+        ssize_t n = read(fd, text + got, (size_t)file_stat.st_size - got);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        got += (size_t)n;
+    }
+    close(fd);
+    *length = got;
+    return text;
+}
+
+/**
+ * @brief Writes a whole buffer to a descriptor.
+ */
+static int write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Builds the path of the journal file of a generation.
+ */
+static void log_path(unsigned long long log_generation, char path[JOURNAL_PATH_MAX]) {
+    snprintf(path, JOURNAL_PATH_MAX, JOURNAL_LOG_FORMAT, log_generation);
+}
+
+/**
+ * @brief Loads the snapshot and the journal file that follows it into the journal's state.
+ */
+static void load_journal(void) {
+    size_t length;
+    char *text = read_whole_file(JOURNAL_SNAPSHOT, &length);
+    if (text) {
+        char *newline = memchr(text, '\n', length);
+        unsigned long long ticket;
+        if (newline && sscanf(text, "generation %llu %llu", &generation, &ticket) == 2) {
+            next_ticket = ticket;
+            size_t header = (size_t)(newline + 1 - text);
+            apply_records(newline + 1, length - header);
+        }
+        free(text);
+    }
+
+    char path[JOURNAL_PATH_MAX];
+    log_path(generation, path);
+    text = read_whole_file(path, &length);
+    if (text) {
+        apply_records(text, length);
+        free(text);
+    }
+}
+
+/**
+ * @brief Writes the journal's state to a new snapshot and starts the next journal file.
+ *
+ * The snapshot is written to a temporary file, flushed and renamed over the
+ * old one; only then is the previous journal file removed. A crash at any
+ * point leaves either the old snapshot and its journal, or the new snapshot
+ * (whose journal file may not exist yet, which means it is empty).
+ */
+static int take_snapshot(void) {
+    struct text_buffer snapshot = { 0 };
+    char line[64];
+    snprintf(line, sizeof(line), "generation %llu %llu", generation + 1, (unsigned long long)next_ticket);
+    int failed = append_line(&snapshot, line) < 0 ||
+                 append_text(&snapshot, configuration.data, configuration.length) < 0;
+    for (int i = 0; i < printer_count && !failed; i++) {
+        if (printers[i].enabled) {
+            failed = append_text(&snapshot, "enable ", 7) < 0 || append_line(&snapshot, printers[i].name) < 0;
+        }
+    }
+    for (int i = 0; i < job_count && !failed; i++) {
+        snprintf(line, sizeof(line), "job %llu ", (unsigned long long)jobs[i].ticket);
+        failed = append_text(&snapshot, line, strlen(line)) < 0 || append_line(&snapshot, jobs[i].path) < 0;
+    }
+
+    int fd = failed ? -1 : open(JOURNAL_SNAPSHOT ".tmp", O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    failed = fd < 0 || write_all(fd, snapshot.data, snapshot.length) < 0 || fsync(fd) < 0;
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(snapshot.data);
+    if (failed || rename(JOURNAL_SNAPSHOT ".tmp", JOURNAL_SNAPSHOT) < 0) {
+        return -1;
+    }
+    int dir_fd = open("spool", O_RDONLY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+
+    // The snapshot now covers everything; the old journal file and anything not yet committed are obsolete
+    char path[JOURNAL_PATH_MAX];
+    if (log_fd >= 0) {
+        close(log_fd);
+    }
+    log_path(generation, path);
+    unlink(path);
+    generation++;
+    log_path(generation, path);
+    log_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0666);
+    uncommitted.length = 0;
+    records_since_snapshot = 0;
+    timer_wheel_cancel(&commit_timer);
+    debug("journal: snapshot of generation %llu, %d jobs", generation, job_count);
+    return log_fd < 0 ? -1 : 0;
+}
+
+/**
+ * @brief Timer callback: writes the lines gathered since the last commit with
+ * one write() and one fdatasync(), then takes a snapshot if the journal file
+ * has grown long enough.
+ */
+static void commit_journal(void *context) {
+    (void)context;
+    if (log_fd < 0 || uncommitted.length == 0) {
+        return;
+    }
+    if (write_all(log_fd, uncommitted.data, uncommitted.length) < 0 || fdatasync(log_fd) < 0) {
+        perror("journal");
+    }
+    uncommitted.length = 0;
+    if (records_since_snapshot >= JOURNAL_SNAPSHOT_RECORDS && take_snapshot() < 0) {
+        perror("journal snapshot");
+    }
+}
+
+/**
+ * @brief Applies a record to the journal's state and queues it for the next commit.
+ *
+ * Before the first snapshot of journal_open() there is no journal file yet,
+ * and the snapshot itself will hold the record.
+ */
+static void append_record(const char *line) {
+    apply_record(line);
+    if (log_fd < 0) {
+        return;
+    }
+    append_line(&uncommitted, line);
+    records_since_snapshot++;
+    if (!timer_wheel_is_scheduled(&commit_timer)) {
+        timer_wheel_schedule(&commit_timer, JOURNAL_COMMIT_MS);
+    }
+}
+
+/**
+ * @brief Loads the journal, replays it through the callback, and takes the first snapshot.
+ */
+int journal_open(journal_apply_func_t *apply, void *context) {
+    if (!getenv(JOURNAL_ENV)) {
+        return 0;
+    }
+    journal_enabled = 1;
+    timer_wheel_init_timer(&commit_timer, commit_journal, NULL);
+    mkdir("spool", 0777);
+    load_journal();
+
+    // The configuration is already in the journal's state; applying it must not record it twice
+    replaying = 1;
+    char *commands = malloc(configuration.length + 1);
+    if (commands) {
+        memcpy(commands, configuration.data, configuration.length);
+        commands[configuration.length] = '\0';
+        for (char *line = strtok(commands, "\n"); line; line = strtok(NULL, "\n")) {
+            apply(line, context);
+        }
+        free(commands);
+    }
+    for (int i = 0; i < printer_count; i++) {
+        char *line = printers[i].enabled ? malloc(strlen(printers[i].name) + 8) : NULL;
+        if (line) {
+            sprintf(line, "enable %s", printers[i].name);
+            apply(line, context);
+            free(line);
+        }
+    }
+    replaying = 0;
+
+    // Unfinished jobs start over: their old records go, and resubmitting them records them anew
+    struct journal_job recovered[MAX_JOBS];
+    int recovered_count = job_count;
+    memcpy(recovered, jobs, (size_t)job_count * sizeof(jobs[0]));
+    job_count = 0;
+    for (int i = 0; i < recovered_count; i++) {
+        char *line = malloc(strlen(recovered[i].path) + 7);
+        if (line) {
+            sprintf(line, "print %s", recovered[i].path);
+            apply(line, context);
+            free(line);
+        }
+        free(recovered[i].path);
+    }
+
+    return take_snapshot();
+}
+
+/**
+ * @brief Joins the command's tokens into one record.
+ */
+void journal_record_command(char **argv, int argc) {
+    if (!journal_enabled || replaying) {
+        return;
+    }
+    struct text_buffer line = { 0 };
+    int failed = 0;
+    for (int i = 0; i < argc && !failed; i++) {
+        failed = (i > 0 && append_text(&line, " ", 1) < 0) || append_text(&line, argv[i], strlen(argv[i])) < 0;
+    }
+    if (!failed && append_text(&line, "", 1) == 0) {
+        append_record(line.data);
+    }
+    free(line.data);
+}
+
+/**
+ * @brief Gives the job the next ticket and records it.
+ */
+uint64_t journal_record_job(const char *file_path) {
+    if (!journal_enabled) {
+        return 0;
+    }
+    uint64_t ticket = next_ticket;
+    char *line = malloc(strlen(file_path) + 32);
+    if (!line) {
+        return 0;
+    }
+    sprintf(line, "job %llu %s", (unsigned long long)ticket, file_path);
+    append_record(line);
+    free(line);
+    return ticket;
+}
+
+/**
+ * @brief Records the end of the job with the given ticket.
+ */
+void journal_record_job_end(uint64_t ticket) {
+    if (!journal_enabled || ticket == 0) {
+        return;
+    }
+    char line[32];
+    snprintf(line, sizeof(line), "end %llu", (unsigned long long)ticket);
+    append_record(line);
+}
+
+/**
+ * @brief Commits immediately.
+ */
+void journal_sync(void) {
+    if (log_fd >= 0) {
+        timer_wheel_cancel(&commit_timer);
+        commit_journal(NULL);
+    }
+}
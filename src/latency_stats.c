@@ -0,0 +1,162 @@
+/**
+ * @file latency_stats.c
+ * @brief Implements the job latency histograms.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "latency_stats.h"
+#include "conversions.h"
+#include "printer_struct.h"
+
+/** @brief Number of buckets sharing each power of two above the exact range. */
+#define SUB_BUCKET_HALF (1u << (LATENCY_SUB_BUCKET_BITS - 1))
+
+/**
+ * @struct latency_scope
+ * @brief The histograms of every metric for one subset of the jobs.
+ */
+struct latency_scope {
+    LATENCY_HISTOGRAM metrics[LATENCY_METRIC_COUNT];
+    const char *name;  ///< Printer or file type name, once something has been recorded.
+};
+
+/** @brief All jobs. */
+static struct latency_scope all_jobs;
+
+/** @brief Jobs by printer ID. */
+static struct latency_scope printer_scopes[MAX_PRINTERS];
+
+/** @brief Jobs by FILE_TYPE.index. */
+static struct latency_scope type_scopes[MAX_FILE_TYPES];
+
+/** @brief Names of the metrics, as printed by 'stats'. */
+static const char *metric_names[LATENCY_METRIC_COUNT] = {
+    [LATENCY_QUEUE_WAIT] = "queue wait",
+    [LATENCY_FIRST_BYTE] = "first byte",
+    [LATENCY_RUNTIME]    = "runtime",
+    [LATENCY_END_TO_END] = "end to end",
+};
+
+uint64_t latency_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec + 1;
+}
+
+/**
+ * @brief Maps a value to its bucket.
+ *
+ * Values below 2^LATENCY_SUB_BUCKET_BITS are their own bucket. Above, a value
+ * whose highest set bit is m keeps its top LATENCY_SUB_BUCKET_BITS bits, which
+ * range over [SUB_BUCKET_HALF, 2 * SUB_BUCKET_HALF), and each magnitude m
+ * adds SUB_BUCKET_HALF buckets after the previous one.
+ */
+static unsigned bucket_of(uint64_t value) {
+    if (value >= (uint64_t)1 << (LATENCY_MAX_MAGNITUDE + 1)) {
+        value = ((uint64_t)1 << (LATENCY_MAX_MAGNITUDE + 1)) - 1;
+    }
+    if (value < (uint64_t)1 << LATENCY_SUB_BUCKET_BITS) {
+        return (unsigned)value;
+    }
+    unsigned magnitude = 63 - (unsigned)__builtin_clzll(value);
+    unsigned shift = magnitude - (LATENCY_SUB_BUCKET_BITS - 1);
+    return (magnitude - LATENCY_SUB_BUCKET_BITS + 1) * SUB_BUCKET_HALF + (unsigned)(value >> shift);
+}
+
+/**
+ * @brief Returns the largest value that maps to a bucket.
+ */
+static uint64_t highest_in_bucket(unsigned bucket) {
+    if (bucket < (1u << LATENCY_SUB_BUCKET_BITS)) {
+        return bucket;
+    }
+    unsigned magnitude = bucket / SUB_BUCKET_HALF + LATENCY_SUB_BUCKET_BITS - 2;
+    unsigned shift = magnitude - (LATENCY_SUB_BUCKET_BITS - 1);
+    uint64_t sub_bucket = bucket % SUB_BUCKET_HALF + SUB_BUCKET_HALF;
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+/**
+ * @brief Adds one value to a histogram: a bucket increment plus the totals.
+ */
+void latency_histogram_record(LATENCY_HISTOGRAM *histogram, uint64_t ns) {
+    histogram->buckets[bucket_of(ns)]++;
+    histogram->count++;
+    histogram->sum += ns;
+    if (ns > histogram->max) {
+        histogram->max = ns;
+    }
+}
+
+/**
+ * @brief Records a duration overall, for the printer and for the file type.
+ */
+void latency_record(enum latency_metric metric, const PRINTER *printer, const FILE_TYPE *type, uint64_t ns) {
+    latency_histogram_record(&all_jobs.metrics[metric], ns);
+
+    int printer_id = printer ? get_printer_id(printer) : -1;
+    if (printer_id >= 0 && printer_id < MAX_PRINTERS) {
+        printer_scopes[printer_id].name = printer->name;
+        latency_histogram_record(&printer_scopes[printer_id].metrics[metric], ns);
+    }
+    if (type && type->index >= 0 && type->index < MAX_FILE_TYPES) {
+        type_scopes[type->index].name = type->name;
+        latency_histogram_record(&type_scopes[type->index].metrics[metric], ns);
+    }
+}
+
+/**
+ * @brief Walks the buckets until the requested rank is reached.
+ */
+uint64_t latency_percentile(const LATENCY_HISTOGRAM *histogram, double quantile) {
+    if (histogram->count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(quantile * (double)histogram->count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank) {
+            uint64_t value = highest_in_bucket(i);
+            return (value < histogram->max) ? value : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+/**
+ * @brief Prints one line of the 'stats' table, durations in milliseconds.
+ */
+static void print_histogram(FILE *out, const char *kind, const char *name, const LATENCY_HISTOGRAM *histogram) {
+    if (histogram->count == 0) {
+        return;
+    }
+    char scope[64];
+    snprintf(scope, sizeof(scope), "%s%s%s", kind, name ? " " : "", name ? name : "");
+    fprintf(out, "  %-24s %8llu %11.3f %11.3f %11.3f %11.3f\n", scope, (unsigned long long)histogram->count,
+            latency_percentile(histogram, 0.50) / 1e6, latency_percentile(histogram, 0.99) / 1e6,
+            latency_percentile(histogram, 0.999) / 1e6, histogram->max / 1e6);
+}
+
+/**
+ * @brief Prints a table per metric: all jobs, then each printer, then each file type.
+ */
+void latency_stats_print(FILE *out) {
+    for (int metric = 0; metric < LATENCY_METRIC_COUNT; metric++) {
+        fprintf(out, "%-26s %8s %11s %11s %11s %11s\n", metric_names[metric], "jobs", "p50 (ms)", "p99 (ms)",
+                "p999 (ms)", "max (ms)");
+        print_histogram(out, "all", NULL, &all_jobs.metrics[metric]);
+        for (int i = 0; i < MAX_PRINTERS; i++) {
+            print_histogram(out, "printer", printer_scopes[i].name, &printer_scopes[i].metrics[metric]);
+        }
+        for (int i = 0; i < MAX_FILE_TYPES; i++) {
+            print_histogram(out, "type", type_scopes[i].name, &type_scopes[i].metrics[metric]);
+        }
+    }
+}
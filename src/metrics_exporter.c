@@ -0,0 +1,336 @@
+/**
+ * @file metrics_exporter.c
+ * @brief Implements the Prometheus metrics exporter.
+ *
+ * The snapshot is published under a sequence lock: the main loop makes the
+ * sequence number odd, copies the new snapshot in, and makes it even again;
+ * the serving thread copies the snapshot out and retries if the number was odd
+ * or changed meanwhile. The writer never waits, and with one snapshot a second
+ * the reader practically never has to retry.
+ */
+
+#define _GNU_SOURCE  // accept4()
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "metrics_exporter.h"
+#include "job_manager.h"
+#include "output_cache.h"
+#include "printer_manager.h"
+#include "timer_wheel.h"
+
+/** @brief How long a client may take to send its request before it is answered anyway. */
+#define METRICS_REQUEST_WAIT_MS 100
+
+/** @brief Capacity of the formatted response. */
+#define METRICS_TEXT_SIZE 65536
+
+/**
+ * @struct metrics_snapshot
+ * @brief Everything the exporter reports, as taken at one moment by the main loop.
+ */
+struct metrics_snapshot {
+    JOB_METRICS jobs;
+    PRINTER_METRICS printers;
+    OUTPUT_CACHE_STATS cache;
+};
+
+/**
+ * @struct metrics_text
+ * @brief A response being formatted.
+ */
+struct metrics_text {
+    char data[METRICS_TEXT_SIZE];
+    size_t length;
+};
+
+/** @brief The snapshot most recently published. */
+static struct metrics_snapshot published;
+
+/** @brief Odd while published is being written; bumped twice per publication. */
+static unsigned publish_sequence = 0;
+
+/** @brief Fires every METRICS_PUBLISH_MS to publish a new snapshot. */
+static TIMER publish_timer;
+
+/** @brief The listening socket, or -1 if the exporter is off. */
+static int listen_fd = -1;
+
+/**
+ * @brief Takes a snapshot on the main loop and publishes it.
+ */
+static void publish_snapshot(void) {
+    static struct metrics_snapshot staging;
+    job_manager_get_metrics(&staging.jobs);
+    printer_manager_get_metrics(&staging.printers);
+    output_cache_get_stats(&staging.cache);
+
+    unsigned sequence = publish_sequence;
+    __atomic_store_n(&publish_sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&published, &staging, sizeof(published));
+    __atomic_store_n(&publish_sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Timer callback: publishes a snapshot and schedules the next one.
+ */
+static void handle_publish_timer(void *context) {
+    (void)context;
+    publish_snapshot();
+    timer_wheel_schedule(&publish_timer, METRICS_PUBLISH_MS);
+}
+
+/**
+ * @brief Copies the latest complete snapshot, on the serving thread.
+ */
+static void read_snapshot(struct metrics_snapshot *snapshot) {
+    unsigned before, after;
+    do {
+        before = __atomic_load_n(&publish_sequence, __ATOMIC_ACQUIRE);
+        memcpy(snapshot, &published, sizeof(*snapshot));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&publish_sequence, __ATOMIC_RELAXED);
+    } while ((before & 1) || before != after);
+}
+
+/**
+ * @brief Appends formatted text to the response; output that does not fit is dropped.
+ */
+static void append(struct metrics_text *text, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t room = METRICS_TEXT_SIZE - text->length;
+    int n = vsnprintf(text->data + text->length, room, format, args);
+    va_end(args);
+    if (n > 0) {
+        text->length += ((size_t)n < room) ? (size_t)n : room - 1;
+    }
+}
+
+/**
+ * @brief Appends the HELP and TYPE lines that introduce a metric.
+ */
+static void append_header(struct metrics_text *text, const char *name, const char *type, const char *help) {
+    append(text, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/**
+ * @brief Copies a label value, escaping backslashes, double quotes and newlines.
+ */
+static const char *escape_label(const char *value, char *escaped, size_t size) {
+    size_t n = 0;
+    for (; *value && n + 2 < size; value++) {
+        if (*value == '\\' || *value == '"' || *value == '\n') {
+            escaped[n++] = '\\';
+            escaped[n++] = (*value == '\n') ? 'n' : *value;
+        } else {
+            escaped[n++] = *value;
+        }
+    }
+    escaped[n] = '\0';
+    return escaped;
+}
+
+/**
+ * @brief Formats a snapshot in the text exposition format.
+ */
+static void format_metrics(const struct metrics_snapshot *snapshot, struct metrics_text *text) {
+    static const char *job_states[JOB_DELETED + 1] = {
+        "created", "running", "paused", "finished", "aborted", "deleted"
+    };
+    static const char *printer_states[PRINTER_BUSY + 1] = { "disabled", "idle", "busy" };
+    const JOB_METRICS *jobs = &snapshot->jobs;
+    const PRINTER_METRICS *printers = &snapshot->printers;
+    char label[256];
+
+    append_header(text, "presi_jobs", "gauge", "Jobs currently tracked, by state.");
+    for (int state = JOB_CREATED; state <= JOB_DELETED; state++) {
+        append(text, "presi_jobs{state=\"%s\"} %d\n", job_states[state], jobs->jobs_by_status[state]);
+    }
+    append_header(text, "presi_jobs_submitted_total", "counter", "Jobs submitted since startup.");
+    append(text, "presi_jobs_submitted_total %lu\n", jobs->jobs_submitted);
+
+    append_header(text, "presi_queue_depth", "gauge", "Jobs waiting for a printer, by file type.");
+    for (int type = 0; type < MAX_FILE_TYPES; type++) {
+        if (jobs->type_names[type]) {
+            append(text, "presi_queue_depth{type=\"%s\"} %d\n",
+                   escape_label(jobs->type_names[type], label, sizeof(label)), jobs->queue_depth[type]);
+        }
+    }
+
+    append_header(text, "presi_pipelines_launched_total", "counter", "Conversion pipelines started.");
+    append(text, "presi_pipelines_launched_total %lu\n", jobs->pipelines_launched);
+    append_header(text, "presi_stage_spawn_failures_total", "counter",
+                  "Pipeline stages that could not be started.");
+    append(text, "presi_stage_spawn_failures_total %lu\n", jobs->spawn_failures);
+
+    append_header(text, "presi_reap_latency_seconds", "summary",
+                  "Delay between the report of a pipeline stage's exit and its reaping.");
+    append(text, "presi_reap_latency_seconds{quantile=\"0.5\"} %.9f\n", jobs->reap_p50_ns / 1e9);
+    append(text, "presi_reap_latency_seconds{quantile=\"0.99\"} %.9f\n", jobs->reap_p99_ns / 1e9);
+    append(text, "presi_reap_latency_seconds{quantile=\"1\"} %.9f\n", jobs->reap_max_ns / 1e9);
+    append(text, "presi_reap_latency_seconds_sum %.9f\n", jobs->reap_sum_ns / 1e9);
+    append(text, "presi_reap_latency_seconds_count %llu\n", (unsigned long long)jobs->reap_count);
+
+    append_header(text, "presi_printer_status", "gauge", "1 for the current status of each printer.");
+    for (int i = 0; i < printers->count; i++) {
+        escape_label(printers->printers[i].name, label, sizeof(label));
+        for (int state = PRINTER_DISABLED; state <= PRINTER_BUSY; state++) {
+            append(text, "presi_printer_status{printer=\"%s\",status=\"%s\"} %d\n", label,
+                   printer_states[state], printers->printers[i].status == (PRINTER_STATUS)state);
+        }
+    }
+    append_header(text, "presi_printer_busy_seconds_total", "counter",
+                  "Time each printer has spent with a job running.");
+    for (int i = 0; i < printers->count; i++) {
+        append(text, "presi_printer_busy_seconds_total{printer=\"%s\"} %.6f\n",
+               escape_label(printers->printers[i].name, label, sizeof(label)), printers->printers[i].busy_ns / 1e9);
+    }
+    append_header(text, "presi_printer_busy_ratio", "gauge",
+                  "Fraction of the time since its declaration that each printer has had a job running.");
+    for (int i = 0; i < printers->count; i++) {
+        uint64_t declared = printers->printers[i].declared_ns;
+        append(text, "presi_printer_busy_ratio{printer=\"%s\"} %.6f\n",
+               escape_label(printers->printers[i].name, label, sizeof(label)),
+               declared ? (double)printers->printers[i].busy_ns / (double)declared : 0.0);
+    }
+
+    append_header(text, "presi_output_cache_hits_total", "counter", "Output cache lookups that hit.");
+    append(text, "presi_output_cache_hits_total %lu\n", snapshot->cache.hits);
+    append_header(text, "presi_output_cache_misses_total", "counter", "Output cache lookups that missed.");
+    append(text, "presi_output_cache_misses_total %lu\n", snapshot->cache.misses);
+    append_header(text, "presi_output_cache_bytes", "gauge", "Total size of the cached outputs.");
+    append(text, "presi_output_cache_bytes %lld\n", (long long)snapshot->cache.bytes);
+}
+
+/**
+ * @brief Writes a whole buffer to a blocking socket.
+ */
+static int write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Answers one connection with the latest snapshot.
+ */
+static void serve_client(int fd, struct metrics_text *text) {
+    struct timeval timeout = { .tv_sec = 1, .tv_usec = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    // A scraper speaks HTTP; a plain client may not send anything at all
+    char request[512];
+    ssize_t got = 0;
+    struct pollfd poll_fd = { .fd = fd, .events = POLLIN };
+    if (poll(&poll_fd, 1, METRICS_REQUEST_WAIT_MS) > 0) {
+        got = read(fd, request, sizeof(request));
+    }
+    int http = got >= 4 && memcmp(request, "GET ", 4) == 0;
+
+    static struct metrics_snapshot snapshot;
+    read_snapshot(&snapshot);
+    text->length = 0;
+    format_metrics(&snapshot, text);
+
+    if (http) {
+        char header[160];
+        int n = snprintf(header, sizeof(header),
+                         "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                         "Content-Length: %zu\r\n\r\n", text->length);
+        if (write_all(fd, header, (size_t)n) < 0) {
+            return;
+        }
+    }
+    write_all(fd, text->data, text->length);
+}
+
+/**
+ * @brief Body of the serving thread: answers connections one after the other.
+ */
+static void *serve_metrics(void *argument) {
+    (void)argument;
+    static struct metrics_text text;
+    while (1) {
+        int client_fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            break;
+        }
+        serve_client(client_fd, &text);
+        close(client_fd);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Opens the socket, publishes the first snapshot and starts the thread.
+ */
+int metrics_exporter_start(void) {
+    if (!getenv(METRICS_ENV) || listen_fd >= 0) {
+        return 0;
+    }
+
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    strncpy(address.sun_path, METRICS_SOCKET_PATH, sizeof(address.sun_path) - 1);
+    mkdir("spool", 0777);
+    unlink(METRICS_SOCKET_PATH);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        return -1;
+    }
+    if (bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(listen_fd, SOMAXCONN) < 0) {
+        close(listen_fd);
+        listen_fd = -1;
+        return -1;
+    }
+
+    publish_snapshot();
+    timer_wheel_init_timer(&publish_timer, handle_publish_timer, NULL);
+    timer_wheel_schedule(&publish_timer, METRICS_PUBLISH_MS);
+
+    // The thread must not take signals meant for the main loop (SIGCHLD is read from a signalfd)
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    int error = pthread_create(&thread, &attributes, serve_metrics, NULL);
+    pthread_attr_destroy(&attributes);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (error != 0) {
+        timer_wheel_cancel(&publish_timer);
+        close(listen_fd);
+        listen_fd = -1;
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
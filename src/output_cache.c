@@ -0,0 +1,440 @@
+/**
+ * @file output_cache.c
+ * @brief Implements the content-addressed cache of converted print data.
+ *
+ * The index is a small fixed table kept in memory; the files themselves live in
+ * OUTPUT_CACHE_DIR as <hash>-<size>.out, with the hash written as 16 hex digits
+ * and the input size in hex. Outputs being produced are written to
+ * <hash>-<size>.<job>.tmp and renamed into place only once their pipeline has
+ * succeeded, so a cached file is always complete.
+ *
+ * Hashes are 64-bit FNV-1a. Recency is a counter bumped on every hit and
+ * insertion; eviction scans the table for the smallest value, which is cheap at
+ * MAX_OUTPUT_CACHE_ENTRIES entries. The remembered input hashes are a second
+ * table of the same kind.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "output_cache.h"
+#include "conversions.h"
+#include "debug.h"
+
+/** @brief Length of a cache file path: directory, separator, 16 hex digits and a suffix. */
+#define CACHE_PATH_MAX (sizeof(OUTPUT_CACHE_DIR) + 64)
+
+/** @brief Size of the buffer used to hash input files. */
+#define HASH_CHUNK (64 * 1024)
+
+/**
+ * @brief How recently a file may have changed for its hash not to be remembered.
+ *
+ * File timestamps advance in clock ticks, so a file rewritten within the tick
+ * in which it was hashed could keep its size and times; such a file is hashed
+ * again each time until it is older than this.
+ */
+#define DIGEST_SETTLE_NS 1000000000LL
+
+/** @brief FNV-1a 64-bit offset basis and prime. */
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+/**
+ * @struct cache_entry
+ * @brief One cached output.
+ */
+struct cache_entry {
+    OUTPUT_CACHE_KEY key; ///< Hash of the input and the conversion path, and size of the input.
+    off_t size;          ///< Size of the cached file in bytes.
+    uint64_t last_used;  ///< Value of use_clock when the entry was last hit or added.
+    int in_use;          ///< Nonzero if this table entry holds an output.
+};
+
+/**
+ * @struct input_digest
+ * @brief The hash of an input file's bytes, and what identified the file when it was read.
+ */
+struct input_digest {
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    struct timespec modified;  ///< st_mtim.
+    struct timespec changed;   ///< st_ctim, which also moves when st_mtim is set back.
+    uint64_t hash;             ///< FNV-1a hash of the bytes.
+    uint64_t last_used;        ///< Value of use_clock when the digest was last used.
+    int in_use;
+};
+
+/** @brief The cache index. */
+static struct cache_entry cache_entries[MAX_OUTPUT_CACHE_ENTRIES];
+
+/** @brief Hashes of the input files most recently printed. */
+static struct input_digest input_digests[MAX_INPUT_DIGESTS];
+
+/** @brief Number of entries in use and their total size. */
+static int cached_entries = 0;
+static off_t cached_bytes = 0;
+
+/** @brief Logical clock ordering the entries by recency of use. */
+static uint64_t use_clock = 0;
+
+/** @brief Lookup counters. */
+static unsigned long cache_hits = 0;
+static unsigned long cache_misses = 0;
+
+/** @brief Input files actually read by output_cache_key(). */
+static unsigned long inputs_hashed = 0;
+
+/**
+ * @brief Folds a buffer into an FNV-1a hash.
+ */
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t length) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief Folds a string and its terminating NUL into a hash, so that adjacent
+ * strings cannot run together.
+ */
+static uint64_t fnv1a_string(uint64_t hash, const char *string) {
+    return fnv1a(hash, string, strlen(string) + 1);
+}
+
+/**
+ * @brief Writes the path of the cached output for key into buffer.
+ */
+static void entry_path(OUTPUT_CACHE_KEY key, char *buffer) {
+    snprintf(buffer, CACHE_PATH_MAX, OUTPUT_CACHE_DIR "/%016llx-%llx.out", (unsigned long long)key.hash,
+             (unsigned long long)key.input_size);
+}
+
+/**
+ * @brief Returns the entry caching key, or NULL if there is none.
+ */
+static struct cache_entry *find_entry(OUTPUT_CACHE_KEY key) {
+    for (int i = 0; i < MAX_OUTPUT_CACHE_ENTRIES; i++) {
+        if (cache_entries[i].in_use && cache_entries[i].key.hash == key.hash &&
+            cache_entries[i].key.input_size == key.input_size) {
+            return &cache_entries[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Removes an entry from the index and deletes its file.
+ *
+ * A job still sending the file keeps its open descriptor, so eviction never
+ * disturbs a print in progress.
+ */
+static void drop_entry(struct cache_entry *entry) {
+    char path[CACHE_PATH_MAX];
+    entry_path(entry->key, path);
+    unlink(path);
+
+    cached_bytes -= entry->size;
+    cached_entries--;
+    entry->in_use = 0;
+}
+
+/**
+ * @brief Returns the least recently used entry, or NULL if the cache is empty.
+ */
+static struct cache_entry *least_recently_used(void) {
+    struct cache_entry *oldest = NULL;
+    for (int i = 0; i < MAX_OUTPUT_CACHE_ENTRIES; i++) {
+        if (cache_entries[i].in_use && (!oldest || cache_entries[i].last_used < oldest->last_used)) {
+            oldest = &cache_entries[i];
+        }
+    }
+    return oldest;
+}
+
+/**
+ * @brief Evicts entries until one more output of the given size fits, and
+ * returns a free table entry for it.
+ */
+static struct cache_entry *make_room(off_t size) {
+    while (cached_entries == MAX_OUTPUT_CACHE_ENTRIES || cached_bytes + size > OUTPUT_CACHE_BUDGET) {
+        drop_entry(least_recently_used());
+    }
+    for (int i = 0; i < MAX_OUTPUT_CACHE_ENTRIES; i++) {
+        if (!cache_entries[i].in_use) {
+            return &cache_entries[i];
+        }
+    }
+    return NULL;  // Not reached: the loop above freed at least one entry
+}
+
+/**
+ * @brief Records an output in the index.
+ */
+static void add_entry(OUTPUT_CACHE_KEY key, off_t size) {
+    struct cache_entry *entry = make_room(size);
+    entry->key = key;
+    entry->size = size;
+    entry->last_used = ++use_clock;
+    entry->in_use = 1;
+    cached_entries++;
+    cached_bytes += size;
+}
+
+/**
+ * @brief Indexes one file found in the cache directory, or removes it if it is
+ * a partial output or does not fit.
+ */
+static void load_entry(const char *name) {
+    char path[CACHE_PATH_MAX];
+    struct stat file_stat;
+    char *end;
+
+    snprintf(path, sizeof(path), OUTPUT_CACHE_DIR "/%s", name);
+    if (name[0] == '.' || stat(path, &file_stat) < 0 || !S_ISREG(file_stat.st_mode)) {
+        return;
+    }
+
+    OUTPUT_CACHE_KEY key;
+    key.hash = strtoull(name, &end, 16);
+    int named = (end == name + 16 && *end == '-');
+    if (named) {
+        char *size_digits = end + 1;
+        key.input_size = (off_t)strtoull(size_digits, &end, 16);
+        named = (end != size_digits && strcmp(end, ".out") == 0);
+    }
+    if (!named || file_stat.st_size > OUTPUT_CACHE_BUDGET || find_entry(key)) {
+        unlink(path);  // A leftover .tmp file, an older format, or something the index cannot hold
+        return;
+    }
+    add_entry(key, file_stat.st_size);
+}
+
+/**
+ * @brief Creates the cache directory if needed and indexes its contents.
+ */
+void output_cache_initialize(void) {
+    memset(cache_entries, 0, sizeof(cache_entries));
+    memset(input_digests, 0, sizeof(input_digests));
+    cached_entries = 0;
+    cached_bytes = 0;
+    use_clock = 0;
+    cache_hits = cache_misses = 0;
+    inputs_hashed = 0;
+
+    mkdir("spool", 0777);
+    if (mkdir(OUTPUT_CACHE_DIR, 0777) < 0 && errno != EEXIST) {
+        debug("Cannot create %s", OUTPUT_CACHE_DIR);
+        return;
+    }
+
+    DIR *directory = opendir(OUTPUT_CACHE_DIR);
+    if (!directory) {
+        return;
+    }
+    struct dirent *item;
+    while ((item = readdir(directory)) != NULL) {
+        load_entry(item->d_name);
+    }
+    closedir(directory);
+}
+
+/**
+ * @brief Returns the digest remembered for the file described by file_stat, or NULL.
+ */
+static struct input_digest *find_digest(const struct stat *file_stat) {
+    for (int i = 0; i < MAX_INPUT_DIGESTS; i++) {
+        struct input_digest *digest = &input_digests[i];
+        if (digest->in_use && digest->device == file_stat->st_dev && digest->inode == file_stat->st_ino &&
+            digest->size == file_stat->st_size &&
+            digest->modified.tv_sec == file_stat->st_mtim.tv_sec &&
+            digest->modified.tv_nsec == file_stat->st_mtim.tv_nsec &&
+            digest->changed.tv_sec == file_stat->st_ctim.tv_sec &&
+            digest->changed.tv_nsec == file_stat->st_ctim.tv_nsec) {
+            return digest;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Remembers the hash of a file, replacing the least recently used digest if need be.
+ */
+static void remember_digest(const struct stat *file_stat, uint64_t hash) {
+    struct input_digest *digest = &input_digests[0];
+    for (int i = 0; i < MAX_INPUT_DIGESTS && digest->in_use; i++) {
+        if (!input_digests[i].in_use || input_digests[i].last_used < digest->last_used) {
+            digest = &input_digests[i];
+        }
+    }
+    digest->device = file_stat->st_dev;
+    digest->inode = file_stat->st_ino;
+    digest->size = file_stat->st_size;
+    digest->modified = file_stat->st_mtim;
+    digest->changed = file_stat->st_ctim;
+    digest->hash = hash;
+    digest->last_used = ++use_clock;
+    digest->in_use = 1;
+}
+
+static long long timespec_ns(struct timespec ts) {
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Returns nonzero if the file last changed more than DIGEST_SETTLE_NS ago.
+ */
+static int settled(const struct stat *file_stat) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    long long limit = timespec_ns(now) - DIGEST_SETTLE_NS;
+    return timespec_ns(file_stat->st_mtim) < limit && timespec_ns(file_stat->st_ctim) < limit;
+}
+
+/**
+ * @brief Reads an open file to the end and hashes its bytes.
+ */
+static int hash_file(int fd, uint64_t *hash) {
+    static unsigned char buffer[HASH_CHUNK];
+    *hash = FNV_OFFSET_BASIS;
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        *hash = fnv1a(*hash, buffer, (size_t)n);
+    }
+    inputs_hashed++;
+    return 0;
+}
+
+/**
+ * @brief Hashes the input file's contents, unless they are known unchanged,
+ * followed by every conversion of the path.
+ */
+int output_cache_key(const char *input_path, CONVERSION *const *path, OUTPUT_CACHE_KEY *key) {
+    int fd = open(input_path, O_RDONLY | O_CLOEXEC);
+    struct stat file_stat;
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &file_stat) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    uint64_t hash;
+    struct input_digest *digest = find_digest(&file_stat);
+    if (digest) {
+        hash = digest->hash;
+        digest->last_used = ++use_clock;
+    } else if (hash_file(fd, &hash) == 0) {
+        if (settled(&file_stat)) {
+            remember_digest(&file_stat, hash);
+        }
+    } else {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    for (int i = 0; path[i]; i++) {
+        hash = fnv1a_string(hash, path[i]->from->name);
+        hash = fnv1a_string(hash, path[i]->to->name);
+        for (char **arg = path[i]->cmd_and_args; *arg; arg++) {
+            hash = fnv1a_string(hash, *arg);
+        }
+        hash = fnv1a(hash, "", 1);  // Ends this conversion's argument list
+    }
+
+    key->hash = hash;
+    key->input_size = file_stat.st_size;
+    return 0;
+}
+
+/**
+ * @brief Opens the cached output for key, if any, and marks it recently used.
+ */
+int output_cache_open(OUTPUT_CACHE_KEY key) {
+    struct cache_entry *entry = find_entry(key);
+    if (entry) {
+        char path[CACHE_PATH_MAX];
+        entry_path(key, path);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            entry->last_used = ++use_clock;
+            cache_hits++;
+            debug("Output cache hit for %016llx", (unsigned long long)key.hash);
+            return fd;
+        }
+        drop_entry(entry);  // Removed behind our back
+    }
+    cache_misses++;
+    return -1;
+}
+
+/**
+ * @brief Returns the temporary path a job writes a new output to.
+ */
+char *output_cache_begin(OUTPUT_CACHE_KEY key, int job_id) {
+    char *path = malloc(CACHE_PATH_MAX);
+    if (path) {
+        snprintf(path, CACHE_PATH_MAX, OUTPUT_CACHE_DIR "/%016llx-%llx.%d.tmp", (unsigned long long)key.hash,
+                 (unsigned long long)key.input_size, job_id);
+    }
+    return path;
+}
+
+/**
+ * @brief Renames a finished output into place and indexes it.
+ */
+void output_cache_commit(OUTPUT_CACHE_KEY key, char *temp_path) {
+    struct stat file_stat;
+    char path[CACHE_PATH_MAX];
+
+    if (find_entry(key) || stat(temp_path, &file_stat) < 0 || file_stat.st_size > OUTPUT_CACHE_BUDGET) {
+        output_cache_abandon(temp_path);
+        return;
+    }
+
+    entry_path(key, path);
+    if (rename(temp_path, path) < 0) {
+        output_cache_abandon(temp_path);
+        return;
+    }
+    add_entry(key, file_stat.st_size);
+    free(temp_path);
+}
+
+/**
+ * @brief Removes a partial output.
+ */
+void output_cache_abandon(char *temp_path) {
+    unlink(temp_path);
+    free(temp_path);
+}
+
+/**
+ * @brief Copies the counters into stats.
+ */
+void output_cache_get_stats(OUTPUT_CACHE_STATS *stats) {
+    stats->hits = cache_hits;
+    stats->misses = cache_misses;
+    stats->inputs_hashed = inputs_hashed;
+    stats->entries = cached_entries;
+    stats->bytes = cached_bytes;
+}
@@ -0,0 +1,119 @@
+/**
+ * @file pipeline_launcher.c
+ * @brief Starts conversion pipelines with posix_spawnp().
+ *
+ * fork() copies the page tables of the whole spooler, so its cost grows with
+ * the spooler's size; posix_spawnp() starts the new program without copying
+ * anything (glibc uses a CLONE_VM | CLONE_VFORK child). Everything the old
+ * forked children did by hand is expressed as spawn attributes and file actions:
+ * joining the pipeline's process group, resetting the signal mask, wiring
+ * stdin/stdout with dup2/open, and closing every other descriptor.
+ */
+
+#define _GNU_SOURCE  // pipe2() and posix_spawn_file_actions_addclosefrom_np()
+
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+
+#include "pipeline_launcher.h"
+
+extern char **environ;
+
+/**
+ * @brief Spawns one stage with the given standard input and output.
+ *
+ * Exactly one of input_path and input_fd is used: the path is opened for the
+ * first stage, the descriptor (a pipe) is duplicated for the others.
+ *
+ * @return The PID of the stage, or -1 if it could not be started.
+ */
+static pid_t spawn_stage(char **argv, const char *input_path, int input_fd, int output_fd,
+                         pid_t pgid, posix_spawnattr_t *attr) {
+    posix_spawn_file_actions_t actions;
+    if (posix_spawn_file_actions_init(&actions) != 0) {
+        return -1;
+    }
+
+    if (input_path) {
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, input_path, O_RDONLY, 0);
+    } else {
+        posix_spawn_file_actions_adddup2(&actions, input_fd, STDIN_FILENO);
+    }
+    posix_spawn_file_actions_adddup2(&actions, output_fd, STDOUT_FILENO);
+    posix_spawn_file_actions_addclosefrom_np(&actions, STDERR_FILENO + 1);
+
+    posix_spawnattr_setpgroup(attr, (pgid < 0) ? 0 : pgid);
+
+    pid_t pid;
+    if (posix_spawnp(&pid, argv[0], &actions, attr, argv, environ) != 0) {
+        pid = -1;
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    return pid;
+}
+
+/**
+ * @brief Starts a pipeline of stage_count processes in a new process group.
+ *
+ * Pipes are created close-on-exec, so each one only survives in the two stages
+ * it connects (through the dup2 file actions) and is closed in the spooler as
+ * soon as both ends have been handed out.
+ */
+pid_t launch_pipeline(char **stage_argv[], int stage_count, const char *input_path,
+                      int output_fd, pid_t pids[]) {
+    posix_spawnattr_t attr;
+    if (posix_spawnattr_init(&attr) != 0) {
+        return -1;
+    }
+
+    // The spooler blocks SIGCHLD for its signalfd; stages must start with a clean mask
+    sigset_t no_signals, default_signals;
+    sigemptyset(&no_signals);
+    sigemptyset(&default_signals);
+    sigaddset(&default_signals, SIGCHLD);
+    sigaddset(&default_signals, SIGPIPE);
+    posix_spawnattr_setsigmask(&attr, &no_signals);
+    posix_spawnattr_setsigdefault(&attr, &default_signals);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    pid_t pgid = -1;
+    int prev_read = -1;  // Read end of the pipe feeding the current stage
+
+    for (int i = 0; i < stage_count; i++) {
+        int is_last = (i == stage_count - 1);
+        int pipefd[2] = { -1, -1 };
+
+        if (!is_last && pipe2(pipefd, O_CLOEXEC) < 0) {
+            // Without a pipe no later stage can be connected; the earlier ones see a broken pipe
+            for (; i < stage_count; i++) {
+                pids[i] = -1;
+            }
+            break;
+        }
+
+        int out = is_last ? output_fd : pipefd[1];
+        pids[i] = -1;
+        if (out >= 0) {
+            pids[i] = spawn_stage(stage_argv[i], (i == 0) ? input_path : NULL, prev_read, out, pgid, &attr);
+        }
+        if (pids[i] > 0 && pgid < 0) {
+            pgid = pids[i];  // The first stage that starts leads the group
+        }
+
+        if (prev_read >= 0) {
+            close(prev_read);
+        }
+        if (!is_last) {
+            close(pipefd[1]);
+            prev_read = pipefd[0];
+        }
+    }
+
+    if (prev_read >= 0) {
+        close(prev_read);
+    }
+    posix_spawnattr_destroy(&attr);
+    return pgid;
+}
@@ -10,12 +10,34 @@
  */
 
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/pidfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 
 #include "printer_manager.h"
 #include "printer_struct.h"
 #include "conversions.h"
+#include "conversion_cache.h"
+#include "event_loop.h"
+#include "latency_stats.h"
+#include "event_ring.h"
+#include "pipeline_launcher.h"
+
+/** @brief The printer daemon, started the same way presi_connect_to_printer() starts it. */
+#define PRINTER_PROGRAM "util/printer"
+
+/** @brief Time a started daemon has to create its socket before it is started again. */
+#define PRINTER_START_MS 1000
 
 /** @brief A global, fixed-size array that stores every declared printer. */
 static PRINTER printer_registry[MAX_PRINTERS];
@@ -23,6 +45,51 @@ static PRINTER printer_registry[MAX_PRINTERS];
 /** @brief The current count of printers recorded in printer_registry. */
 static int number_of_registered_printers = 0;
 
+/**
+ * @brief Bitmask of the printers that are currently IDLE.
+ *
+ * Bit i stands for printer_registry[i]; MAX_PRINTERS is 32, so one word covers
+ * the whole registry. Kept current by change_printer_status().
+ */
+static uint32_t idle_printer_mask = 0;
+
+/**
+ * @brief Bitmask of the printers that have a job running on them, whatever
+ * their displayed status (a busy printer may have been disabled meanwhile).
+ */
+static uint32_t busy_printer_mask = 0;
+
+/**
+ * @brief For each FILE_TYPE.index, the printers able to print that type,
+ * either directly or through a conversion path.
+ *
+ * Entries are computed on first use and only valid while their bit is set in
+ * eligibility_known. New printers are added to every known entry; a change to
+ * the conversions clears them all.
+ */
+static uint32_t eligible_by_type[MAX_FILE_TYPES];
+
+/** @brief The FILE_TYPE each valid eligible_by_type entry was computed for. */
+static FILE_TYPE *eligibility_type[MAX_FILE_TYPES];
+
+/** @brief Bit t is set when eligible_by_type[t] is up to date. */
+static uint64_t eligibility_known = 0;
+
+/** @brief Printers whose daemon this spooler has already started (bit i is printer i). */
+static uint32_t started_printer_mask = 0;
+
+/** @brief latency_now_ns() when each printer in started_printer_mask had its daemon started. */
+static uint64_t started_at_ns[MAX_PRINTERS];
+
+/** @brief latency_now_ns() when each printer was declared. */
+static uint64_t declared_at_ns[MAX_PRINTERS];
+
+/** @brief latency_now_ns() when each printer in busy_printer_mask became busy. */
+static uint64_t busy_since_ns[MAX_PRINTERS];
+
+/** @brief Time each printer has spent busy, not counting its current busy period. */
+static uint64_t busy_total_ns[MAX_PRINTERS];
+
 /**
  * @brief Initializes the internal printer registry to a clean state.
  *
@@ -51,6 +118,10 @@ void printer_manager_cleanup(void) {
         printer_registry[i].other = NULL;
     }
     number_of_registered_printers = 0;
+    idle_printer_mask = 0;
+    busy_printer_mask = 0;
+    eligibility_known = 0;
+    started_printer_mask = 0;
 }
 
 /**
@@ -88,11 +159,22 @@ int add_printer_to_system(const char *printer_name, const char *file_type_name)
     new_printer->type = resolved_file_type;
     new_printer->status = PRINTER_DISABLED;
     new_printer->other = NULL;
+    declared_at_ns[number_of_registered_printers] = latency_now_ns();
+    busy_total_ns[number_of_registered_printers] = 0;
 
     number_of_registered_printers++;
 
+    // Add the new printer to the eligibility masks that have already been computed
+    uint32_t printer_bit = (uint32_t)1 << (number_of_registered_printers - 1);
+    for (uint64_t types = eligibility_known; types; types &= types - 1) {
+        int type_index = ffsll((long long)types) - 1;
+        if (lookup_conversion_path(eligibility_type[type_index], resolved_file_type)) {
+            eligible_by_type[type_index] |= printer_bit;
+        }
+    }
+
     // Notifies the spooler framework that a new printer was defined
-    sf_printer_defined(new_printer->name, new_printer->type->name);
+    emit_printer_defined(new_printer->name, new_printer->type->name);
     return 0;
 }
 
@@ -143,65 +225,278 @@ PRINTER *get_printer_by_index(int index) {
 
 
 /**
- * @brief Selects a compatible IDLE printer for a given input file type.
+ * @brief Returns the registry index of a printer, which is also its bit in every printer mask.
  *
- * This function is responsible for finding a printer that is currently available
- * (i.e., has status PRINTER_IDLE) and is capable of printing the specified file type.
- *
- * A printer is considered compatible with the file type if:
- *   - It supports the file type natively (i.e., the printer's type exactly matches the input type), OR
- *   - There exists a valid conversion path from the input file type to the printer's supported type.
+ * @param printer A printer obtained from this module.
+ * @return The zero-based printer ID.
+ */
+int get_printer_id(const PRINTER *printer) {
+    return (int)(printer - printer_registry);
+}
+
+/**
+ * @brief Writes the path of a printer's socket, spool/<name>.sock, into address.
+ */
+static void printer_socket_address(const PRINTER *printer, struct sockaddr_un *address) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    snprintf(address->sun_path, sizeof(address->sun_path), "spool/%s.sock", printer->name);
+}
+
+/**
+ * @brief Event loop callback: reaps the launcher of a printer daemon.
  *
- * If a printer supports the file type directly, it is preferred over one that requires conversion.
- * As soon as the function finds such a printer, it returns it immediately.
+ * util/printer detaches the daemon and exits at once; only that short-lived
+ * launcher is our child.
+ */
+static void handle_printer_launcher_exit(int fd, uint32_t events, void *context) {
+    (void)events;
+    (void)context;
+    siginfo_t info;
+    if (waitid(P_PIDFD, (id_t)fd, &info, WEXITED | WNOHANG) < 0 && errno == EINTR) {
+        return;  // Still readable; try again on the next wakeup
+    }
+    event_loop_remove(fd);
+    close(fd);
+}
+
+/**
+ * @brief Starts a printer's daemon in the background if its socket does not exist.
  *
- * NOTE:
- *   - Matching is done using string comparison of file type names, not pointer equality,
- *     since different FILE_TYPE instances may exist for the same type name.
- *   - Only the first matching compatible IDLE printer is returned.
- *   - If no suitable printer is found, the function returns NULL.
+ * presi_connect_to_printer() does the same with system() followed by sleep(1)
+ * on the spooler's thread; here the launcher is spawned and left to the event
+ * loop, so enabling a printer returns at once.
  *
- * @param from_type A pointer to the FILE_TYPE struct representing the type of the input file.
- * @return A pointer to a compatible PRINTER in PRINTER_IDLE state, or NULL if none available.
+ * @return 0 if the daemon is running or being started, -1 if it could not be started.
  */
-PRINTER *select_compatible_printer(FILE_TYPE *from_type) {
-    // Reject null input — can't match if file type is unknown
-    if (!from_type) {
-        return NULL;
+static int start_printer_daemon(PRINTER *printer) {
+    struct sockaddr_un address;
+    struct stat socket_stat;
+    uint32_t bit = (uint32_t)1 << get_printer_id(printer);
+
+    printer_socket_address(printer, &address);
+    if (stat(address.sun_path, &socket_stat) == 0 || (started_printer_mask & bit)) {
+        return 0;
     }
 
-    // Iterate through all registered printers
-    for (int i = 0; i < get_printer_count(); i++) {
-        PRINTER *printer = get_printer_by_index(i);
+    char *argv[] = { PRINTER_PROGRAM, printer->name, printer->type->name, NULL };
+    char **stage_argv[] = { argv };
+    pid_t pid;
+    if (launch_pipeline(stage_argv, 1, "/dev/null", STDOUT_FILENO, &pid) < 0) {
+        return -1;
+    }
+    started_printer_mask |= bit;
+    started_at_ns[get_printer_id(printer)] = latency_now_ns();
 
-        // Skip invalid or uninitialized printer entries
-        if (!printer) {
-            continue;
+    int fd = pidfd_open(pid, 0);
+    if (fd < 0 || event_loop_add(fd, EPOLLIN, handle_printer_launcher_exit, NULL) < 0) {
+        if (fd >= 0) {
+            close(fd);
         }
+        waitpid(pid, NULL, 0);  // The launcher only forks the daemon, so this is brief
+    }
+    return 0;
+}
 
-        // Skip printers that are currently not available
-        if (printer->status != PRINTER_IDLE) {
-            continue;
-        }
+/**
+ * @brief Opens a close-on-exec socket connected to the given address, without waiting.
+ *
+ * The socket is non-blocking while it connects, so a daemon whose backlog is
+ * full makes connect() fail with EAGAIN instead of blocking the spooler. A
+ * Unix-domain connection is complete as soon as connect() returns, and the
+ * socket is then made blocking again: the last stage of a pipeline may write
+ * to it directly.
+ *
+ * @return The socket, or -1 with errno set.
+ */
+static int open_printer_socket(const struct sockaddr_un *address) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (const struct sockaddr *)address, sizeof(*address)) < 0 ||
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK) < 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
 
-        // Check for direct support (no conversion needed)
-        if (strcmp(printer->type->name, from_type->name) == 0) {
-            // The printer supports the file type natively
-            return printer;
-        }
+/**
+ * @brief Sets a printer's status, keeps idle_printer_mask in step and reports
+ * the new status through sf_printer_status().
+ */
+static void change_printer_status(PRINTER *printer, PRINTER_STATUS status) {
+    uint32_t bit = (uint32_t)1 << get_printer_id(printer);
+
+    printer->status = status;
+    if (status == PRINTER_IDLE) {
+        idle_printer_mask |= bit;
+    } else {
+        idle_printer_mask &= ~bit;
+    }
+
+    emit_printer_status(printer->name, status);
+}
+
+/**
+ * @brief Makes a printer available again. A printer that still has a job
+ * running (because it was disabled while busy) comes back as BUSY, not IDLE.
+ *
+ * The printer's daemon is started now, if it is not running yet, so that the
+ * first job dispatched to the printer does not have to wait for it.
+ *
+ * @param printer The printer to enable.
+ */
+void enable_printer(PRINTER *printer) {
+    uint32_t bit = (uint32_t)1 << get_printer_id(printer);
+    start_printer_daemon(printer);
+    change_printer_status(printer, (busy_printer_mask & bit) ? PRINTER_BUSY : PRINTER_IDLE);
+}
+
+/**
+ * @brief Takes a printer out of service. A job already running on it is left
+ * to finish, but the printer receives no new jobs until it is enabled again.
+ *
+ * @param printer The printer to disable.
+ */
+void disable_printer(PRINTER *printer) {
+    change_printer_status(printer, PRINTER_DISABLED);
+}
+
+/**
+ * @brief Records that a job has been started on an idle printer.
+ *
+ * @param printer The printer the job was dispatched to.
+ */
+void mark_printer_busy(PRINTER *printer) {
+    int id = get_printer_id(printer);
+    if (!(busy_printer_mask & ((uint32_t)1 << id))) {
+        busy_since_ns[id] = latency_now_ns();
+    }
+    busy_printer_mask |= (uint32_t)1 << id;
+    change_printer_status(printer, PRINTER_BUSY);
+}
+
+/**
+ * @brief Records that the job running on a printer has ended. The printer
+ * becomes IDLE unless it was disabled in the meantime.
+ *
+ * @param printer The printer the job was running on.
+ */
+void release_printer(PRINTER *printer) {
+    int id = get_printer_id(printer);
+    if (busy_printer_mask & ((uint32_t)1 << id)) {
+        busy_total_ns[id] += latency_now_ns() - busy_since_ns[id];
+    }
+    busy_printer_mask &= ~((uint32_t)1 << id);
+    if (printer->status == PRINTER_BUSY) {
+        change_printer_status(printer, PRINTER_IDLE);
+    }
+}
+
+/**
+ * @brief Returns the bitmask of printers that are currently IDLE.
+ */
+uint32_t get_idle_printer_mask(void) {
+    return idle_printer_mask;
+}
+
+/**
+ * @brief Returns the bitmask of printers able to print a file type, directly
+ * or through a conversion path, regardless of their current status.
+ *
+ * The mask for a type is computed once (one cached path lookup per printer)
+ * and then kept up to date as printers are added, until the conversions change.
+ *
+ * @param from_type The type of the file to be printed.
+ * @return The eligibility mask; bit i stands for the printer with ID i.
+ */
+uint32_t get_eligible_printer_mask(FILE_TYPE *from_type) {
+    if (!from_type || from_type->index < 0 || from_type->index >= MAX_FILE_TYPES) {
+        return 0;
+    }
 
-        // Check for a valid conversion path from input type to printer type
-        CONVERSION **path = find_conversion_path(from_type->name, printer->type->name);
-        if (path) {
-            // Free the temporary conversion path array
-            free(path);
-            // Return the first printer that can handle the type via conversion
-            return printer;
+    uint64_t type_bit = (uint64_t)1 << from_type->index;
+    if (!(eligibility_known & type_bit)) {
+        uint32_t mask = 0;
+        for (int i = 0; i < number_of_registered_printers; i++) {
+            if (lookup_conversion_path(from_type, printer_registry[i].type)) {
+                mask |= (uint32_t)1 << i;
+            }
         }
+        eligible_by_type[from_type->index] = mask;
+        eligibility_type[from_type->index] = from_type;
+        eligibility_known |= type_bit;
+    }
+    return eligible_by_type[from_type->index];
+}
+
+/**
+ * @brief Connects to a printer's socket (spool/<name>.sock) and sends the
+ * printer type header, as presi_connect_to_printer() does.
+ *
+ * presi_connect_to_printer() is written for a disposable pipeline process: it
+ * sleeps between attempts, and calls exit() when the connection is refused.
+ * Here a single attempt is made, which never waits: when the socket does not
+ * exist yet, the daemon is started (unless that was done less than
+ * PRINTER_START_MS ago) and the failure is returned, for the caller to try
+ * again from the timer wheel once the daemon listens.
+ *
+ * @param printer The printer to connect to.
+ * @return A close-on-exec connected socket, or -1 with errno set (ENOENT or
+ *         ECONNREFUSED while the daemon starts, EAGAIN if it is overloaded).
+ */
+int connect_to_printer(PRINTER *printer) {
+    struct sockaddr_un address;
+    printer_socket_address(printer, &address);
+
+    int id = get_printer_id(printer);
+    uint32_t bit = (uint32_t)1 << id;
+    if ((started_printer_mask & bit) && latency_now_ns() - started_at_ns[id] > (uint64_t)PRINTER_START_MS * 1000000u) {
+        started_printer_mask &= ~bit;  // Let a daemon that never came up be started again
+    }
+    if (start_printer_daemon(printer) < 0) {
+        return -1;
+    }
+    int fd = open_printer_socket(&address);
+    if (fd < 0) {
+        return -1;
+    }
 
-        // Otherwise, continue checking the next printer
+    // The printer expects its type on the first line; MSG_NOSIGNAL keeps a dead peer from raising SIGPIPE
+    size_t length = strlen(printer->type->name);
+    if (send(fd, printer->type->name, length, MSG_NOSIGNAL) != (ssize_t)length ||
+        send(fd, "\n", 1, MSG_NOSIGNAL) != 1) {
+        close(fd);
+        return -1;
     }
+    return fd;
+}
 
-    // No compatible printer found
-    return NULL;
+/**
+ * @brief Forgets all eligibility masks; call whenever the set of conversions changes.
+ */
+void invalidate_printer_eligibility(void) {
+    eligibility_known = 0;
+}
+
+/**
+ * @brief Copies each printer's name and status, and adds its current busy
+ * period, if any, to its busy time.
+ */
+void printer_manager_get_metrics(PRINTER_METRICS *metrics) {
+    uint64_t now = latency_now_ns();
+    metrics->count = number_of_registered_printers;
+    for (int i = 0; i < number_of_registered_printers; i++) {
+        metrics->printers[i].name = printer_registry[i].name;
+        metrics->printers[i].status = printer_registry[i].status;
+        metrics->printers[i].busy_ns = busy_total_ns[i];
+        if (busy_printer_mask & ((uint32_t)1 << i)) {
+            metrics->printers[i].busy_ns += now - busy_since_ns[i];
+        }
+        metrics->printers[i].declared_ns = now - declared_at_ns[i];
+    }
 }
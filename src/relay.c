@@ -0,0 +1,314 @@
+/**
+ * @file relay.c
+ * @brief Implements the sendfile()-based relay used for passthrough print jobs.
+ *
+ * The relay runs entirely inside the event loop: the output socket is
+ * non-blocking and watched for EPOLLOUT, and each wakeup sends at most
+ * RELAY_BUDGET bytes so that one large document cannot starve command input or
+ * other jobs. Pausing simply stops watching the socket, and so does a growing
+ * relay that has caught up with its producer, until relay_grow() is called.
+ *
+ * The checkpoint is sampled with SIOCOUTQ before and after every batch, when
+ * the relay stops watching the socket, and when the connection is found
+ * dropped: the data sent but still queued on the socket has not reached the
+ * printer. For a Unix socket the kernel reports the memory held by that data,
+ * headers included, which is a little more than its length, so the checkpoint
+ * errs on the side of sending a few bytes twice rather than losing any.
+ *
+ * Once the printer has closed its end, the data it had not read is freed and
+ * SIOCOUTQ drops to zero, so a sample is only kept if the socket shows no
+ * hangup after it was taken. The kernel flags the hangup before freeing that
+ * data, so a kept sample never counts unread data as delivered. What the
+ * printer read after the last kept sample is sent again on reconnection.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <linux/sockios.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+
+#include "relay.h"
+#include "event_loop.h"
+#include "latency_stats.h"
+
+/** @brief Maximum number of bytes sent per wakeup before yielding to the event loop. */
+#define RELAY_BUDGET (1 << 20)
+
+static void handle_relay_ready(int fd, uint32_t events, void *context);
+
+/**
+ * @brief Watches the socket exactly when the relay is neither paused nor
+ * waiting for its producer.
+ *
+ * @return 0 on success, -1 if the socket could not be registered.
+ */
+static int update_watch(RELAY *relay) {
+    int wanted = relay->out_fd >= 0 && !relay->paused && !relay->stalled;
+    if (wanted && !relay->watching) {
+        if (event_loop_add(relay->out_fd, EPOLLOUT, handle_relay_ready, relay) < 0) {
+            return -1;
+        }
+    } else if (!wanted && relay->watching) {
+        event_loop_remove(relay->out_fd);
+    }
+    relay->watching = wanted;
+    return 0;
+}
+
+/**
+ * @brief Closes the relay's descriptors and marks it inactive.
+ */
+static void close_relay(RELAY *relay) {
+    if (relay->out_fd >= 0) {
+        if (relay->watching) {
+            event_loop_remove(relay->out_fd);
+        }
+        close(relay->out_fd);
+    }
+    if (relay->in_fd >= 0) {
+        close(relay->in_fd);
+    }
+    relay->in_fd = relay->out_fd = -1;
+    relay->paused = relay->stalled = relay->watching = 0;
+}
+
+/**
+ * @brief Ends the relay and reports the outcome to its owner.
+ */
+static void finish_relay(RELAY *relay, int error) {
+    close_relay(relay);
+    relay->done(relay->context, error);
+}
+
+/**
+ * @brief Reports whether the printer has closed its end of the connection.
+ */
+static int peer_closed(int fd) {
+    struct pollfd item = { .fd = fd, .events = 0 };
+    return poll(&item, 1, 0) != 0 && (item.revents & (POLLHUP | POLLERR));
+}
+
+/**
+ * @brief Advances the checkpoint to the data the printer has read so far.
+ *
+ * The sample is discarded if the printer had already closed the connection
+ * when it was taken (see the file comment).
+ */
+static void update_checkpoint(RELAY *relay) {
+    int queued;
+    if (ioctl(relay->out_fd, SIOCOUTQ, &queued) == 0 && !peer_closed(relay->out_fd) &&
+        relay->offset - queued > relay->delivered) {
+        relay->delivered = relay->offset - queued;
+    }
+}
+
+/**
+ * @brief Drops a connection the printer has closed, keeping the file, and
+ * rewinds to the checkpoint so that relay_reattach() resends what was lost.
+ */
+static void detach_relay(RELAY *relay, int error) {
+    update_checkpoint(relay);  // Still valid if the printer only stopped reading
+    if (relay->watching) {
+        event_loop_remove(relay->out_fd);
+    }
+    close(relay->out_fd);
+    relay->out_fd = -1;
+    relay->watching = relay->stalled = 0;
+    relay->offset = relay->delivered;
+    relay->done(relay->context, error);
+}
+
+/**
+ * @brief Event loop callback: the socket can accept more data (or has failed).
+ *
+ * sendfile() returns 0 at end of file, which completes the relay. A growing
+ * relay instead stops at its limit: it completes there once relay_grow() has
+ * said the data is final, and otherwise stalls until more data is announced. A
+ * peer that has gone away shows up as EPIPE or ECONNRESET (SIGPIPE is ignored
+ * by the spooler); the relay is then detached rather than ended.
+ */
+static void handle_relay_ready(int fd, uint32_t events, void *context) {
+    (void)fd;
+    (void)events;
+    RELAY *relay = context;
+
+    update_checkpoint(relay);  // The printer may have read more since the last batch
+    size_t sent = 0;
+    while (sent < RELAY_BUDGET) {
+        size_t count = RELAY_BUDGET - sent;
+        if (relay->limit >= 0 && (off_t)count > relay->limit - relay->offset) {
+            count = (size_t)(relay->limit - relay->offset);
+        }
+        if (count == 0) {
+            if (!relay->growing) {
+                finish_relay(relay, 0);
+            } else {
+                update_checkpoint(relay);
+                relay->stalled = 1;  // Caught up; relay_grow() wakes us
+                update_watch(relay);
+            }
+            return;
+        }
+
+        ssize_t n = sendfile(relay->out_fd, relay->in_fd, &relay->offset, count);
+        if (n > 0) {
+            if (relay->first_sent_ns == 0) {
+                relay->first_sent_ns = latency_now_ns();
+            }
+            sent += (size_t)n;
+        } else if (n == 0) {
+            finish_relay(relay, 0);
+            return;
+        } else if (errno == EAGAIN) {
+            break;  // Socket full; wait for the next EPOLLOUT
+        } else if (errno == EPIPE || errno == ECONNRESET) {
+            detach_relay(relay, errno);
+            return;
+        } else if (errno != EINTR) {
+            finish_relay(relay, errno);
+            return;
+        }
+    }
+    update_checkpoint(relay);
+}
+
+/**
+ * @brief Prepares a relay for use; it starts out inactive.
+ */
+void relay_init(RELAY *relay) {
+    relay->in_fd = relay->out_fd = -1;
+    relay->offset = relay->delivered = 0;
+    relay->first_sent_ns = 0;
+    relay->limit = -1;
+    relay->growing = 0;
+    relay->paused = relay->stalled = relay->watching = 0;
+}
+
+/**
+ * @brief Common part of relay_start() and relay_start_growing().
+ */
+static int start_relay(RELAY *relay, int in_fd, int out_fd, off_t limit, int growing,
+                       relay_done_func_t *done, void *context) {
+    relay->in_fd = in_fd;
+    relay->out_fd = out_fd;
+    relay->offset = relay->delivered = 0;
+    relay->first_sent_ns = 0;
+    relay->limit = limit;
+    relay->growing = growing;
+    relay->paused = relay->stalled = relay->watching = 0;
+    relay->done = done;
+    relay->context = context;
+
+    if (out_fd < 0) {
+        return 0;  // Detached until relay_reattach()
+    }
+    int flags = fcntl(out_fd, F_GETFL);
+    if (flags < 0 || fcntl(out_fd, F_SETFL, flags | O_NONBLOCK) < 0 || update_watch(relay) < 0) {
+        close_relay(relay);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Switches the socket to non-blocking mode and starts watching it.
+ */
+int relay_start(RELAY *relay, int in_fd, int out_fd, relay_done_func_t *done, void *context) {
+    return start_relay(relay, in_fd, out_fd, -1, 0, done, context);
+}
+
+/**
+ * @brief Starts a relay with nothing to send yet; relay_grow() supplies the data.
+ */
+int relay_start_growing(RELAY *relay, int in_fd, int out_fd, relay_done_func_t *done, void *context) {
+    return start_relay(relay, in_fd, out_fd, 0, 1, done, context);
+}
+
+/**
+ * @brief Raises the limit of a growing relay and wakes it if it had caught up.
+ */
+void relay_grow(RELAY *relay, off_t limit, int final) {
+    if (!relay_is_active(relay) || !relay->growing) {
+        return;
+    }
+    relay->limit = limit;
+    relay->growing = !final;
+    if (relay->stalled) {  // A detached relay is never stalled
+        relay->stalled = 0;
+        update_watch(relay);  // EPOLLOUT fires at once, even if only to complete the relay
+    }
+}
+
+/**
+ * @brief Resumes a detached relay from its checkpoint on a new connection.
+ */
+int relay_reattach(RELAY *relay, int out_fd) {
+    if (!relay_is_detached(relay)) {
+        close(out_fd);
+        return -1;
+    }
+    relay->out_fd = out_fd;
+    int flags = fcntl(out_fd, F_GETFL);
+    if (flags < 0 || fcntl(out_fd, F_SETFL, flags | O_NONBLOCK) < 0 || update_watch(relay) < 0) {
+        close(out_fd);
+        relay->out_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Stops watching the socket; nothing more is sent until relay_resume().
+ */
+int relay_pause(RELAY *relay) {
+    if (!relay_is_active(relay) || relay->paused) {
+        return -1;
+    }
+    if (relay->out_fd >= 0) {
+        update_checkpoint(relay);
+    }
+    relay->paused = 1;
+    return update_watch(relay);
+}
+
+/**
+ * @brief Starts watching the socket again.
+ */
+int relay_resume(RELAY *relay) {
+    if (!relay_is_active(relay) || !relay->paused) {
+        return -1;
+    }
+    relay->paused = 0;
+    if (update_watch(relay) < 0) {
+        relay->paused = 1;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Closes an active relay without running its callback.
+ */
+void relay_cancel(RELAY *relay) {
+    if (relay_is_active(relay)) {
+        close_relay(relay);
+    }
+}
+
+/**
+ * @brief Reports whether the relay still owns its file.
+ */
+int relay_is_active(const RELAY *relay) {
+    return relay->in_fd >= 0;
+}
+
+/**
+ * @brief Reports whether the relay has lost its connection and awaits relay_reattach().
+ */
+int relay_is_detached(const RELAY *relay) {
+    return relay->in_fd >= 0 && relay->out_fd < 0;
+}
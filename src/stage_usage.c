@@ -0,0 +1,165 @@
+/**
+ * @file stage_usage.c
+ * @brief Implements the per-conversion resource accounting.
+ *
+ * Commands are told apart by their text, which takes formatting and a search
+ * of the accounted commands. Stages run the same few conversions over and
+ * over, so the slot found for each CONVERSION is kept in a small hash keyed
+ * by its address (conversions.h cannot be changed to hold it).
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/resource.h>
+
+#include "stage_usage.h"
+#include "conversions.h"
+
+/**
+ * @struct stage_usage
+ * @brief Resources used by every run of one conversion command.
+ */
+struct stage_usage {
+    char command[STAGE_USAGE_COMMAND_MAX]; ///< "from -> to: command args", possibly truncated.
+    unsigned long runs;      ///< Stages reaped.
+    uint64_t user_us;        ///< User CPU time, in microseconds.
+    uint64_t system_us;      ///< System CPU time, in microseconds.
+    long max_rss_kb;         ///< Largest resident set of any run, in kilobytes.
+    uint64_t in_blocks;      ///< Blocks read from the file system.
+    uint64_t out_blocks;     ///< Blocks written to the file system.
+};
+
+/** @brief Accounted commands, in order of first run. */
+static struct stage_usage usages[MAX_STAGE_USAGE];
+
+/** @brief Number of entries of usages in use. */
+static int usage_count = 0;
+
+/** @brief Entries of the slot hash; a power of two, kept at most half full. */
+#define SLOT_HASH_SIZE (2 * MAX_STAGE_USAGE)
+
+/**
+ * @struct slot_entry
+ * @brief The slot found for one conversion.
+ */
+struct slot_entry {
+    const CONVERSION *conversion;  ///< The conversion, or NULL if the entry is free.
+    int slot;                      ///< Its slot, possibly -1.
+};
+
+/** @brief Open-addressed (linear probing) hash from conversion address to slot. */
+static struct slot_entry slot_hash[SLOT_HASH_SIZE];
+
+/** @brief Number of entries of slot_hash in use. */
+static int slot_hash_count = 0;
+
+/**
+ * @brief Writes the key of a conversion: its types and its command line.
+ *
+ * A conversion can be redefined with another command, so the command is part
+ * of the key and each command gets its own totals.
+ */
+static void describe_conversion(const CONVERSION *conversion, char *buffer, size_t size) {
+    int length = snprintf(buffer, size, "%s -> %s:", conversion->from->name, conversion->to->name);
+    for (char **arg = conversion->cmd_and_args; *arg && length >= 0 && (size_t)length < size; arg++) {
+        length += snprintf(buffer + length, size - (size_t)length, " %s", *arg);
+    }
+}
+
+/**
+ * @brief Finds the slot of a command, creating it on its first run.
+ */
+static int find_slot(const CONVERSION *conversion) {
+    char command[STAGE_USAGE_COMMAND_MAX];
+    describe_conversion(conversion, command, sizeof(command));
+
+    for (int i = 0; i < usage_count; i++) {
+        if (strcmp(usages[i].command, command) == 0) {
+            return i;
+        }
+    }
+    if (usage_count == MAX_STAGE_USAGE) {
+        return -1;
+    }
+    memcpy(usages[usage_count].command, command, sizeof(command));
+    return usage_count++;
+}
+
+/**
+ * @brief Returns the hash entry of a conversion, or the free entry where it belongs.
+ */
+static struct slot_entry *slot_entry_of(const CONVERSION *conversion) {
+    uintptr_t key = (uintptr_t)conversion;
+    unsigned index = (unsigned)((key >> 4) * 0x9E3779B1u) & (SLOT_HASH_SIZE - 1);
+    while (slot_hash[index].conversion && slot_hash[index].conversion != conversion) {
+        index = (index + 1) & (SLOT_HASH_SIZE - 1);
+    }
+    return &slot_hash[index];
+}
+
+/**
+ * @brief Returns the remembered slot of a conversion, finding and remembering it on a miss.
+ */
+int stage_usage_slot(const CONVERSION *conversion) {
+    struct slot_entry *entry = slot_entry_of(conversion);
+    if (entry->conversion) {
+        return entry->slot;
+    }
+    int slot = find_slot(conversion);
+    if (slot_hash_count < SLOT_HASH_SIZE / 2) {
+        entry->conversion = conversion;
+        entry->slot = slot;
+        slot_hash_count++;
+    }
+    return slot;
+}
+
+void invalidate_stage_usage_slots(void) {
+    memset(slot_hash, 0, sizeof(slot_hash));
+    slot_hash_count = 0;
+}
+
+static uint64_t timeval_us(struct timeval tv) {
+    return (uint64_t)tv.tv_sec * 1000000u + (uint64_t)tv.tv_usec;
+}
+
+void stage_usage_record(int slot, const struct rusage *rusage) {
+    if (slot < 0 || slot >= usage_count) {
+        return;
+    }
+    struct stage_usage *usage = &usages[slot];
+    usage->runs++;
+    usage->user_us += timeval_us(rusage->ru_utime);
+    usage->system_us += timeval_us(rusage->ru_stime);
+    if (rusage->ru_maxrss > usage->max_rss_kb) {
+        usage->max_rss_kb = rusage->ru_maxrss;
+    }
+    usage->in_blocks += (uint64_t)rusage->ru_inblock;
+    usage->out_blocks += (uint64_t)rusage->ru_oublock;
+}
+
+const char *stage_usage_command(int slot) {
+    return (slot >= 0 && slot < usage_count) ? usages[slot].command : "conversion";
+}
+
+/**
+ * @brief Prints one line per command, CPU times in seconds and per run in milliseconds.
+ */
+void stage_usage_print(FILE *out) {
+    if (usage_count == 0) {
+        return;
+    }
+    fprintf(out, "%-40s %6s %9s %9s %10s %10s %10s %10s\n", "conversion", "runs", "user (s)", "sys (s)",
+            "cpu/run ms", "max rss kB", "blocks in", "blocks out");
+    for (int i = 0; i < usage_count; i++) {
+        const struct stage_usage *usage = &usages[i];
+        if (usage->runs == 0) {
+            continue;
+        }
+        uint64_t cpu_us = usage->user_us + usage->system_us;
+        fprintf(out, "  %-38s %6lu %9.3f %9.3f %10.3f %10ld %10llu %10llu\n", usage->command, usage->runs,
+                usage->user_us / 1e6, usage->system_us / 1e6, cpu_us / 1e3 / (double)usage->runs,
+                usage->max_rss_kb, (unsigned long long)usage->in_blocks, (unsigned long long)usage->out_blocks);
+    }
+}
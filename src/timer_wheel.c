@@ -0,0 +1,314 @@
+/**
+ * @file timer_wheel.c
+ * @brief Implements a hierarchical timer wheel on top of a timerfd.
+ *
+ * The wheel has TIMER_WHEEL_LEVELS levels of 64 slots. Level L covers ticks in
+ * units of 64^L, so a timer is filed in the lowest level whose span still
+ * contains its expiry tick and the current tick, and is moved down ("cascaded")
+ * when the wheel reaches the start of its slot. Scheduling and cancelling are
+ * constant time. Each level keeps a 64-bit occupancy mask, so the next tick that
+ * needs attention is found with a few bit operations and the timerfd is armed
+ * for exactly that tick instead of ticking periodically.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include "timer_wheel.h"
+#include "event_loop.h"
+
+/** @brief Number of wheel levels; four levels of 64 slots span 2^24 ticks (about 46 hours). */
+#define TIMER_WHEEL_LEVELS 4
+
+/** @brief log2 of the number of slots per level. */
+#define TIMER_WHEEL_BITS 6
+
+/** @brief Number of slots per level. */
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+
+/** @brief Marks "no tick pending" when computing the next tick to process. */
+#define NO_TICK UINT64_MAX
+
+/** @brief Timers filed in each slot of each level. */
+static TIMER *wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+
+/** @brief Bit s of occupied[L] is set whenever wheel[L][s] is non-empty. */
+static uint64_t occupied[TIMER_WHEEL_LEVELS];
+
+/** @brief Last tick the wheel has processed; timers are filed relative to it. */
+static uint64_t current_tick = 0;
+
+/** @brief Number of scheduled timers. */
+static int timer_count = 0;
+
+/** @brief The timerfd driving the wheel, or -1 before initialization. */
+static int timer_fd = -1;
+
+/**
+ * @brief Returns the current CLOCK_MONOTONIC time in milliseconds.
+ */
+static uint64_t now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Returns the current CLOCK_MONOTONIC time in ticks, rounded down.
+ */
+static uint64_t now_tick(void) {
+    return now_ms() / TIMER_TICK_MS;
+}
+
+/**
+ * @brief Returns digit L of a tick, i.e. its slot index within level L.
+ */
+static int tick_digit(uint64_t tick, int level) {
+    return (int)((tick >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1));
+}
+
+/**
+ * @brief Files a timer in the slot matching its expiry tick.
+ *
+ * The level is the lowest one at which the expiry tick and the current tick
+ * fall into the same span of the next level up. Timers too far away for the
+ * top level are filed by their top digit and re-filed when that slot cascades.
+ */
+static void link_timer(TIMER *timer) {
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 &&
+           (timer->expires >> (TIMER_WHEEL_BITS * (level + 1))) !=
+           (current_tick >> (TIMER_WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    int slot = tick_digit(timer->expires, level);
+
+    timer->level = level;
+    timer->slot = slot;
+    timer->prev = NULL;
+    timer->next = wheel[level][slot];
+    if (timer->next) {
+        timer->next->prev = timer;
+    }
+    wheel[level][slot] = timer;
+    occupied[level] |= (uint64_t)1 << slot;
+}
+
+/**
+ * @brief Removes a timer from its slot.
+ */
+static void unlink_timer(TIMER *timer) {
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        wheel[timer->level][timer->slot] = timer->next;
+    }
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+    if (!wheel[timer->level][timer->slot]) {
+        occupied[timer->level] &= ~((uint64_t)1 << timer->slot);
+    }
+    timer->next = timer->prev = NULL;
+    timer->level = -1;
+}
+
+/**
+ * @brief Finds the next tick after current_tick on which a slot has to be
+ * fired (level 0) or cascaded (higher levels).
+ *
+ * @return That tick, or NO_TICK if no timers are scheduled.
+ */
+static uint64_t next_pending_tick(void) {
+    uint64_t next = NO_TICK;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        if (!occupied[level]) {
+            continue;
+        }
+        int digit = tick_digit(current_tick, level);
+        uint64_t later = (digit == TIMER_WHEEL_SLOTS - 1) ? 0 : occupied[level] & (~(uint64_t)0 << (digit + 1));
+        int steps = later ? ffsll((long long)later) - 1 - digit
+                          : ffsll((long long)occupied[level]) - 1 + TIMER_WHEEL_SLOTS - digit;
+        uint64_t tick = ((current_tick >> (TIMER_WHEEL_BITS * level)) + (uint64_t)steps) << (TIMER_WHEEL_BITS * level);
+        if (tick < next) {
+            next = tick;
+        }
+    }
+    return next;
+}
+
+/**
+ * @brief Arms the timerfd for the next pending tick, or disarms it if there is none.
+ */
+static void arm_timer_fd(void) {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+
+    uint64_t tick = next_pending_tick();
+    if (tick != NO_TICK) {
+        uint64_t ms = tick * TIMER_TICK_MS;
+        spec.it_value.tv_sec = (time_t)(ms / 1000);
+        spec.it_value.tv_nsec = (long)(ms % 1000) * 1000000;
+        if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+            spec.it_value.tv_nsec = 1;  // An all-zero value would disarm the timer
+        }
+    }
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+/**
+ * @brief Processes one tick: cascades the higher-level slots that start on it,
+ * then fires every timer in its level-0 slot.
+ */
+static void process_tick(uint64_t tick) {
+    current_tick = tick;
+
+    for (int level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+        if (tick & (((uint64_t)1 << (TIMER_WHEEL_BITS * level)) - 1)) {
+            continue;  // The tick is not the start of a slot at this level
+        }
+        int slot = tick_digit(tick, level);
+        TIMER *timer = wheel[level][slot];
+        wheel[level][slot] = NULL;
+        occupied[level] &= ~((uint64_t)1 << slot);
+        while (timer) {
+            TIMER *next = timer->next;
+            link_timer(timer);
+            timer = next;
+        }
+    }
+
+    int slot = tick_digit(tick, 0);
+    TIMER *timer;
+    while ((timer = wheel[0][slot]) != NULL) {
+        unlink_timer(timer);
+        timer_count--;
+        timer->callback(timer->context);
+    }
+}
+
+/**
+ * @brief Event loop callback for the timerfd: runs every timer that is due.
+ */
+static void handle_timer_expiry(int fd, uint32_t events, void *context) {
+    (void)events;
+    (void)context;
+
+    uint64_t expirations;
+    if (read(fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+        return;
+    }
+
+    uint64_t now = now_tick();
+    uint64_t tick;
+    while ((tick = next_pending_tick()) != NO_TICK && tick <= now) {
+        process_tick(tick);
+    }
+    // No occupied slot starts before `now`, so skipping ahead does not strand any timer
+    if (now > current_tick) {
+        current_tick = now;
+    }
+    arm_timer_fd();
+}
+
+/**
+ * @brief Creates the timerfd and registers it with the event loop.
+ *
+ * @return 0 on success or if already initialized, -1 on failure.
+ */
+int timer_wheel_initialize(void) {
+    if (timer_fd >= 0) {
+        return 0;
+    }
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd < 0) {
+        return -1;
+    }
+    if (event_loop_add(timer_fd, EPOLLIN, handle_timer_expiry, NULL) < 0) {
+        close(timer_fd);
+        timer_fd = -1;
+        return -1;
+    }
+    current_tick = now_tick();
+    return 0;
+}
+
+/**
+ * @brief Unschedules every timer and closes the timerfd.
+ */
+void timer_wheel_cleanup(void) {
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            while (wheel[level][slot]) {
+                unlink_timer(wheel[level][slot]);
+            }
+        }
+    }
+    timer_count = 0;
+    if (timer_fd >= 0) {
+        event_loop_remove(timer_fd);
+        close(timer_fd);
+        timer_fd = -1;
+    }
+}
+
+/**
+ * @brief Prepares a timer for use. The timer starts out unscheduled.
+ */
+void timer_wheel_init_timer(TIMER *timer, timer_callback_func_t *callback, void *context) {
+    memset(timer, 0, sizeof(*timer));
+    timer->callback = callback;
+    timer->context = context;
+    timer->level = -1;
+}
+
+/**
+ * @brief Schedules a timer delay_ms from now (rounded up to whole ticks).
+ *
+ * current_tick may lag behind the clock while nothing is due; filing relative
+ * to it is still correct because the expiry tick is always later than it.
+ */
+void timer_wheel_schedule(TIMER *timer, uint64_t delay_ms) {
+    timer_wheel_cancel(timer);
+
+    if (timer_count == 0) {
+        current_tick = now_tick();  // Nothing is filed, so the wheel may jump to the present
+    }
+
+    // Round the deadline up so the timer never fires early
+    uint64_t expires = (now_ms() + delay_ms + TIMER_TICK_MS) / TIMER_TICK_MS;
+    timer->expires = (expires > current_tick) ? expires : current_tick + 1;
+
+    uint64_t before = next_pending_tick();
+    link_timer(timer);
+    timer_count++;
+    if (timer_fd >= 0 && next_pending_tick() != before) {
+        arm_timer_fd();
+    }
+}
+
+/**
+ * @brief Unschedules a timer. Does nothing if the timer is not scheduled.
+ */
+void timer_wheel_cancel(TIMER *timer) {
+    if (timer->level < 0) {
+        return;
+    }
+    unlink_timer(timer);
+    timer_count--;
+    // A stale arming only causes one spurious wakeup, which re-arms correctly
+}
+
+/**
+ * @brief Reports whether a timer is currently scheduled.
+ */
+int timer_wheel_is_scheduled(const TIMER *timer) {
+    return timer->level >= 0;
+}
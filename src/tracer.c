@@ -0,0 +1,298 @@
+/**
+ * @file tracer.c
+ * @brief Implements the trace-event tracer.
+ *
+ * Each thread's buffer is a single-producer, single-consumer ring of
+ * fixed-size records: the thread advances head after filling a record, and
+ * the writer thread advances tail after formatting it, so neither ever takes
+ * a lock. A thread claims its buffer the first time it records something.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "tracer.h"
+#include "latency_stats.h"
+
+/**
+ * @struct trace_record
+ * @brief One span, or the name of a process if end_ns is 0.
+ */
+struct trace_record {
+    uint64_t start_ns;          ///< Start of the span.
+    uint64_t end_ns;            ///< End of the span, or 0 for a process name.
+    int32_t process;            ///< Trace process.
+    int32_t thread;             ///< Trace thread within the process.
+    char name[TRACE_NAME_MAX];  ///< Name of the span or of the process.
+};
+
+/**
+ * @struct trace_buffer
+ * @brief The records of one thread that the writer has not formatted yet.
+ */
+struct trace_buffer {
+    struct trace_record records[TRACE_BUFFER_RECORDS];
+    uint32_t head;       ///< Records filled; written by the owning thread only.
+    uint32_t tail;       ///< Records formatted; written by the writer only.
+    uint64_t dropped;    ///< Records lost because the buffer was full.
+};
+
+/** @brief Buffers of the threads that have recorded something, in order of first record. */
+static struct trace_buffer buffers[TRACE_MAX_THREADS];
+
+/** @brief Number of buffers claimed; may exceed TRACE_MAX_THREADS, in which case the rest have none. */
+static int claimed_buffers = 0;
+
+/** @brief Records lost by threads that found no buffer left. */
+static uint64_t unbuffered_dropped = 0;
+
+/** @brief Index of the calling thread's buffer plus one, 0 before its first record, or -1 if it has none. */
+static __thread int thread_buffer = 0;
+
+/** @brief Nonzero once tracing has started. */
+static int tracing = 0;
+
+/** @brief The trace file, written by the writer thread (and at exit, once it has stopped). */
+static FILE *trace_file;
+
+/** @brief latency_now_ns() when tracing started; the trace's timestamps count from it. */
+static uint64_t trace_epoch_ns;
+
+/** @brief Records dropped as of the last counter event written. */
+static uint64_t reported_dropped = 0;
+
+/** @brief Wakes the writer early when it is to stop. */
+static pthread_mutex_t writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_wakeup = PTHREAD_COND_INITIALIZER;
+static int writer_stopping = 0;
+static pthread_t writer_thread;
+
+/**
+ * @brief Returns a free record of the calling thread's buffer, or NULL if it
+ * is full (or the thread has none), counting the record as dropped.
+ *
+ * The record becomes visible to the writer with commit_record().
+ */
+static struct trace_record *reserve_record(struct trace_buffer **owner) {
+    if (thread_buffer == 0) {
+        int index = __atomic_fetch_add(&claimed_buffers, 1, __ATOMIC_ACQ_REL);
+        thread_buffer = (index < TRACE_MAX_THREADS) ? index + 1 : -1;
+    }
+    if (thread_buffer < 0) {
+        __atomic_fetch_add(&unbuffered_dropped, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    struct trace_buffer *buffer = &buffers[thread_buffer - 1];
+    uint32_t head = buffer->head;
+    if (head - __atomic_load_n(&buffer->tail, __ATOMIC_ACQUIRE) == TRACE_BUFFER_RECORDS) {
+        __atomic_fetch_add(&buffer->dropped, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    *owner = buffer;
+    return &buffer->records[head & (TRACE_BUFFER_RECORDS - 1)];
+}
+
+static void commit_record(struct trace_buffer *buffer) {
+    __atomic_store_n(&buffer->head, buffer->head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Copies a name into a record, truncated at a character boundary.
+ */
+static void copy_name(char *destination, const char *name) {
+    size_t length = strnlen(name, TRACE_NAME_MAX - 1);
+    if (name[length] != '\0') {
+        while (length > 0 && ((unsigned char)name[length] & 0xC0) == 0x80) {
+            length--;  // Do not split a UTF-8 sequence
+        }
+    }
+    memcpy(destination, name, length);
+    destination[length] = '\0';
+}
+
+void trace_span(int process, int thread, const char *name, uint64_t start_ns, uint64_t end_ns) {
+    if (!tracing) {
+        return;
+    }
+    struct trace_buffer *buffer;
+    struct trace_record *record = reserve_record(&buffer);
+    if (!record) {
+        return;
+    }
+    record->start_ns = start_ns;
+    record->end_ns = (end_ns > start_ns) ? end_ns : start_ns + 1;
+    record->process = process;
+    record->thread = thread;
+    copy_name(record->name, name);
+    commit_record(buffer);
+}
+
+void trace_process_name(int process, const char *name) {
+    if (!tracing) {
+        return;
+    }
+    struct trace_buffer *buffer;
+    struct trace_record *record = reserve_record(&buffer);
+    if (!record) {
+        return;
+    }
+    record->start_ns = record->end_ns = 0;
+    record->process = process;
+    record->thread = 0;
+    copy_name(record->name, name);
+    commit_record(buffer);
+}
+
+/**
+ * @brief Writes a string as the contents of a JSON string.
+ */
+static void write_json_string(const char *text) {
+    for (const unsigned char *c = (const unsigned char *)text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', trace_file);
+            fputc(*c, trace_file);
+        } else if (*c < 0x20) {
+            fprintf(trace_file, "\\u%04x", *c);
+        } else {
+            fputc(*c, trace_file);
+        }
+    }
+}
+
+/**
+ * @brief Converts a timestamp to the trace's microseconds.
+ */
+static double trace_us(uint64_t ns) {
+    return (double)(int64_t)(ns - trace_epoch_ns) / 1e3;
+}
+
+/**
+ * @brief Writes one record as a complete ("X") or metadata ("M") event.
+ *
+ * Every event follows an earlier one (the file starts with the scheduler's
+ * name), so each is preceded by its separator.
+ */
+static void write_record(const struct trace_record *record) {
+    fputs(",\n{\"name\":\"", trace_file);
+    if (record->end_ns == 0) {
+        fprintf(trace_file, "process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"", (int)record->process);
+        write_json_string(record->name);
+        fputs("\"}}", trace_file);
+        return;
+    }
+    write_json_string(record->name);
+    fprintf(trace_file, "\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", (int)record->process,
+            (int)record->thread, trace_us(record->start_ns), (double)(record->end_ns - record->start_ns) / 1e3);
+}
+
+/**
+ * @brief Formats and writes every pending record, then the number of records
+ * dropped so far if it has grown.
+ *
+ * Only ever runs on one thread at a time: the writer, or the exit handler once
+ * the writer has stopped.
+ */
+static void flush_buffers(void) {
+    int count = __atomic_load_n(&claimed_buffers, __ATOMIC_ACQUIRE);
+    if (count > TRACE_MAX_THREADS) {
+        count = TRACE_MAX_THREADS;
+    }
+
+    uint64_t dropped = __atomic_load_n(&unbuffered_dropped, __ATOMIC_RELAXED);
+    for (int i = 0; i < count; i++) {
+        struct trace_buffer *buffer = &buffers[i];
+        uint32_t head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+        uint32_t tail = buffer->tail;
+        for (; tail != head; tail++) {
+            write_record(&buffer->records[tail & (TRACE_BUFFER_RECORDS - 1)]);
+        }
+        __atomic_store_n(&buffer->tail, tail, __ATOMIC_RELEASE);
+        dropped += __atomic_load_n(&buffer->dropped, __ATOMIC_RELAXED);
+    }
+
+    if (dropped != reported_dropped) {
+        fprintf(trace_file, ",\n{\"name\":\"dropped records\",\"ph\":\"C\",\"pid\":%d,\"ts\":%.3f,"
+                "\"args\":{\"records\":%llu}}", TRACE_SCHEDULER_PROCESS, trace_us(latency_now_ns()),
+                (unsigned long long)dropped);
+        reported_dropped = dropped;
+    }
+    fflush(trace_file);
+}
+
+/**
+ * @brief Writer thread: flushes the buffers every TRACE_FLUSH_MS until asked to stop.
+ */
+static void *run_writer(void *argument) {
+    (void)argument;
+    pthread_mutex_lock(&writer_mutex);
+    while (!writer_stopping) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += (long)TRACE_FLUSH_MS * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&writer_wakeup, &writer_mutex, &deadline);
+
+        pthread_mutex_unlock(&writer_mutex);
+        flush_buffers();
+        pthread_mutex_lock(&writer_mutex);
+    }
+    pthread_mutex_unlock(&writer_mutex);
+    return NULL;
+}
+
+/**
+ * @brief Exit handler: stops the writer, writes the last records and closes the array.
+ */
+static void stop_tracer(void) {
+    pthread_mutex_lock(&writer_mutex);
+    writer_stopping = 1;
+    pthread_cond_signal(&writer_wakeup);
+    pthread_mutex_unlock(&writer_mutex);
+    pthread_join(writer_thread, NULL);
+
+    tracing = 0;
+    flush_buffers();
+    fputs("\n]\n", trace_file);
+    fclose(trace_file);
+}
+
+int tracer_start(void) {
+    if (!getenv(TRACE_ENV) || tracing) {
+        return 0;
+    }
+
+    mkdir("spool", 0777);
+    trace_file = fopen(TRACE_PATH, "w");
+    if (!trace_file) {
+        return -1;
+    }
+    trace_epoch_ns = latency_now_ns();
+    fprintf(trace_file, "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"scheduler\"}}",
+            TRACE_SCHEDULER_PROCESS);
+    fflush(trace_file);
+
+    // The thread must not take signals meant for the main loop (SIGCHLD is read from a signalfd)
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    int error = pthread_create(&writer_thread, NULL, run_writer, NULL);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (error != 0) {
+        fclose(trace_file);
+        trace_file = NULL;
+        errno = error;
+        return -1;
+    }
+
+    tracing = 1;
+    atexit(stop_tracer);
+    return 0;
+}
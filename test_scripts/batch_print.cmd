@@ -0,0 +1,7 @@
+type aaa
+type bbb
+printer Alice bbb
+conversion aaa bbb util/convert aaa bbb
+enable Alice
+print test_scripts/testfile.aaa
+print test_scripts/pages.aaa
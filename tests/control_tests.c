@@ -0,0 +1,112 @@
+#include <criterion/criterion.h>
+#include <criterion/logging.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "control_socket.h"
+
+/*
+ * Tests of the control protocol, against a spooler started with CONTROL_ENV
+ * set: pipelined requests are answered in order, and a frame longer than
+ * CONTROL_MAX_PAYLOAD is refused and ends the connection.
+ */
+
+#define SUITE control_suite
+#define SPOOLER "(echo type aaa; sleep 2; echo quit) | " CONTROL_ENV "=1 bin/presi 2>&1"
+#define SUBMITTED_FILE "test_scripts/testfile.aaa"
+
+static int connect_control(void) {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    strncpy(address.sun_path, CONTROL_SOCKET_PATH, sizeof(address.sun_path) - 1);
+    for (int tries = 0; tries < 100; tries++) {  // Until the spooler has opened the socket
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        cr_assert_geq(fd, 0, "Cannot create a socket");
+        if (connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0) {
+            struct timeval timeout = { 2, 0 };
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            return fd;
+        }
+        close(fd);
+        nanosleep(&(struct timespec){ 0, 10000000 }, NULL);
+    }
+    cr_assert_fail("Cannot connect to the control socket");
+    return -1;
+}
+
+/* Appends a request to a frame buffer; payload may be shorter than length. */
+static size_t add_request(char *frame, size_t used, uint16_t opcode, uint32_t tag, const void *payload,
+                          uint32_t length, uint32_t sent) {
+    CONTROL_HEADER header = { .length = length, .tag = tag, .opcode = opcode, .status = 0 };
+    memcpy(frame + used, &header, sizeof(header));
+    memcpy(frame + used + sizeof(header), payload, sent);
+    return used + sizeof(header) + sent;
+}
+
+static void read_exactly(int fd, void *buffer, size_t length) {
+    char *p = buffer;
+    while (length > 0) {
+        ssize_t n = read(fd, p, length);
+        cr_assert_gt(n, 0, "The response was cut short");
+        p += n;
+        length -= (size_t)n;
+    }
+}
+
+/* Reads the next response, checks its tag, opcode and status, and returns its payload length. */
+static uint32_t expect_response(int fd, uint32_t tag, uint16_t opcode, uint16_t status, char *payload) {
+    CONTROL_HEADER header;
+    read_exactly(fd, &header, sizeof(header));
+    cr_assert_eq(header.tag, tag, "Responses out of order");
+    cr_assert_eq(header.opcode, opcode, "Wrong opcode in the response");
+    cr_assert_eq(header.status, status, "Wrong status in the response");
+    cr_assert_leq(header.length, CONTROL_MAX_PAYLOAD, "Response too long");
+    read_exactly(fd, payload, header.length);
+    return header.length;
+}
+
+Test(SUITE, pipelined_requests_test, .timeout = 10)
+{
+    unlink(CONTROL_SOCKET_PATH);
+    FILE *spooler = popen(SPOOLER, "r");
+    cr_assert_not_null(spooler, "Cannot start the spooler");
+    int fd = connect_control();
+
+    // Every request is sent before any response is read
+    static char frame[4 * sizeof(CONTROL_HEADER) + CONTROL_MAX_PAYLOAD];
+    int32_t job_id = 0;
+    size_t used = add_request(frame, 0, CONTROL_SUBMIT, 1, SUBMITTED_FILE, strlen(SUBMITTED_FILE),
+                              strlen(SUBMITTED_FILE));
+    used = add_request(frame, used, CONTROL_QUERY, 2, &job_id, sizeof(job_id), sizeof(job_id));
+    used = add_request(frame, used, CONTROL_CANCEL, 3, &job_id, 2, 2);
+    used = add_request(frame, used, CONTROL_QUERY, 4, &job_id, CONTROL_MAX_PAYLOAD + 1, sizeof(job_id));
+    cr_assert_eq(write(fd, frame, used), (ssize_t)used, "Cannot send the requests");
+
+    static char payload[CONTROL_MAX_PAYLOAD];
+    cr_assert_eq(expect_response(fd, 1, CONTROL_SUBMIT, CONTROL_OK, payload), sizeof(int32_t),
+                 "Wrong submit response");
+    memcpy(&job_id, payload, sizeof(job_id));
+    cr_assert_eq(job_id, 0, "Wrong job ID");
+
+    uint32_t length = expect_response(fd, 2, CONTROL_QUERY, CONTROL_OK, payload);
+    CONTROL_JOB_INFO info;
+    cr_assert_geq(length, sizeof(info), "Query response too short");
+    memcpy(&info, payload, sizeof(info));
+    cr_assert_eq(info.job_id, 0, "The query reports another job");
+    cr_assert_eq(info.printer_id, -1, "The job has a printer, but there is none");
+    cr_assert_eq(length - sizeof(info), strlen(SUBMITTED_FILE), "Wrong path length");
+    cr_assert(memcmp(payload + sizeof(info), SUBMITTED_FILE, strlen(SUBMITTED_FILE)) == 0, "Wrong path");
+
+    expect_response(fd, 3, CONTROL_CANCEL, CONTROL_BAD_REQUEST, payload);
+
+    // The oversize frame is refused, and nothing after its header is read
+    expect_response(fd, 4, CONTROL_QUERY, CONTROL_BAD_REQUEST, payload);
+    cr_assert_eq(read(fd, payload, 1), 0, "The connection stayed open after an oversize frame");
+    close(fd);
+
+    cr_assert_eq(pclose(spooler), 0, "The spooler did not exit properly");
+}
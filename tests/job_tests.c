@@ -1,6 +1,10 @@
 #include <criterion/criterion.h>
 #include <criterion/logging.h>
+#include <glob.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <sys/time.h>
 
 #include "driver.h"
@@ -41,3 +45,317 @@ Test(SUITE, TEST_NAME, .init=test_setup, .fini = test_teardown, .timeout = 5)
 #undef cancel_cmd
 #undef TEST_NAME
 
+
+/*---------------------------test job id survives deletion----------------------*/
+/* Once job 0 has been deleted, the next job must still be addressable by its own
+   ID (1), not by its position in the job table.
+*/
+#define TEST_NAME cancel_after_delete_test
+#define type_cmd "type aaa"
+#define print_cmd "print test_scripts/testfile.aaa"
+#define cancel_first_cmd "cancel 0"
+#define cancel_second_cmd "cancel 1"
+static COMMAND SCRIPT(TEST_NAME)[] = {
+    // send,                expect,                     modifiers,                      timeout,    before,    after
+    {  NULL,                INIT_EVENT,                 0,                              HND_MSEC,   NULL,      NULL },
+    {  type_cmd,            TYPE_DEFINED_EVENT,         EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  print_cmd,           JOB_CREATED_EVENT,          EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  cancel_first_cmd,    JOB_ABORTED_EVENT,          EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  "jobs",              JOB_DELETED_EVENT,          EXPECT_SKIP_OTHER | DELAY_15SEC, HND_MSEC,  NULL,      NULL },
+    {  print_cmd,           JOB_CREATED_EVENT,          EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  cancel_second_cmd,   JOB_ABORTED_EVENT,          EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  "quit",              FINI_EVENT,                 EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  NULL,                EOF_EVENT,                  0,                              TEN_MSEC,   NULL,      NULL }
+};
+
+Test(SUITE, TEST_NAME, .init=test_setup, .fini = test_teardown, .timeout = 25)
+{
+    int err, status;
+    char *name = QUOTE(SUITE)"/"QUOTE(TEST_NAME);
+    char *argv[] = {TEST_EXECUTABLE, NULL};
+    err = run_test(name, argv[0], argv, SCRIPT(TEST_NAME), &status);
+    assert_proper_exit_status(err, status);
+}
+#undef type_cmd
+#undef print_cmd
+#undef cancel_first_cmd
+#undef cancel_second_cmd
+#undef TEST_NAME
+
+
+/*---------------------------test idle expiry-----------------------------------*/
+/* A terminated job must be deleted when its 10-second retention period ends,
+   even if no further command is entered.
+*/
+#define TEST_NAME idle_expiry_test
+#define type_cmd "type aaa"
+#define print_cmd "print test_scripts/testfile.aaa"
+#define cancel_cmd "cancel 0"
+static COMMAND SCRIPT(TEST_NAME)[] = {
+    // send,                expect,                     modifiers,                      timeout,    before,    after
+    {  NULL,                INIT_EVENT,                 0,                              HND_MSEC,   NULL,      NULL },
+    {  type_cmd,            TYPE_DEFINED_EVENT,         EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  print_cmd,           JOB_CREATED_EVENT,          EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  cancel_cmd,          JOB_ABORTED_EVENT,          EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  NULL,                JOB_DELETED_EVENT,          EXPECT_SKIP_OTHER,              { 11, 0 }, NULL,      NULL },
+    {  "quit",              FINI_EVENT,                 EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  NULL,                EOF_EVENT,                  0,                              TEN_MSEC,   NULL,      NULL }
+};
+
+Test(SUITE, TEST_NAME, .init=test_setup, .fini = test_teardown, .timeout = 20)
+{
+    int err, status;
+    char *name = QUOTE(SUITE)"/"QUOTE(TEST_NAME);
+    char *argv[] = {TEST_EXECUTABLE, NULL};
+    err = run_test(name, argv[0], argv, SCRIPT(TEST_NAME), &status);
+    assert_proper_exit_status(err, status);
+}
+#undef type_cmd
+#undef print_cmd
+#undef cancel_cmd
+#undef TEST_NAME
+
+
+/*---------------------------test cached reprint-------------------------------*/
+/* Printing the same file through the same conversion twice must finish both jobs;
+   the second one is served from the output cache.
+*/
+/* A job served from the cache is relayed by the spooler itself, which reports
+   its pipeline as a single "cat", instead of running the conversion again. */
+static void assert_served_from_cache(EVENT *ep, int *env, void *args) {
+    cr_assert_str_eq(ep->path[0], "cat", "Job %d ran '%s' instead of being served from the output cache",
+                     ep->jobid, ep->path[0]);
+    cr_assert_str_eq(ep->path[1], "", "Job %d ran a pipeline instead of being served from the output cache",
+                     ep->jobid);
+}
+
+#define TEST_NAME cached_reprint_test
+#define type1_cmd "type aaa"
+#define type2_cmd "type bbb"
+#define printer_cmd "printer Alice bbb"
+#define conversion_cmd "conversion aaa bbb util/convert aaa bbb"
+#define enable_cmd "enable Alice"
+#define print_cmd "print test_scripts/testfile.aaa"
+static COMMAND SCRIPT(TEST_NAME)[] = {
+    // send,                expect,                     modifiers,                      timeout,    before,    after
+    {  NULL,                INIT_EVENT,                 0,                              HND_MSEC,   NULL,      NULL },
+    {  type1_cmd,           TYPE_DEFINED_EVENT,         EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  type2_cmd,           TYPE_DEFINED_EVENT,         EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  printer_cmd,         PRINTER_DEFINED_EVENT,      EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  conversion_cmd,      CONVERSION_DEFINED_EVENT,   EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  enable_cmd,          PRINTER_STATUS_EVENT,       EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  print_cmd,           JOB_FINISHED_EVENT,         EXPECT_SKIP_OTHER,              ZERO_SEC,   NULL,      NULL },
+    {  print_cmd,           JOB_STARTED_EVENT,          EXPECT_SKIP_OTHER,              ZERO_SEC,   NULL,      assert_served_from_cache },
+    {  NULL,                JOB_FINISHED_EVENT,         EXPECT_SKIP_OTHER,              ZERO_SEC,   NULL,      NULL },
+    {  "quit",              FINI_EVENT,                 EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  NULL,                EOF_EVENT,                  0,                              TEN_MSEC,   NULL,      NULL }
+};
+
+Test(SUITE, TEST_NAME, .init=test_setup, .fini = test_teardown, .timeout = 10)
+{
+    int err, status;
+    char *name = QUOTE(SUITE)"/"QUOTE(TEST_NAME);
+    char *argv[] = {TEST_EXECUTABLE, NULL};
+    err = run_test(name, argv[0], argv, SCRIPT(TEST_NAME), &status);
+    assert_proper_exit_status(err, status);
+}
+#undef type1_cmd
+#undef type2_cmd
+#undef printer_cmd
+#undef conversion_cmd
+#undef enable_cmd
+#undef print_cmd
+#undef TEST_NAME
+
+/*---------------------------test copies to printers---------------------------*/
+/* Printing one copy on each of two printers through a single conversion must
+   finish both jobs.
+*/
+#define TEST_NAME copies_to_test
+#define type1_cmd "type aaa"
+#define type2_cmd "type bbb"
+#define printer1_cmd "printer Alice bbb"
+#define printer2_cmd "printer Bob bbb"
+#define conversion_cmd "conversion aaa bbb util/convert aaa bbb"
+#define enable1_cmd "enable Alice"
+#define enable2_cmd "enable Bob"
+#define print_cmd "print test_scripts/testfile.aaa --copies-to Alice,Bob"
+static COMMAND SCRIPT(TEST_NAME)[] = {
+    // send,                expect,                     modifiers,                      timeout,    before,    after
+    {  NULL,                INIT_EVENT,                 0,                              HND_MSEC,   NULL,      NULL },
+    {  type1_cmd,           TYPE_DEFINED_EVENT,         EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  type2_cmd,           TYPE_DEFINED_EVENT,         EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  printer1_cmd,        PRINTER_DEFINED_EVENT,      EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  printer2_cmd,        PRINTER_DEFINED_EVENT,      EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  conversion_cmd,      CONVERSION_DEFINED_EVENT,   EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  enable1_cmd,         PRINTER_STATUS_EVENT,       EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  enable2_cmd,         PRINTER_STATUS_EVENT,       EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  print_cmd,           JOB_FINISHED_EVENT,         EXPECT_SKIP_OTHER,              ZERO_SEC,   NULL,      NULL },
+    {  NULL,                JOB_FINISHED_EVENT,         EXPECT_SKIP_OTHER,              ZERO_SEC,   NULL,      NULL },
+    {  "quit",              FINI_EVENT,                 EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  NULL,                EOF_EVENT,                  0,                              TEN_MSEC,   NULL,      NULL }
+};
+
+Test(SUITE, TEST_NAME, .init=test_setup, .fini = test_teardown, .timeout = 10)
+{
+    int err, status;
+    char *name = QUOTE(SUITE)"/"QUOTE(TEST_NAME);
+    char *argv[] = {TEST_EXECUTABLE, NULL};
+    err = run_test(name, argv[0], argv, SCRIPT(TEST_NAME), &status);
+    assert_proper_exit_status(err, status);
+}
+#undef type1_cmd
+#undef type2_cmd
+#undef printer1_cmd
+#undef printer2_cmd
+#undef conversion_cmd
+#undef enable1_cmd
+#undef enable2_cmd
+#undef print_cmd
+#undef TEST_NAME
+
+/*---------------------------test split print----------------------------------*/
+/* A two-page file printed with --split on two idle printers becomes one chunk
+   per printer; both chunks and then their parent job must finish.
+*/
+#define TEST_NAME split_print_test
+#define type_cmd "type aaa"
+#define printer1_cmd "printer Alice aaa"
+#define printer2_cmd "printer Bob aaa"
+#define enable1_cmd "enable Alice"
+#define enable2_cmd "enable Bob"
+#define print_cmd "print test_scripts/pages.aaa --split"
+static COMMAND SCRIPT(TEST_NAME)[] = {
+    // send,                expect,                     modifiers,                      timeout,    before,    after
+    {  NULL,                INIT_EVENT,                 0,                              HND_MSEC,   NULL,      NULL },
+    {  type_cmd,            TYPE_DEFINED_EVENT,         EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  printer1_cmd,        PRINTER_DEFINED_EVENT,      EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  printer2_cmd,        PRINTER_DEFINED_EVENT,      EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  enable1_cmd,         PRINTER_STATUS_EVENT,       EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  enable2_cmd,         PRINTER_STATUS_EVENT,       EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  print_cmd,           JOB_FINISHED_EVENT,         EXPECT_SKIP_OTHER,              ZERO_SEC,   NULL,      NULL },
+    {  NULL,                JOB_FINISHED_EVENT,         EXPECT_SKIP_OTHER,              ZERO_SEC,   NULL,      NULL },
+    {  NULL,                JOB_FINISHED_EVENT,         EXPECT_SKIP_OTHER,              ZERO_SEC,   NULL,      NULL },
+    {  "quit",              FINI_EVENT,                 EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  NULL,                EOF_EVENT,                  0,                              TEN_MSEC,   NULL,      NULL }
+};
+
+Test(SUITE, TEST_NAME, .init=test_setup, .fini = test_teardown, .timeout = 10)
+{
+    int err, status;
+    char *name = QUOTE(SUITE)"/"QUOTE(TEST_NAME);
+    char *argv[] = {TEST_EXECUTABLE, NULL};
+    err = run_test(name, argv[0], argv, SCRIPT(TEST_NAME), &status);
+    assert_proper_exit_status(err, status);
+}
+#undef type_cmd
+#undef printer1_cmd
+#undef printer2_cmd
+#undef enable1_cmd
+#undef enable2_cmd
+#undef print_cmd
+#undef TEST_NAME
+
+/*---------------------------test batch ends while printing--------------------*/
+/* A batch file given with -i that ends while its jobs are still converting must
+   leave them to finish: their stages are reaped, and the second job is
+   dispatched to the printer the first one frees, after the batch is over.
+*/
+#define TEST_NAME batch_print_test
+#define batch_file "test_scripts/batch_print.cmd"
+static COMMAND SCRIPT(TEST_NAME)[] = {
+    // send,                expect,                     modifiers,                      timeout,    before,    after
+    {  NULL,                INIT_EVENT,                 0,                              HND_MSEC,   NULL,      NULL },
+    {  NULL,                JOB_FINISHED_EVENT,         EXPECT_SKIP_OTHER,              TWO_SEC,    NULL,      NULL },
+    {  NULL,                JOB_FINISHED_EVENT,         EXPECT_SKIP_OTHER,              TWO_SEC,    NULL,      NULL },
+    {  "quit",              FINI_EVENT,                 EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  NULL,                EOF_EVENT,                  0,                              TEN_MSEC,   NULL,      NULL }
+};
+
+Test(SUITE, TEST_NAME, .init=test_setup, .fini = test_teardown, .timeout = 10)
+{
+    int err, status;
+    char *name = QUOTE(SUITE)"/"QUOTE(TEST_NAME);
+    char *argv[] = {TEST_EXECUTABLE, "-i", batch_file, NULL};
+    err = run_test(name, argv[0], argv, SCRIPT(TEST_NAME), &status);
+    assert_proper_exit_status(err, status);
+}
+#undef batch_file
+#undef TEST_NAME
+
+/*---------------------------test journal replay--------------------------------*/
+/* Jobs that terminated before the spooler quit must not be submitted again when
+   it restarts from its journal. One of them ends during its own dispatch: its
+   file cannot be opened, so it finishes before the print command returns.
+*/
+static void remove_journal(void) {
+    glob_t files;
+    if (glob("spool/journal.*", 0, NULL, &files) == 0) {
+        for (size_t i = 0; i < files.gl_pathc; i++) {
+            unlink(files.gl_pathv[i]);
+        }
+        globfree(&files);
+    }
+}
+
+#define TEST_NAME journal_replay_test
+#define type1_cmd "type aaa"
+#define type2_cmd "type bbb"
+#define printer_cmd "printer Alice bbb"
+#define conversion_cmd "conversion aaa bbb util/convert aaa bbb"
+#define enable_cmd "enable Alice"
+#define print_cmd "print test_scripts/testfile.aaa"
+#define print_missing_cmd "print test_scripts/missing.bbb"
+static COMMAND SCRIPT(TEST_NAME)[] = {
+    // send,                expect,                     modifiers,                      timeout,    before,    after
+    {  NULL,                INIT_EVENT,                 0,                              HND_MSEC,   NULL,      NULL },
+    {  type1_cmd,           TYPE_DEFINED_EVENT,         EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  type2_cmd,           TYPE_DEFINED_EVENT,         EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  printer_cmd,         PRINTER_DEFINED_EVENT,      EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  conversion_cmd,      CONVERSION_DEFINED_EVENT,   EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  enable_cmd,          PRINTER_STATUS_EVENT,       EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  print_missing_cmd,   JOB_FINISHED_EVENT,         EXPECT_SKIP_OTHER,              ONE_SEC,    NULL,      NULL },
+    {  print_cmd,           JOB_FINISHED_EVENT,         EXPECT_SKIP_OTHER,              TWO_SEC,    NULL,      NULL },
+    {  "quit",              FINI_EVENT,                 EXPECT_SKIP_OTHER,              HND_MSEC,   NULL,      NULL },
+    {  NULL,                EOF_EVENT,                  0,                              TEN_MSEC,   NULL,      NULL }
+};
+
+/* Restarts the spooler on the journal, lets it recover, and reports whether
+   it submitted any job again. (The event tracker cannot follow a second run
+   of the spooler within one test, so its own event log is read instead.) */
+static int restart_resubmits_jobs(void) {
+    FILE *out = popen("(sleep 1; echo quit) | PRESI_JOURNAL=1 bin/presi 2>&1", "r");
+    cr_assert_not_null(out, "Cannot restart the spooler");
+    char line[256];
+    int resubmitted = 0;
+    while (fgets(line, sizeof(line), out)) {
+        if (strstr(line, "JOB_CREATED")) {
+            resubmitted = 1;
+        }
+    }
+    pclose(out);
+    return resubmitted;
+}
+
+Test(SUITE, TEST_NAME, .init=test_setup, .fini = test_teardown, .timeout = 15)
+{
+    int err, status;
+    char *name = QUOTE(SUITE)"/"QUOTE(TEST_NAME);
+    char *argv[] = {TEST_EXECUTABLE, NULL};
+    remove_journal();
+    setenv("PRESI_JOURNAL", "1", 1);
+    err = run_test(name, argv[0], argv, SCRIPT(TEST_NAME), &status);
+    unsetenv("PRESI_JOURNAL");
+    assert_proper_exit_status(err, status);
+    int resubmitted = restart_resubmits_jobs();
+    remove_journal();
+    cr_assert_not(resubmitted, "A job that had terminated was submitted again after a restart");
+}
+#undef type1_cmd
+#undef type2_cmd
+#undef printer_cmd
+#undef conversion_cmd
+#undef enable_cmd
+#undef print_cmd
+#undef print_missing_cmd
+#undef TEST_NAME
@@ -0,0 +1,75 @@
+#include <criterion/criterion.h>
+#include <criterion/logging.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "latency_stats.h"
+#include "conversions.h"
+
+/*
+ * Tests of the job latency histograms as the 'stats' command prints them:
+ * every percentile is within the histogram's resolution of the true one, and
+ * never above the largest value recorded.
+ */
+
+#define SUITE latency_stats_suite
+#define MS 1000000ull
+
+static FILE_TYPE type_stt = { "stt", 5 };
+
+/* Finds the line of a scope in the table of a metric; returns 0 if there is none. */
+static int find_stats_line(const char *metric, const char *scope, char *line, size_t size) {
+    FILE *out = tmpfile();
+    cr_assert_not_null(out, "Cannot create a temporary file");
+    latency_stats_print(out);
+    rewind(out);
+    int in_metric = 0, found = 0;
+    while (!found && fgets(line, (int)size, out)) {
+        if (line[0] != ' ') {
+            in_metric = strncmp(line, metric, strlen(metric)) == 0;
+        } else if (in_metric && strncmp(line + 2, scope, strlen(scope)) == 0) {
+            found = 1;
+        }
+    }
+    fclose(out);
+    return found;
+}
+
+Test(SUITE, stats_output_test, .timeout = 10)
+{
+    for (uint64_t ms = 1; ms <= 100; ms++) {
+        latency_record(LATENCY_RUNTIME, NULL, &type_stt, ms * MS);
+    }
+
+    char line[256];
+    cr_assert(find_stats_line("runtime", "type stt", line, sizeof(line)), "The file type is not in the stats");
+    unsigned long count;
+    double p50, p99, p999, max;
+    cr_assert_eq(sscanf(line, " type stt %lu %lf %lf %lf %lf", &count, &p50, &p99, &p999, &max), 5,
+                 "Malformed stats line");
+    cr_assert_eq(count, 100, "Wrong number of jobs");
+    cr_assert(p50 >= 50.0 && p50 <= 50.0 * (1 + 1.0 / 32), "p50 is off");
+    cr_assert(p99 >= 99.0 && p99 <= 100.0, "p99 is off");
+    cr_assert(p999 >= p99 && p999 <= 100.0, "p999 is off");
+    cr_assert(max > 99.999 && max < 100.001, "Wrong maximum");
+
+    cr_assert_not(find_stats_line("queue wait", "type stt", line, sizeof(line)),
+                  "A metric with no values recorded is in the stats");
+}
+
+Test(SUITE, percentile_bounds_test, .timeout = 10)
+{
+    static LATENCY_HISTOGRAM histogram;
+    cr_assert_eq(latency_percentile(&histogram, 0.5), 0, "An empty histogram has a percentile");
+    for (uint64_t value = 1; value <= 100000; value++) {
+        latency_histogram_record(&histogram, value * 997);
+    }
+    const double quantiles[] = { 0.01, 0.5, 0.9, 0.99, 0.999, 1.0 };
+    for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); i++) {
+        uint64_t exact = (uint64_t)(quantiles[i] * 100000 + 0.5) * 997;
+        uint64_t reported = latency_percentile(&histogram, quantiles[i]);
+        cr_assert_geq(reported, exact, "A percentile is below the true one");
+        cr_assert_leq(reported, exact + exact / 32, "A percentile is off by more than 1 part in 32");
+        cr_assert_leq(reported, histogram.max, "A percentile is above the maximum");
+    }
+}
@@ -0,0 +1,98 @@
+#include <criterion/criterion.h>
+#include <criterion/logging.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "metrics_exporter.h"
+
+/*
+ * Tests of the metrics exporter, against a spooler started with METRICS_ENV
+ * set: a scrape is answered with a well-formed HTTP response whose body is in
+ * the Prometheus text format and reflects the spooler's state.
+ */
+
+#define SUITE metrics_suite
+#define SPOOLER "(echo type aaa; echo printer p1 aaa; echo print test_scripts/testfile.aaa; sleep 3; echo quit) | " \
+                METRICS_ENV "=1 bin/presi >/dev/null 2>&1"
+#define SCRAPE "GET /metrics HTTP/1.0\r\n\r\n"
+
+static char response[1 << 16];
+
+/* Scrapes the exporter once; returns the length of the response. */
+static size_t scrape(void) {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    strncpy(address.sun_path, METRICS_SOCKET_PATH, sizeof(address.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    cr_assert_geq(fd, 0, "Cannot create a socket");
+    cr_assert_eq(connect(fd, (struct sockaddr *)&address, sizeof(address)), 0, "Cannot connect to the exporter");
+    struct timeval timeout = { 2, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    cr_assert_eq(write(fd, SCRAPE, strlen(SCRAPE)), (ssize_t)strlen(SCRAPE), "Cannot send the request");
+
+    size_t length = 0;
+    ssize_t n;
+    while ((n = read(fd, response + length, sizeof(response) - 1 - length)) > 0) {
+        length += (size_t)n;
+    }
+    cr_assert_eq(n, 0, "The exporter did not close the connection");
+    close(fd);
+    response[length] = '\0';
+    return length;
+}
+
+/* Checks that every sample follows a TYPE line of its metric and has a numeric value. */
+static void check_exposition_format(char *body) {
+    char family[128] = "";
+    for (char *line = strtok(body, "\n"); line; line = strtok(NULL, "\n")) {
+        if (strncmp(line, "# HELP ", 7) == 0) {
+            continue;
+        }
+        if (strncmp(line, "# TYPE ", 7) == 0) {
+            cr_assert_eq(sscanf(line, "# TYPE %127s", family), 1, "Malformed TYPE line");
+            continue;
+        }
+        size_t name_length = strcspn(line, "{ ");
+        cr_assert_gt(strlen(family), 0, "A sample precedes every TYPE line");
+        cr_assert(strncmp(line, family, strlen(family)) == 0 && name_length >= strlen(family),
+                  "A sample does not belong to the metric of the last TYPE line");
+        char *value = strrchr(line, ' ');
+        cr_assert_not_null(value, "A sample has no value");
+        char *end;
+        strtod(value + 1, &end);
+        cr_assert(end != value + 1 && *end == '\0', "A sample value is not a number");
+    }
+}
+
+Test(SUITE, scrape_test, .timeout = 10)
+{
+    unlink(METRICS_SOCKET_PATH);
+    FILE *spooler = popen(SPOOLER, "r");
+    cr_assert_not_null(spooler, "Cannot start the spooler");
+    // Let a snapshot be taken after the job was submitted
+    long wait_ms = METRICS_PUBLISH_MS + 500;
+    nanosleep(&(struct timespec){ wait_ms / 1000, wait_ms % 1000 * 1000000L }, NULL);
+
+    size_t length = scrape();
+    cr_assert(strncmp(response, "HTTP/1.0 200 OK\r\n", 17) == 0, "Not an HTTP response");
+    char *body = strstr(response, "\r\n\r\n");
+    cr_assert_not_null(body, "The HTTP header is not terminated");
+    body += 4;
+    char *content_length = strstr(response, "Content-Length: ");
+    cr_assert(content_length && content_length < body, "No Content-Length");
+    cr_assert_eq(strtoul(content_length + 16, NULL, 10), length - (size_t)(body - response),
+                 "Wrong Content-Length");
+
+    cr_assert_not_null(strstr(body, "\npresi_jobs_submitted_total 1\n"), "The submitted job is not counted");
+    cr_assert_not_null(strstr(body, "\npresi_jobs{state=\"created\"} 1\n"), "The queued job is not counted");
+    cr_assert_not_null(strstr(body, "\npresi_printer_status{printer=\"p1\",status=\"disabled\"} 1\n"),
+                       "The printer's status is missing");
+    check_exposition_format(body);
+
+    cr_assert_eq(pclose(spooler), 0, "The spooler did not exit properly");
+}
@@ -0,0 +1,83 @@
+#include <criterion/criterion.h>
+#include <criterion/logging.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "output_cache.h"
+#include "conversions.h"
+
+/*
+ * Tests of the output cache key: a file printed again unchanged is not read
+ * again, and inputs with different bytes or sizes never share a key.
+ */
+
+#define SUITE output_cache_suite
+#define INPUT_A "spool/output_cache_test_a.aaa"
+#define INPUT_B "spool/output_cache_test_b.aaa"
+
+static FILE_TYPE type_aaa = { "aaa", 0 };
+static FILE_TYPE type_bbb = { "bbb", 1 };
+static char *convert_args[] = { "util/convert", "aaa", "bbb", NULL };
+static CONVERSION convert = { &type_aaa, &type_bbb, convert_args };
+static CONVERSION *conversion_path[] = { &convert, NULL };
+
+static void write_input(const char *path, const char *contents) {
+    FILE *file = fopen(path, "w");
+    cr_assert_not_null(file, "Cannot create %s", path);
+    fputs(contents, file);
+    fclose(file);
+}
+
+static OUTPUT_CACHE_KEY key_of(const char *path) {
+    OUTPUT_CACHE_KEY key;
+    cr_assert_eq(output_cache_key(path, conversion_path, &key), 0, "Cannot compute the key of %s", path);
+    return key;
+}
+
+static unsigned long inputs_hashed(void) {
+    OUTPUT_CACHE_STATS stats;
+    output_cache_get_stats(&stats);
+    return stats.inputs_hashed;
+}
+
+static void cleanup_inputs(void) {
+    unlink(INPUT_A);
+    unlink(INPUT_B);
+}
+
+Test(SUITE, unchanged_input_test, .fini = cleanup_inputs, .timeout = 10)
+{
+    output_cache_initialize();
+    write_input(INPUT_A, "some text to print\n");
+    write_input(INPUT_B, "some text to print\n");
+    nanosleep(&(struct timespec){ 1, 200000000 }, NULL);  // Let the files settle
+
+    OUTPUT_CACHE_KEY first = key_of(INPUT_A);
+    cr_assert_eq(inputs_hashed(), 1, "The input was not hashed");
+    OUTPUT_CACHE_KEY again = key_of(INPUT_A);
+    cr_assert_eq(inputs_hashed(), 1, "An unchanged input was read again");
+    cr_assert(first.hash == again.hash && first.input_size == again.input_size, "The key changed");
+
+    OUTPUT_CACHE_KEY copy = key_of(INPUT_B);
+    cr_assert_eq(inputs_hashed(), 2, "Another file was not read");
+    cr_assert(copy.hash == first.hash && copy.input_size == first.input_size,
+              "Files with the same bytes have different keys");
+}
+
+Test(SUITE, changed_input_test, .fini = cleanup_inputs, .timeout = 10)
+{
+    output_cache_initialize();
+    write_input(INPUT_A, "some text to print\n");
+    OUTPUT_CACHE_KEY before = key_of(INPUT_A);
+
+    write_input(INPUT_A, "other text to print\n");
+    OUTPUT_CACHE_KEY longer = key_of(INPUT_A);
+    cr_assert_neq(longer.input_size, before.input_size, "The input size is not part of the key");
+
+    write_input(INPUT_A, "other text to prinT\n");
+    OUTPUT_CACHE_KEY rewritten = key_of(INPUT_A);
+    cr_assert_neq(rewritten.hash, longer.hash, "A file rewritten at once kept its key");
+    cr_assert_eq(inputs_hashed(), 3, "A changed input was not read again");
+}
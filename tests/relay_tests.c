@@ -0,0 +1,123 @@
+#include <criterion/criterion.h>
+#include <criterion/logging.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "event_loop.h"
+#include "relay.h"
+
+/*
+ * Tests of the relay's checkpoint: after the printer drops the connection,
+ * the relay resumes on a new one from a point the printer had reached, so that
+ * nothing is lost and little is sent twice.
+ */
+
+#define SUITE relay_suite
+#define RELAY_FILE "spool/relay_test.dat"
+#define FILE_SIZE (4 << 20)
+#define READ_BEFORE_DROP (1 << 20)
+#define MAX_RESENT (64 << 10)  // Well under what the socket buffers hold
+
+static unsigned char expected[FILE_SIZE];
+static unsigned char received[FILE_SIZE];
+
+/* Outcome reported by the relay's callback. */
+static int callbacks = 0;
+static int last_error = -1;
+
+static void relay_done(void *context, int error) {
+    (void)context;
+    callbacks++;
+    last_error = error;
+}
+
+static int open_relay_file(void) {
+    for (int i = 0; i < FILE_SIZE; i++) {
+        expected[i] = (unsigned char)((i * 7) % 251);
+    }
+    int fd = open(RELAY_FILE, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    cr_assert_geq(fd, 0, "Cannot create %s", RELAY_FILE);
+    cr_assert_eq(write(fd, expected, FILE_SIZE), FILE_SIZE, "Cannot write %s", RELAY_FILE);
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+/* Runs the event loop while reading from the printer's end until want bytes
+   have arrived, the connection ends, or the relay reports. */
+static size_t read_printer(int fd, unsigned char *buffer, size_t want) {
+    size_t got = 0;
+    int start_callbacks = callbacks;
+    while (got < want && callbacks == start_callbacks) {
+        event_loop_run_once(10);
+        ssize_t n = recv(fd, buffer + got, want - got, MSG_DONTWAIT);
+        if (n == 0) {
+            break;
+        }
+        if (n > 0) {
+            got += (size_t)n;
+        } else {
+            cr_assert(errno == EAGAIN || errno == EWOULDBLOCK, "Read from the relay failed");
+        }
+    }
+    while (got < want) {  // The relay may have finished with data still queued
+        ssize_t n = recv(fd, buffer + got, want - got, MSG_DONTWAIT);
+        if (n <= 0) {
+            break;
+        }
+        got += (size_t)n;
+    }
+    return got;
+}
+
+static void cleanup_relay_file(void) {
+    unlink(RELAY_FILE);
+    event_loop_cleanup();
+}
+
+Test(SUITE, reconnect_test, .fini = cleanup_relay_file, .timeout = 10)
+{
+    signal(SIGPIPE, SIG_IGN);  // As in the spooler
+    cr_assert_eq(event_loop_initialize(), 0, "Cannot create the event loop");
+
+    RELAY relay;
+    int first[2], second[2];
+    cr_assert_eq(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, first), 0, "socketpair failed");
+    relay_init(&relay);
+    cr_assert_eq(relay_start(&relay, open_relay_file(), first[0], relay_done, NULL), 0, "Cannot start the relay");
+
+    // The printer reads part of the file, lets the relay refill its socket, then goes away
+    size_t read_first = read_printer(first[1], received, READ_BEFORE_DROP);
+    cr_assert_eq(read_first, READ_BEFORE_DROP, "The relay sent %zu bytes before the drop", read_first);
+    for (int i = 0; i < 10; i++) {
+        event_loop_run_once(0);
+    }
+    close(first[1]);
+    while (callbacks == 0) {
+        cr_assert_geq(event_loop_run_once(1000), 0, "The event loop failed");
+    }
+    cr_assert(last_error == EPIPE || last_error == ECONNRESET, "The drop was reported as %d", last_error);
+    cr_assert(relay_is_detached(&relay), "The relay was not detached");
+
+    // A new connection receives the rest of the file, starting at the checkpoint
+    cr_assert_eq(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, second), 0, "socketpair failed");
+    cr_assert_eq(relay_reattach(&relay, second[0]), 0, "Cannot reattach the relay");
+    static unsigned char rest[FILE_SIZE];
+    size_t read_second = read_printer(second[1], rest, FILE_SIZE);
+    cr_assert_eq(callbacks, 2, "The relay did not complete");
+    cr_assert_eq(last_error, 0, "The relay completed with error %d", last_error);
+    cr_assert_eq(recv(second[1], rest, 1, MSG_DONTWAIT), 0, "The relay sent more than the file");
+    close(second[1]);
+
+    size_t resumed_at = FILE_SIZE - read_second;
+    cr_assert_leq(resumed_at, read_first, "Resumed at %zu, past the %zu bytes the printer read",
+                  resumed_at, read_first);
+    cr_assert_leq(read_first - resumed_at, (size_t)MAX_RESENT,
+                  "Resumed at %zu, resending much of the %zu bytes the printer read", resumed_at, read_first);
+    cr_assert(memcmp(rest, expected + resumed_at, read_second) == 0, "The resumed data is not the rest of the file");
+    cr_assert(memcmp(received, expected, read_first) == 0, "The data before the drop is not the file");
+}
@@ -0,0 +1,92 @@
+#include <criterion/criterion.h>
+#include <criterion/logging.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "stage_usage.h"
+#include "conversions.h"
+
+/*
+ * Tests of the per-conversion resource accounting: each conversion command
+ * gets its own totals, and a redefined conversion is accounted under its new
+ * command once the remembered slots are invalidated.
+ */
+
+#define SUITE stage_usage_suite
+
+static FILE_TYPE type_ccc = { "ccc", 0 };
+static FILE_TYPE type_ddd = { "ddd", 1 };
+static char *first_args[] = { "util/first_converter", NULL };
+static char *second_args[] = { "util/second_converter", "-x", NULL };
+
+/* Returns the line of the stats output naming a command, or NULL. */
+static char *usage_line(const char *command, char *line, size_t size) {
+    FILE *out = tmpfile();
+    cr_assert_not_null(out, "Cannot create a temporary file");
+    stage_usage_print(out);
+    rewind(out);
+    char *found = NULL;
+    while (!found && fgets(line, (int)size, out)) {
+        if (strstr(line, command)) {
+            found = line;
+        }
+    }
+    fclose(out);
+    return found;
+}
+
+Test(SUITE, accounting_test, .timeout = 10)
+{
+    CONVERSION conversion = { &type_ccc, &type_ddd, first_args };
+    int slot = stage_usage_slot(&conversion);
+    cr_assert_geq(slot, 0, "No slot for the conversion");
+    cr_assert_str_eq(stage_usage_command(slot), "ccc -> ddd: util/first_converter", "Wrong command accounted");
+    cr_assert_eq(stage_usage_slot(&conversion), slot, "The slot of the conversion changed");
+
+    struct rusage run = { 0 };
+    run.ru_utime.tv_sec = 1;
+    run.ru_stime.tv_usec = 500000;
+    run.ru_maxrss = 2048;
+    run.ru_inblock = 3;
+    stage_usage_record(slot, &run);
+    run.ru_maxrss = 1024;
+    stage_usage_record(slot, &run);
+    stage_usage_record(-1, &run);
+
+    char line[256];
+    cr_assert_not_null(usage_line("util/first_converter", line, sizeof(line)), "The command is not in the stats");
+    char command[128];
+    unsigned long runs, max_rss, in_blocks, out_blocks;
+    double user_s, system_s, per_run_ms;
+    cr_assert_eq(sscanf(line, " ccc -> ddd: %127s %lu %lf %lf %lf %lu %lu %lu", command, &runs, &user_s,
+                        &system_s, &per_run_ms, &max_rss, &in_blocks, &out_blocks), 8, "Malformed stats line");
+    cr_assert_eq(runs, 2, "Wrong number of runs");
+    cr_assert(user_s > 1.999 && user_s < 2.001, "Wrong user time");
+    cr_assert(system_s > 0.999 && system_s < 1.001, "Wrong system time");
+    cr_assert(per_run_ms > 1499.9 && per_run_ms < 1500.1, "Wrong CPU time per run");
+    cr_assert_eq(max_rss, 2048, "Wrong largest resident set");
+    cr_assert_eq(in_blocks, 6, "Wrong blocks read");
+    cr_assert_eq(out_blocks, 0, "Wrong blocks written");
+}
+
+Test(SUITE, redefined_conversion_test, .timeout = 10)
+{
+    CONVERSION conversion = { &type_ddd, &type_ccc, first_args };
+    int first = stage_usage_slot(&conversion);
+    cr_assert_geq(first, 0, "No slot for the conversion");
+
+    // Redefined in place: the old slot is remembered until invalidated
+    conversion.cmd_and_args = second_args;
+    cr_assert_eq(stage_usage_slot(&conversion), first, "The slot was not remembered");
+    invalidate_stage_usage_slots();
+    int second = stage_usage_slot(&conversion);
+    cr_assert_geq(second, 0, "No slot for the redefined conversion");
+    cr_assert_neq(second, first, "The redefined conversion shares the old command's totals");
+    cr_assert_str_eq(stage_usage_command(second), "ddd -> ccc: util/second_converter -x", "Wrong command accounted");
+
+    // The original command keeps its slot when it is defined again
+    conversion.cmd_and_args = first_args;
+    invalidate_stage_usage_slots();
+    cr_assert_eq(stage_usage_slot(&conversion), first, "The original command got a new slot");
+}
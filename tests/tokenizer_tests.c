@@ -0,0 +1,88 @@
+#include <criterion/criterion.h>
+#include <criterion/logging.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tokenizer.h"
+
+/*
+ * Differential tests: tokenize_line() must split every line exactly as the
+ * byte-at-a-time tokenize_line_scalar() does, leaving the same bytes behind.
+ */
+
+#define SUITE tokenizer_suite
+#define MAX_LINE 300
+#define MAX_TOKENS 32
+
+/* Bytes the random lines are made of: every kind of whitespace, plus a few that look like it. */
+static const char alphabet[] = { ' ', '\t', '\n', '\v', '\f', '\r', 'a', 'Z', '/', '.', 0x08, 0x0e, 0x1f, '!', (char)0xa0, (char)0xff };
+
+/**
+ * Tokenizes the same line at the same alignment with both tokenizers and compares the results.
+ */
+static void check_line(const char *line, size_t length, size_t alignment, int max_tokens) {
+    static char scalar_buffer[MAX_LINE + 64] __attribute__((aligned(64)));
+    static char simd_buffer[MAX_LINE + 64] __attribute__((aligned(64)));
+    char *scalar_line = scalar_buffer + alignment;
+    char *simd_line = simd_buffer + alignment;
+    memcpy(scalar_line, line, length);
+    memcpy(simd_line, line, length);
+    scalar_line[length] = simd_line[length] = '\0';
+
+    char *scalar_tokens[MAX_TOKENS], *simd_tokens[MAX_TOKENS];
+    int scalar_count = tokenize_line_scalar(scalar_line, scalar_tokens, max_tokens);
+    int simd_count = tokenize_line(simd_line, simd_tokens, max_tokens);
+
+    cr_assert_eq(simd_count, scalar_count, "Token count %d, expected %d (length %zu, alignment %zu)",
+                 simd_count, scalar_count, length, alignment);
+    for (int i = 0; i < scalar_count; i++) {
+        cr_assert_eq(simd_tokens[i] - simd_line, scalar_tokens[i] - scalar_line,
+                     "Token %d starts at the wrong offset (length %zu, alignment %zu)", i, length, alignment);
+    }
+    cr_assert(memcmp(simd_line, scalar_line, length + 1) == 0,
+              "Line left in a different state (length %zu, alignment %zu)", length, alignment);
+}
+
+Test(SUITE, random_lines_test, .timeout = 10)
+{
+    char line[MAX_LINE];
+    srand(12345);
+    for (int round = 0; round < 20000; round++) {
+        size_t length = (size_t)rand() % MAX_LINE;
+        int spaces_only = rand() % 8 == 0;
+        for (size_t i = 0; i < length; i++) {
+            line[i] = alphabet[rand() % (spaces_only ? 6 : (int)sizeof(alphabet))];
+        }
+        check_line(line, length, (size_t)rand() % 32, 1 + rand() % MAX_TOKENS);
+    }
+}
+
+Test(SUITE, command_lines_test, .timeout = 5)
+{
+    static const char *lines[] = {
+        "",
+        "help",
+        "   help",
+        "print test_scripts/testfile.aaa",
+        "conversion pdf ps util/convert pdf ps",
+        "\t printer  Alice\tpdf \r",
+        "a b c d e f g h i j k l m n o p q r s t u v w x y z 0 1 2 3 4 5 6 7 8 9",
+        "                                                 x",
+    };
+    for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+        for (size_t alignment = 0; alignment < 32; alignment++) {
+            check_line(lines[i], strlen(lines[i]), alignment, MAX_TOKENS);
+            check_line(lines[i], strlen(lines[i]), alignment, 2);
+        }
+    }
+}
+
+Test(SUITE, token_limit_test, .timeout = 5)
+{
+    char line[] = "one two three four";
+    char *tokens[MAX_TOKENS];
+    int count = tokenize_line(line, tokens, 2);
+    cr_assert_eq(count, 2, "Expected 2 tokens, got %d", count);
+    cr_assert_str_eq(tokens[0], "one");
+    cr_assert_str_eq(tokens[1], "two");
+}
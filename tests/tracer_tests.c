@@ -0,0 +1,173 @@
+#include <criterion/criterion.h>
+#include <criterion/logging.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tracer.h"
+
+/*
+ * Tests of the trace file, written by a spooler started with TRACE_ENV set
+ * that prints a file through a conversion: it must be one valid JSON array of
+ * event objects, holding the job's spans and the span of its conversion stage.
+ */
+
+#define SUITE tracer_suite
+#define TRACED_FILE "spool/tracer_test.aaa"
+#define SPOOLER "(echo type aaa; echo type bbb; echo printer Alice bbb; " \
+                "echo conversion aaa bbb util/convert aaa bbb; echo enable Alice; " \
+                "echo print " TRACED_FILE "; sleep 2; echo quit) | " TRACE_ENV "=1 bin/presi >/dev/null 2>&1"
+
+static char trace[1 << 20];
+
+static const char *skip_space(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+        p++;
+    }
+    return p;
+}
+
+static const char *parse_value(const char *p);
+
+/* Each parse_ function returns the end of what it parsed, or NULL if it is not valid JSON. */
+static const char *parse_string(const char *p) {
+    if (*p++ != '"') {
+        return NULL;
+    }
+    for (; *p != '"'; p++) {
+        if ((unsigned char)*p < 0x20) {
+            return NULL;
+        }
+        if (*p == '\\') {
+            p++;
+            if (*p == 'u') {
+                for (int i = 1; i <= 4; i++) {
+                    if (!isxdigit((unsigned char)p[i])) {
+                        return NULL;
+                    }
+                }
+                p += 4;
+            } else if (!strchr("\"\\/bfnrt", *p) || *p == '\0') {
+                return NULL;
+            }
+        }
+    }
+    return p + 1;
+}
+
+static const char *parse_number(const char *p) {
+    char *end;
+    strtod(p, &end);
+    return (end == p || (*p != '-' && !isdigit((unsigned char)*p))) ? NULL : end;
+}
+
+/* Parses the elements of an array or the members of an object, after its opening bracket. */
+static const char *parse_elements(const char *p, char close, int members) {
+    p = skip_space(p);
+    if (*p == close) {
+        return p + 1;
+    }
+    while (p) {
+        if (members) {
+            p = parse_string(skip_space(p));
+            if (!p || *(p = skip_space(p)) != ':') {
+                return NULL;
+            }
+            p++;
+        }
+        p = parse_value(p);
+        if (!p) {
+            return NULL;
+        }
+        p = skip_space(p);
+        if (*p == close) {
+            return p + 1;
+        }
+        p = (*p == ',') ? p + 1 : NULL;
+    }
+    return NULL;
+}
+
+static const char *parse_value(const char *p) {
+    p = skip_space(p);
+    switch (*p) {
+        case '{':
+            return parse_elements(p + 1, '}', 1);
+        case '[':
+            return parse_elements(p + 1, ']', 0);
+        case '"':
+            return parse_string(p);
+        case 't':
+            return strncmp(p, "true", 4) == 0 ? p + 4 : NULL;
+        case 'f':
+            return strncmp(p, "false", 5) == 0 ? p + 5 : NULL;
+        case 'n':
+            return strncmp(p, "null", 4) == 0 ? p + 4 : NULL;
+        default:
+            return parse_number(p);
+    }
+}
+
+/* Checks that the trace is an array of objects, each with a name and a phase. */
+static void check_trace_json(void) {
+    const char *p = skip_space(trace);
+    cr_assert_eq(*p, '[', "The trace is not an array");
+    const char *end = parse_value(p);
+    cr_assert_not_null(end, "The trace is not valid JSON");
+    cr_assert_eq(*skip_space(end), '\0', "There is more than one value in the trace");
+
+    int events = 0;
+    for (p = skip_space(p + 1); *p != ']'; p = skip_space(p)) {
+        cr_assert_eq(*p, '{', "An event is not an object");
+        const char *event_end = parse_value(p);
+        cr_assert(strncmp(p, "{\"name\":\"", 9) == 0, "An event has no name");
+        const char *phase = strstr(p, "\"ph\":\"");
+        cr_assert(phase && phase < event_end && strchr("XMC", phase[6]), "An event has no known phase");
+        events++;
+        p = skip_space(event_end);
+        if (*p == ',') {
+            p++;
+        }
+    }
+    cr_assert_gt(events, 1, "The trace has no events");
+}
+
+static void cleanup_trace(void) {
+    unlink(TRACED_FILE);
+    unlink(TRACE_PATH);
+}
+
+Test(SUITE, trace_json_test, .fini = cleanup_trace, .timeout = 10)
+{
+    // Contents never printed before, so the conversion runs rather than the output cache
+    FILE *input = fopen(TRACED_FILE, "w");
+    cr_assert_not_null(input, "Cannot create %s", TRACED_FILE);
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    fprintf(input, "traced at %lld.%09ld by %d\n", (long long)now.tv_sec, now.tv_nsec, (int)getpid());
+    fclose(input);
+
+    cr_assert_eq(system(SPOOLER), 0, "The spooler did not exit properly");
+
+    FILE *file = fopen(TRACE_PATH, "r");
+    cr_assert_not_null(file, "No trace was written");
+    size_t length = fread(trace, 1, sizeof(trace) - 1, file);
+    fclose(file);
+    cr_assert_lt(length, sizeof(trace) - 1, "The trace is too long for the test");
+    trace[length] = '\0';
+    check_trace_json();
+
+    cr_assert_not_null(strstr(trace, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+                                     "\"args\":{\"name\":\"job 0: " TRACED_FILE "\"}}"),
+                       "The job's process is not named");
+    cr_assert_not_null(strstr(trace, "{\"name\":\"queued\",\"ph\":\"X\",\"pid\":1,\"tid\":0,"),
+                       "The job's queued span is missing");
+    cr_assert_not_null(strstr(trace, "{\"name\":\"printing\",\"ph\":\"X\",\"pid\":1,\"tid\":0,"),
+                       "The job's printing span is missing");
+    cr_assert_not_null(strstr(trace, "{\"name\":\"aaa -> bbb: util/convert aaa bbb\","
+                                     "\"ph\":\"X\",\"pid\":1,\"tid\":1,"),
+                       "The conversion stage's span is missing");
+}